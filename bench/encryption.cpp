@@ -0,0 +1,157 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Compares encryption_table::decode against the original decoder (1KiB
+// uint32_t table copied per chunk, keystream generated and applied a byte at
+// a time) over the same chunks.
+// encryption-bench [<total MiB> [<chunk KiB>]]
+
+#include "encryption.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct reference_table_t
+{
+	uint32_t u32[256];
+
+	reference_table_t(const encryption_table &table)
+	{
+		for (size_t i = 0; i < 256; ++i) u32[i] = table.state[i];
+	}
+
+	void decode(uint8_t *chunk, size_t size) const
+	{
+		uint32_t buffer[256];
+		std::memcpy(buffer, u32, sizeof(buffer));
+		const uint8_t *u8 = reinterpret_cast<const uint8_t *>(buffer);
+
+		uint8_t i  = 0U;
+		uint8_t i2 = 0U;
+		for (size_t n = 0; n < size; ++n)
+		{
+			++i;
+			i2 += (uint8_t)buffer[i];
+			std::swap(buffer[i], buffer[i2]);
+			chunk[n] ^= u8[4U * uint8_t(buffer[i] + buffer[i2])];
+		}
+	}
+};
+
+template<typename F>
+static double time_seconds(F &&func)
+{
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	const size_t total_size =
+	  size_t(argc > 1 ? std::atoi(argv[1]) : 64) * 0x100000;
+	const size_t chunk_size =
+	  size_t(argc > 2 ? std::atoi(argv[2]) : 64) * 0x400;
+	if (total_size == 0 || chunk_size == 0)
+	{
+		std::cerr << "encryption-bench [<total MiB> [<chunk KiB>]]\n";
+		return 1;
+	}
+
+	std::mt19937 rng(132);
+
+	// Not every key generates a table, keep trying until one does.
+	encryption_table table;
+	std::vector<uint8_t> key(0x101);
+	do
+	{
+		for (auto &k : key) k = uint8_t(rng());
+	} while (!table.init(lak::span<const uint8_t, 0x100>(key.data(), 0x100),
+	                     char(rng())));
+	const reference_table_t reference(table);
+
+	std::vector<byte_t> chunk(chunk_size);
+	for (auto &b : chunk) b = byte_t(rng());
+
+	// Both decoders must produce the same output, including for chunk sizes
+	// that don't line up with the keystream blocks.
+	for (const size_t size : {size_t(0), size_t(1), size_t(15), size_t(17),
+	                          encryption_stream::block_size + 3,
+	                          chunk_size})
+	{
+		std::vector<byte_t> expected(chunk.begin(), chunk.begin() + size);
+		std::vector<byte_t> actual = expected;
+		reference.decode(reinterpret_cast<uint8_t *>(expected.data()), size);
+		table.decode(lak::span<byte_t>(actual.data(), size));
+		if (expected != actual)
+		{
+			std::cerr << "Mismatch decoding " << size << " bytes\n";
+			return 1;
+		}
+	}
+
+	const size_t chunks = (total_size + chunk_size - 1) / chunk_size;
+	const double bytes  = double(chunks * chunk_size);
+
+	auto run_reference = [&]
+	{
+		for (size_t c = 0; c < chunks; ++c)
+			reference.decode(reinterpret_cast<uint8_t *>(chunk.data()),
+			                 chunk.size());
+	};
+
+	auto run_table = [&]
+	{
+		for (size_t c = 0; c < chunks; ++c)
+			table.decode(lak::span<byte_t>(chunk.data(), chunk.size()));
+	};
+
+	// Best of several interleaved rounds, to keep out noise from the rest of
+	// the system.
+	double reference_time = HUGE_VAL;
+	double table_time     = HUGE_VAL;
+	for (size_t round = 0; round < 5; ++round)
+	{
+		reference_time = std::min(reference_time, time_seconds(run_reference));
+		table_time     = std::min(table_time, time_seconds(run_table));
+	}
+
+	std::cout << "chunk size:       " << chunk_size << " bytes\n"
+	          << "bytes decoded:    " << size_t(bytes) << "\n"
+	          << "reference:        " << size_t(bytes / reference_time)
+	          << " bytes/s\n"
+	          << "encryption_table: " << size_t(bytes / table_time)
+	          << " bytes/s\n"
+	          << "speedup:          " << reference_time / table_time << "x\n";
+
+	return 0;
+}
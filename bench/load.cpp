@@ -0,0 +1,374 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Writes synthetic games of every layout and chunk encoding, then times
+// loading, decoding every image and dumping the images, binary files and
+// sounds.
+// load-bench [<MiB per game> [<work folder>]]
+//
+// One line is printed per case and phase, as space separated key=value
+// pairs in a fixed order so runs can be diffed against each other:
+// case=<name> phase=<phase> bytes=<n> items=<n> seconds=<s> mib_per_s=<n>
+//   arena_bytes=<n> peak_rss_bytes=<n>
+// arena_bytes is the most decode arena memory the game has held, and
+// peak_rss_bytes is the process's peak so far (it never goes back down).
+
+#ifndef NOMINMAX
+#	define NOMINMAX
+#endif
+
+#include "dump.h"
+#include "explorer.h"
+#include "game_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+namespace se = SourceExplorer;
+
+static size_t PeakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!K32GetProcessMemoryInfo(
+	      GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return size_t(counters.PeakWorkingSetSize);
+#else
+	rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#	ifdef __APPLE__
+	return size_t(usage.ru_maxrss);
+#	else
+	return size_t(usage.ru_maxrss) * 1024;
+#	endif
+#endif
+}
+
+template<typename F>
+static double time_seconds(F &&func)
+{
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+struct bench_case_t
+{
+	std::string name;
+	se::game_spec_t spec;
+};
+
+// Between them the cases cover every layout, every chunk encoding the
+// layout can store, and every image format the writer knows. The game size
+// is split roughly evenly between the binary file and the images.
+static std::vector<bench_case_t> BenchCases(size_t game_size)
+{
+	using se::encoding_t;
+	using se::game_layout_t;
+
+	// About what an average image of up to 64x64 compresses to.
+	const size_t image_count = std::max<size_t>(16, game_size / 0x1000);
+
+	std::vector<bench_case_t> result;
+
+	auto add = [&](std::string name,
+	               game_layout_t layout,
+	               uint32_t product_build,
+	               encoding_t string_mode,
+	               encoding_t binary_mode)
+	{
+		auto &spec         = result.emplace_back().spec;
+		result.back().name = lak::move(name);
+		spec.layout        = layout;
+		spec.product_build = product_build;
+		spec.string_mode   = string_mode;
+		spec.binary_mode   = binary_mode;
+		spec.binary_size   = game_size / 2;
+		spec.images        = se::SyntheticImages(image_count, 64, spec.seed);
+		if (layout != game_layout_t::ascii)
+			spec.title = u"Synth\u00E9tique \u30B2\u30FC\u30E0";
+		return &spec;
+	};
+
+	// Old games can only store binary files uncompressed.
+	add("old", game_layout_t::old, 0, encoding_t::mode1, encoding_t::mode0)
+	  ->binary_size = game_size;
+	add("ascii-284-mode2",
+	    game_layout_t::ascii,
+	    284,
+	    encoding_t::mode2,
+	    encoding_t::mode3);
+	add("unicode-mode1",
+	    game_layout_t::unicode,
+	    292,
+	    encoding_t::mode3,
+	    encoding_t::mode1);
+	add("unicode-mode2",
+	    game_layout_t::unicode,
+	    292,
+	    encoding_t::mode1,
+	    encoding_t::mode2);
+	add("2.5+-mode4",
+	    game_layout_t::two_five_plus,
+	    295,
+	    encoding_t::mode4,
+	    encoding_t::mode4);
+
+	// Lots of tiny images, where per item overhead dominates.
+	auto *many = add("many-items",
+	                 game_layout_t::unicode,
+	                 292,
+	                 encoding_t::mode0,
+	                 encoding_t::mode1);
+	many->binary_size = 0;
+	many->images =
+	  se::SyntheticImages(std::max<size_t>(16, game_size / 0x80), 8, many->seed);
+
+	// Every bank, packed into a built .exe, with encrypted bank items.
+	auto *full = add("full-exe",
+	                 game_layout_t::unicode,
+	                 292,
+	                 encoding_t::mode3,
+	                 encoding_t::mode1);
+	full->pe_stub             = true;
+	full->pack_file_count     = 4;
+	full->pack_file_size      = 0x10000;
+	full->binary_size         = game_size / 4;
+	full->binary_file_count   = 8;
+	full->item_mode           = encoding_t::mode3;
+	full->object_count        = 256;
+	full->frame_count         = 16;
+	full->instances_per_frame = 1024;
+	full->sound_count         = 16;
+	full->sound_size          = game_size / 4 / 16;
+
+	return result;
+}
+
+static void Report(const bench_case_t &bench,
+                   const char *phase,
+                   size_t bytes,
+                   size_t items,
+                   double seconds,
+                   size_t arena_bytes)
+{
+	std::cout << "case=" << bench.name << " phase=" << phase
+	          << " bytes=" << bytes << " items=" << items << std::fixed
+	          << std::setprecision(4) << " seconds=" << seconds
+	          << std::setprecision(1) << " mib_per_s="
+	          << (seconds > 0.0 ? double(bytes) / 0x100000 / seconds : 0.0)
+	          << " arena_bytes=" << arena_bytes
+	          << " peak_rss_bytes=" << PeakRSS() << std::endl;
+}
+
+static bool RunCase(const bench_case_t &bench, const fs::path &folder)
+{
+	const fs::path game_path = folder / (bench.name + ".dat");
+
+	se::error_t saved = lak::ok_t{};
+	const double generate_seconds =
+	  time_seconds([&] { saved = se::SaveGame(bench.spec, game_path); });
+	if (saved.is_err())
+	{
+		std::cerr << bench.name << ": failed to write " << game_path << "\n";
+		return false;
+	}
+	const size_t game_size = size_t(fs::file_size(game_path));
+	Report(bench,
+	       "generate",
+	       game_size,
+	       bench.spec.images.size(),
+	       generate_seconds,
+	       0);
+
+	// Nothing is kept between cases except the thread pool.
+	auto srcexp         = std::make_unique<se::source_explorer_t>();
+	srcexp->baby_mode   = false;
+	srcexp->cache_index = false;
+	srcexp->exe.path    = game_path;
+
+	se::error_t loaded = lak::ok_t{};
+	const double load_seconds =
+	  time_seconds([&] { loaded = se::LoadGame(*srcexp); });
+	if (loaded.is_err())
+	{
+		std::cerr << bench.name << ": "
+		          << lak::to_astring(lak::streamify(loaded.unsafe_unwrap_err()))
+		          << "\n";
+		return false;
+	}
+	srcexp->loaded = true;
+	auto &game     = srcexp->state.game;
+
+	const size_t image_count =
+	  game.image_bank ? game.image_bank->items.size() : 0;
+	const size_t binary_count =
+	  game.binary_files ? game.binary_files->items.size() : 0;
+	const size_t sound_count =
+	  game.sound_bank ? game.sound_bank->items.size() : 0;
+	const size_t object_count =
+	  game.object_bank ? game.object_bank->items.size() : 0;
+	const size_t frame_count =
+	  game.frame_bank ? game.frame_bank->items.size() : 0;
+
+	const bool old_game = bench.spec.layout == se::game_layout_t::old;
+	const size_t expected_images = old_game ? 0 : bench.spec.images.size();
+	const size_t expected_binaries =
+	  bench.spec.binary_size > 0
+	    ? std::max<size_t>(bench.spec.binary_file_count, 1)
+	    : 0;
+	const size_t expected_sounds = old_game ? 0 : bench.spec.sound_count;
+	if (image_count != expected_images || binary_count != expected_binaries ||
+	    sound_count != expected_sounds ||
+	    object_count != bench.spec.object_count ||
+	    frame_count != bench.spec.frame_count)
+	{
+		std::cerr << bench.name << ": loaded " << image_count << " images, "
+		          << binary_count << " binary files, " << sound_count
+		          << " sounds, " << object_count << " objects and "
+		          << frame_count << " frames, expected " << expected_images
+		          << ", " << expected_binaries << ", " << expected_sounds
+		          << ", " << bench.spec.object_count << " and "
+		          << bench.spec.frame_count << "\n";
+		return false;
+	}
+	Report(bench,
+	       "load",
+	       game_size,
+	       image_count + binary_count + sound_count + object_count +
+	         frame_count,
+	       load_seconds,
+	       srcexp->state.arena->reserved());
+
+	if (image_count > 0)
+	{
+		std::atomic<size_t> decoded_bytes = 0;
+		std::atomic<size_t> decode_failed = 0;
+		auto decode_all                   = [&](size_t index)
+		{
+			auto image = game.image_bank->items[index].image(false);
+			if (image.is_err())
+				++decode_failed;
+			else
+				decoded_bytes += image.unsafe_unwrap().contig_size() * 4;
+		};
+		const double decode_seconds = time_seconds(
+		  [&] { se::parallel_for(image_count, decode_all); });
+		if (decode_failed > 0)
+		{
+			std::cerr << bench.name << ": " << decode_failed
+			          << " images failed to decode\n";
+			return false;
+		}
+		Report(bench,
+		       "decode",
+		       decoded_bytes,
+		       image_count,
+		       decode_seconds,
+		       srcexp->state.arena->reserved());
+	}
+
+	auto dump = [&](const char *phase,
+	                se::file_state_t &file_state,
+	                se::dump_function_t *func)
+	{
+		file_state.path = folder / (bench.name + "-" + phase);
+		fs::remove_all(file_state.path);
+		fs::create_directories(file_state.path);
+		se::job_t job;
+		const double seconds = time_seconds([&] { func(*srcexp, job); });
+		fs::remove_all(file_state.path);
+		if (job.failed > 0)
+		{
+			std::cerr << bench.name << ": " << job.failed
+			          << " files failed to dump\n";
+			return false;
+		}
+		Report(bench,
+		       phase,
+		       job.bytes,
+		       job.items,
+		       seconds,
+		       srcexp->state.arena->reserved());
+		return true;
+	};
+
+	if (image_count > 0 &&
+	    !dump("dump-images", srcexp->images, &se::DumpImages))
+		return false;
+
+	if (binary_count > 0 &&
+	    !dump("dump-binary-files", srcexp->binary_files, &se::DumpBinaryFiles))
+		return false;
+
+	if (sound_count > 0 && !dump("dump-sounds", srcexp->sounds, &se::DumpSounds))
+		return false;
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const size_t game_size =
+	  size_t(argc > 1 ? std::atoi(argv[1]) : 8) * 0x100000;
+	const fs::path folder = argc > 2
+	                          ? fs::path(argv[2])
+	                          : fs::temp_directory_path() / "srcexp-load-bench";
+	if (game_size == 0)
+	{
+		std::cerr << "load-bench [<MiB per game> [<work folder>]]\n";
+		return 1;
+	}
+
+	std::error_code err;
+	fs::create_directories(folder, err);
+	if (err)
+	{
+		std::cerr << "Failed to create " << folder << ": " << err.message()
+		          << "\n";
+		return 1;
+	}
+
+	bool ok = true;
+	for (const auto &bench : BenchCases(game_size))
+		ok = RunCase(bench, folder) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Writes one synthetic game, for fuzzers, regression tests and benchmarks
+// that need a reproducible input of a particular shape or size.
+// make-game [-<option> <value> ...] <output file>
+//
+// Sizes take an optional k, m or g suffix (binary multiples). Modes are the
+// chunk encoding numbers, 0 to 4.
+
+#include "game_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace se = SourceExplorer;
+
+static const char usage[] =
+  "make-game [-layout old|ascii|unicode|2.5+] [-build <product build>]\n"
+  "          [-seed <n>] [-exe] [-pack-files <n>] [-pack-file-size <size>]\n"
+  "          [-string-mode <mode>] [-binary-size <size>]\n"
+  "          [-binary-files <n>] [-binary-mode <mode>] [-item-mode <mode>]\n"
+  "          [-images <n>] [-image-size <pixels>] [-objects <n>]\n"
+  "          [-frames <n>] [-instances <n per frame>] [-sounds <n>]\n"
+  "          [-sound-size <size>] <output file>\n";
+
+static bool ParseSize(const char *str, size_t &result)
+{
+	char *end      = nullptr;
+	uint64_t value = std::strtoull(str, &end, 10);
+	if (end == str) return false;
+	switch (*end)
+	{
+		case 'g':
+		case 'G': value <<= 10; [[fallthrough]];
+		case 'm':
+		case 'M': value <<= 10; [[fallthrough]];
+		case 'k':
+		case 'K':
+			value <<= 10;
+			++end;
+			break;
+		default: break;
+	}
+	if (*end != '\0') return false;
+	result = size_t(value);
+	return true;
+}
+
+static bool ParseMode(const char *str, se::encoding_t &result)
+{
+	size_t mode;
+	if (!ParseSize(str, mode) || mode > size_t(se::encoding_t::mode4))
+		return false;
+	result = se::encoding_t(mode);
+	return true;
+}
+
+static bool ParseLayout(const std::string &str, se::game_layout_t &result)
+{
+	for (const auto layout : {se::game_layout_t::old,
+	                          se::game_layout_t::ascii,
+	                          se::game_layout_t::unicode,
+	                          se::game_layout_t::two_five_plus})
+	{
+		if (str != se::game_layout_name(layout)) continue;
+		result = layout;
+		return true;
+	}
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	se::game_spec_t spec;
+	fs::path output;
+	size_t image_count = 0;
+	size_t image_size  = 64;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		const std::string name = argv[arg];
+
+		if (name == "-exe")
+		{
+			spec.pe_stub = true;
+			continue;
+		}
+
+		if (name.empty() || name[0] != '-')
+		{
+			output = argv[arg];
+			continue;
+		}
+
+		if (++arg >= argc)
+		{
+			std::cerr << "Missing value for " << name << "\n" << usage;
+			return 1;
+		}
+		const char *value = argv[arg];
+
+		size_t number = 0;
+		bool ok       = true;
+		if (name == "-layout")
+			ok = ParseLayout(value, spec.layout);
+		else if (name == "-string-mode")
+			ok = ParseMode(value, spec.string_mode);
+		else if (name == "-binary-mode")
+			ok = ParseMode(value, spec.binary_mode);
+		else if (name == "-item-mode")
+			ok = ParseMode(value, spec.item_mode);
+		else if ((ok = ParseSize(value, number)))
+		{
+			if (name == "-build")
+				spec.product_build = uint32_t(number);
+			else if (name == "-seed")
+				spec.seed = number;
+			else if (name == "-pack-files")
+				spec.pack_file_count = number;
+			else if (name == "-pack-file-size")
+				spec.pack_file_size = number;
+			else if (name == "-binary-size")
+				spec.binary_size = number;
+			else if (name == "-binary-files")
+				spec.binary_file_count = number;
+			else if (name == "-images")
+				image_count = number;
+			else if (name == "-image-size")
+				image_size = number;
+			else if (name == "-objects")
+				spec.object_count = number;
+			else if (name == "-frames")
+				spec.frame_count = number;
+			else if (name == "-instances")
+				spec.instances_per_frame = number;
+			else if (name == "-sounds")
+				spec.sound_count = number;
+			else if (name == "-sound-size")
+				spec.sound_size = number;
+			else
+				ok = false;
+		}
+
+		if (!ok)
+		{
+			std::cerr << "Bad option " << name << " " << value << "\n" << usage;
+			return 1;
+		}
+	}
+
+	if (output.empty())
+	{
+		std::cerr << usage;
+		return 1;
+	}
+
+	spec.images = se::SyntheticImages(
+	  image_count, uint16_t(std::min<size_t>(image_size, 0xFFFF)), spec.seed);
+
+	if (auto err = se::SaveGame(spec, output); err.is_err())
+	{
+		std::cerr << lak::to_astring(lak::streamify(err.unsafe_unwrap_err()))
+		          << "\n";
+		return 1;
+	}
+
+	std::cout << output.string() << ": " << fs::file_size(output)
+	          << " bytes\n";
+	return 0;
+}
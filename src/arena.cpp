@@ -0,0 +1,207 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace SourceExplorer
+{
+	decode_arena_t::~decode_arena_t() = default;
+
+	size_t decode_arena_t::size_class(size_t size)
+	{
+		size_t result = 0;
+		while ((min_class_size << result) < size) ++result;
+		return result;
+	}
+
+	size_t decode_arena_t::capacity(size_t size)
+	{
+		if (size == 0) return 0;
+		if (size > max_class_size) return size;
+		return min_class_size << size_class(size);
+	}
+
+	decode_arena_t::region_t &decode_arena_t::this_region()
+	{
+		// Threads are handed out regions round robin the first time they
+		// allocate from any arena.
+		static std::atomic<size_t> next_region = 0;
+		thread_local const size_t region =
+		  next_region.fetch_add(1, std::memory_order_relaxed) % region_count;
+		return _regions[region];
+	}
+
+	void decode_arena_t::region_t::retire_block_tail()
+	{
+		// Carve whatever is left of the current block into the free lists
+		// rather than throwing it away. Every allocation is a multiple of
+		// min_class_size, so the tail is too.
+		while (size_t(end - head) >= min_class_size)
+		{
+			size_t index = class_count - 1;
+			while ((min_class_size << index) > size_t(end - head)) --index;
+			auto *node   = reinterpret_cast<free_node_t *>(head);
+			node->next   = free[index];
+			free[index]  = node;
+			head        += min_class_size << index;
+		}
+		head = end = nullptr;
+	}
+
+	byte_t *decode_arena_t::allocate(size_t size)
+	{
+		if (size == 0) return nullptr;
+
+		if (size > max_class_size)
+		{
+			// Too big to share a block with anything else.
+			byte_t *result = new byte_t[size];
+			_in_use.fetch_add(size, std::memory_order_relaxed);
+			add_reserved(size);
+			return result;
+		}
+
+		const size_t index      = size_class(size);
+		const size_t class_size = min_class_size << index;
+
+		_in_use.fetch_add(class_size, std::memory_order_relaxed);
+
+		region_t &region = this_region();
+		std::lock_guard lock(region.mutex);
+
+		if (free_node_t *node = region.free[index]; node)
+		{
+			region.free[index] = node->next;
+			return reinterpret_cast<byte_t *>(node);
+		}
+
+		if (size_t(region.end - region.head) < class_size)
+		{
+			region.retire_block_tail();
+			region.blocks.emplace_back(new byte_t[block_size]);
+			region.head = region.blocks.back().get();
+			region.end  = region.head + block_size;
+			add_reserved(block_size);
+		}
+
+		byte_t *result  = region.head;
+		region.head    += class_size;
+		return result;
+	}
+
+	void decode_arena_t::deallocate(byte_t *ptr, size_t size)
+	{
+		if (!ptr) return;
+
+		if (size > max_class_size)
+		{
+			// Not part of a block, this always has to go back to the system.
+			delete[] ptr;
+			_in_use.fetch_sub(size, std::memory_order_relaxed);
+			_reserved.fetch_sub(size, std::memory_order_relaxed);
+			return;
+		}
+
+		if (_abandoned.load(std::memory_order_relaxed)) return;
+
+		const size_t index = size_class(size);
+
+		_in_use.fetch_sub(min_class_size << index, std::memory_order_relaxed);
+
+		region_t &region = this_region();
+		std::lock_guard lock(region.mutex);
+		auto *node          = reinterpret_cast<free_node_t *>(ptr);
+		node->next          = region.free[index];
+		region.free[index]  = node;
+	}
+
+	void decode_arena_t::abandon()
+	{
+		_abandoned.store(true, std::memory_order_relaxed);
+	}
+
+	size_t decode_arena_t::in_use() const
+	{
+		return _in_use.load(std::memory_order_relaxed);
+	}
+
+	size_t decode_arena_t::reserved() const
+	{
+		return _reserved.load(std::memory_order_relaxed);
+	}
+
+	void decode_arena_t::set_budget(size_t bytes)
+	{
+		_budget.store(bytes, std::memory_order_relaxed);
+		if (bytes && reserved() > bytes)
+			_over.store(true, std::memory_order_relaxed);
+	}
+
+	bool decode_arena_t::over_budget() const
+	{
+		return _over.load(std::memory_order_relaxed);
+	}
+
+	void decode_arena_t::add_reserved(size_t size)
+	{
+		const size_t reserved =
+		  _reserved.fetch_add(size, std::memory_order_relaxed) + size;
+		if (const size_t budget = _budget.load(std::memory_order_relaxed);
+		    budget && reserved > budget)
+			_over.store(true, std::memory_order_relaxed);
+	}
+
+	void arena_buffer_t::reserve(size_t new_capacity)
+	{
+		if (new_capacity <= _capacity) return;
+
+		// Grow geometrically so appending a byte at a time stays linear.
+		new_capacity = decode_arena_t::capacity(
+		  std::max(new_capacity, _capacity + (_capacity / 2)));
+
+		byte_t *new_data = _arena->allocate(new_capacity);
+		if (_size > 0) std::memcpy(new_data, _data, _size);
+		if (_data) _arena->deallocate(_data, _capacity);
+
+		_data     = new_data;
+		_capacity = new_capacity;
+	}
+
+	void arena_buffer_t::resize(size_t new_size)
+	{
+		reserve(new_size);
+		_size = new_size;
+	}
+
+	void arena_buffer_t::append(lak::span<const byte_t> bytes)
+	{
+		if (bytes.size() == 0) return;
+		reserve(_size + bytes.size());
+		std::memcpy(_data + _size, bytes.data(), bytes.size());
+		_size += bytes.size();
+	}
+}
@@ -0,0 +1,216 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_ARENA_H
+#define SOURCE_EXPLORER_ARENA_H
+
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace SourceExplorer
+{
+	// Region allocator for the buffers decoded while loading (and browsing)
+	// one game. Requests up to max_class_size are rounded up to a power of two
+	// size class and bump allocated out of large blocks, freed memory goes on
+	// a per class free list for reuse. Each thread allocates from its own
+	// region (blocks, free lists and lock), so threads decoding side by side
+	// don't contend. Nothing is returned to the system until the arena itself
+	// is destroyed, which releases every block at once.
+	struct decode_arena_t
+	{
+		static constexpr size_t min_class_shift = 6;  // 64B
+		static constexpr size_t max_class_shift = 20; // 1MiB
+		static constexpr size_t class_count =
+		  max_class_shift - min_class_shift + 1;
+		static constexpr size_t min_class_size = size_t(1) << min_class_shift;
+		static constexpr size_t max_class_size = size_t(1) << max_class_shift;
+		static constexpr size_t block_size     = 0x400000; // 4MiB
+		static constexpr size_t region_count   = 16;
+
+		decode_arena_t()                       = default;
+		decode_arena_t(const decode_arena_t &) = delete;
+		decode_arena_t &operator=(const decode_arena_t &) = delete;
+		~decode_arena_t();
+
+		// Number of usable bytes allocate(size) actually returns.
+		static size_t capacity(size_t size);
+
+		// Returns nullptr for size 0.
+		byte_t *allocate(size_t size);
+
+		// size may be either the size originally requested or its capacity.
+		void deallocate(byte_t *ptr, size_t size);
+
+		// Everything allocated from the arena is about to be destroyed, stop
+		// putting memory back on the free lists. The blocks are all released
+		// together when the arena is, so tearing down a game doesn't take a
+		// lock per object.
+		void abandon();
+
+		// Bytes handed out and not yet deallocated.
+		size_t in_use() const;
+
+		// Bytes held by the arena, including free lists and unused block space.
+		size_t reserved() const;
+
+		// Most bytes the arena should reserve, 0 for no limit. Going over
+		// doesn't fail the allocation, decoders check over_budget and give up
+		// instead.
+		void set_budget(size_t bytes);
+
+		// Whether reserved() has exceeded the budget at any point.
+		bool over_budget() const;
+
+	private:
+		struct free_node_t
+		{
+			free_node_t *next;
+		};
+
+		struct region_t
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<byte_t[]>> blocks;
+			byte_t *head                   = nullptr;
+			byte_t *end                    = nullptr;
+			free_node_t *free[class_count] = {};
+
+			void retire_block_tail();
+		};
+
+		static size_t size_class(size_t size);
+
+		// The region the calling thread allocates from and frees to. Memory
+		// can be freed by a different thread (region) than allocated it.
+		region_t &this_region();
+
+		void add_reserved(size_t size);
+
+		region_t _regions[region_count];
+		std::atomic<size_t> _in_use   = 0;
+		std::atomic<size_t> _reserved = 0;
+		std::atomic<bool> _abandoned  = false;
+		std::atomic<size_t> _budget   = 0;
+		std::atomic<bool> _over       = false;
+	};
+
+	// Minimal allocator so shared_ptr control blocks can live in an arena too.
+	template<typename T>
+	struct arena_allocator_t
+	{
+		using value_type = T;
+
+		std::shared_ptr<decode_arena_t> arena;
+
+		arena_allocator_t(std::shared_ptr<decode_arena_t> a)
+		: arena(std::move(a))
+		{
+		}
+
+		template<typename U>
+		arena_allocator_t(const arena_allocator_t<U> &other)
+		: arena(other.arena)
+		{
+		}
+
+		T *allocate(size_t n)
+		{
+			return reinterpret_cast<T *>(arena->allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T *ptr, size_t n)
+		{
+			arena->deallocate(reinterpret_cast<byte_t *>(ptr), n * sizeof(T));
+		}
+
+		template<typename U>
+		bool operator==(const arena_allocator_t<U> &other) const
+		{
+			return arena == other.arena;
+		}
+	};
+
+	// Growable byte buffer backed by a decode arena, decoders build their
+	// output in one of these and hand the memory over to a _data_ref.
+	struct arena_buffer_t
+	{
+		arena_buffer_t(std::shared_ptr<decode_arena_t> arena)
+		: _arena(std::move(arena))
+		{
+		}
+
+		arena_buffer_t(const arena_buffer_t &) = delete;
+		arena_buffer_t &operator=(const arena_buffer_t &) = delete;
+
+		arena_buffer_t(arena_buffer_t &&other)
+		: _arena(std::move(other._arena)),
+		  _data(std::exchange(other._data, nullptr)),
+		  _size(std::exchange(other._size, 0)),
+		  _capacity(std::exchange(other._capacity, 0))
+		{
+		}
+
+		arena_buffer_t &operator=(arena_buffer_t &&) = delete;
+
+		~arena_buffer_t()
+		{
+			if (_data) _arena->deallocate(_data, _capacity);
+		}
+
+		inline size_t size() const { return _size; }
+		inline size_t capacity() const { return _capacity; }
+		inline byte_t *data() const { return _data; }
+		inline lak::span<byte_t> span() const { return {_data, _size}; }
+		inline const std::shared_ptr<decode_arena_t> &arena() const
+		{
+			return _arena;
+		}
+
+		void reserve(size_t new_capacity);
+		void resize(size_t new_size);
+		void append(lak::span<const byte_t> bytes);
+
+		// Give up ownership of the memory, it must later be returned with
+		// arena()->deallocate(data, capacity).
+		void release()
+		{
+			_data     = nullptr;
+			_size     = 0;
+			_capacity = 0;
+		}
+
+	private:
+		std::shared_ptr<decode_arena_t> _arena;
+		byte_t *_data    = nullptr;
+		size_t _size     = 0;
+		size_t _capacity = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_BATCH_EVENTS_HPP
+#define SOURCE_EXPLORER_BATCH_EVENTS_HPP
+
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace SourceExplorer
+{
+	// The headless modes report progress as JSON lines on stdout, one event
+	// object per line, e.g. {"event":"done","stage":"images","items":12}
+
+	template<typename STR>
+	std::string JsonString(const STR &str)
+	{
+		std::string result = "\"";
+		for (const auto c : str)
+		{
+			const auto u = static_cast<unsigned char>(c);
+			if (u == '"' || u == '\\')
+				(result += '\\') += char(u);
+			else if (u < 0x20)
+			{
+				char escape[8];
+				std::snprintf(escape, sizeof(escape), "\\u%04x", unsigned(u));
+				result += escape;
+			}
+			else
+				result += char(u);
+		}
+		return result += '"';
+	}
+
+	// "name":value, strings are quoted and escaped.
+	template<typename T>
+	std::string JsonField(const char *name, const T &value)
+	{
+		std::ostringstream strm;
+		strm << '"' << name << "\":";
+		if constexpr (std::is_same_v<T, bool>)
+			strm << (value ? "true" : "false");
+		else if constexpr (std::is_arithmetic_v<T>)
+			strm << value;
+		else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+			strm << JsonString(std::string_view(value));
+		else
+			strm << JsonString(value);
+		return strm.str();
+	}
+
+	// Join fields into one event line.
+	template<typename... FIELDS>
+	std::string JsonEvent(const char *event, const FIELDS &...fields)
+	{
+		std::string result = "{\"event\":\"";
+		result += event;
+		result += '"';
+		((result += ',', result += fields), ...);
+		return result += '}';
+	}
+
+	// Write line to stdout, flushed so whatever is reading sees progress as it
+	// happens. Safe to call from several threads at once.
+	inline void BatchLine(const std::string &line)
+	{
+		static std::mutex mutex;
+		std::lock_guard lock(mutex);
+		std::cout << line << std::endl;
+	}
+
+	template<typename... FIELDS>
+	void BatchEvent(const char *event, const FIELDS &...fields)
+	{
+		BatchLine(JsonEvent(event, fields...));
+	}
+}
+
+#endif
@@ -0,0 +1,368 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "chunk_index.h"
+#include "explorer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace SourceExplorer
+{
+	// "SEIX"
+	static const uint32_t INDEX_MAGIC = 0x58494553;
+
+	uint64_t chunk_index_t::hash(lak::span<const byte_t> data)
+	{
+		// Four lane multiply-rotate hash in the style of xxHash64, this only
+		// needs to tell builds apart, not resist attacks.
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+		constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+		constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+		auto rotl = [](uint64_t v, int r) -> uint64_t
+		{ return (v << r) | (v >> (64 - r)); };
+
+		auto round = [&](uint64_t acc, uint64_t input) -> uint64_t
+		{
+			acc += input * prime2;
+			acc = rotl(acc, 31);
+			return acc * prime1;
+		};
+
+		auto read64 = [](const byte_t *ptr) -> uint64_t
+		{
+			uint64_t result;
+			std::memcpy(&result, ptr, sizeof(result));
+			return result;
+		};
+
+		const byte_t *ptr = data.data();
+		const byte_t *end = ptr + data.size();
+
+		uint64_t result;
+		if (data.size() >= 32)
+		{
+			uint64_t v1 = prime1 + prime2;
+			uint64_t v2 = prime2;
+			uint64_t v3 = 0;
+			uint64_t v4 = 0 - prime1;
+
+			for (; end - ptr >= 32; ptr += 32)
+			{
+				v1 = round(v1, read64(ptr));
+				v2 = round(v2, read64(ptr + 8));
+				v3 = round(v3, read64(ptr + 16));
+				v4 = round(v4, read64(ptr + 24));
+			}
+
+			result = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			for (uint64_t v : {v1, v2, v3, v4})
+			{
+				result ^= round(0, v);
+				result = result * prime1 + prime4;
+			}
+		}
+		else
+		{
+			result = prime5;
+		}
+
+		result += data.size();
+
+		for (; end - ptr >= 8; ptr += 8)
+		{
+			result ^= round(0, read64(ptr));
+			result = rotl(result, 27) * prime1 + prime4;
+		}
+
+		for (; ptr < end; ++ptr)
+		{
+			result ^= uint64_t(*ptr) * prime5;
+			result = rotl(result, 11) * prime1;
+		}
+
+		result ^= result >> 33;
+		result *= prime2;
+		result ^= result >> 29;
+		result *= prime3;
+		result ^= result >> 32;
+
+		return result;
+	}
+
+	uint64_t chunk_index_t::sample_hash(lak::span<const byte_t> data)
+	{
+		constexpr size_t edge_size   = 0x10000;
+		constexpr size_t page_size   = 0x1000;
+		constexpr size_t page_count  = 64;
+		constexpr size_t sample_size = 2 * edge_size + page_count * page_size;
+
+		if (data.size() <= sample_size) return hash(data);
+
+		std::vector<uint64_t> hashes;
+		hashes.reserve(page_count + 2);
+		hashes.push_back(hash(data.first(edge_size)));
+		const size_t stride = (data.size() - page_size) / page_count;
+		for (size_t i = 0; i < page_count; ++i)
+			hashes.push_back(hash(data.subspan(i * stride, page_size)));
+		hashes.push_back(hash(data.subspan(data.size() - edge_size)));
+
+		return hash(lak::span<const byte_t>(
+		  reinterpret_cast<const byte_t *>(hashes.data()),
+		  hashes.size() * sizeof(uint64_t)));
+	}
+
+	static std::filesystem::path CacheFolder()
+	{
+		std::error_code err;
+#ifdef _WIN32
+		if (const char *local = std::getenv("LOCALAPPDATA"); local && *local)
+			return std::filesystem::path(local) / "SourceExplorer" / "index";
+#else
+		if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+			return std::filesystem::path(xdg) / "SourceExplorer" / "index";
+		if (const char *home = std::getenv("HOME"); home && *home)
+			return std::filesystem::path(home) / ".cache" / "SourceExplorer" /
+			       "index";
+#endif
+		return std::filesystem::temp_directory_path(err) / "SourceExplorer" /
+		       "index";
+	}
+
+	std::filesystem::path chunk_index_t::path_for(
+	  const std::filesystem::path &game_path)
+	{
+		std::error_code err;
+		auto absolute = std::filesystem::absolute(game_path, err);
+		if (err) absolute = game_path;
+		const auto name = absolute.u8string();
+
+		char file_name[24];
+		std::snprintf(file_name,
+		              sizeof(file_name),
+		              "%016llx.seidx",
+		              static_cast<unsigned long long>(hash(lak::span<const byte_t>(
+		                reinterpret_cast<const byte_t *>(name.data()),
+		                name.size()))));
+		return CacheFolder() / file_name;
+	}
+
+	const item_record_t *chunk_index_t::find_item(const index_key_t &key,
+	                                              uint32_t handle) const
+	{
+		auto it = items.find(key);
+		if (it == items.end() || it->second.handle != handle) return nullptr;
+		return &it->second;
+	}
+
+	void chunk_index_t::clear()
+	{
+		chunks.clear();
+		items.clear();
+	}
+
+	static error_t ReadIndex(chunk_index_t &index, data_reader_t &strm)
+	{
+		FUNCTION_CHECKPOINT();
+
+		TRY_ASSIGN(const uint32_t chunk_count =, strm.read_u32());
+		for (uint32_t i = 0; i < chunk_count; ++i)
+		{
+			index_key_t key;
+			chunk_record_t chunk;
+			TRY_ASSIGN(key.source =, strm.read_u64());
+			TRY_ASSIGN(key.offset =, strm.read_u64());
+			TRY_ASSIGN(chunk.size =, strm.read_u32());
+			TRY_ASSIGN(chunk.ID = (chunk_t), strm.read_u16());
+			TRY_ASSIGN(chunk.mode = (encoding_t), strm.read_u16());
+			index.chunks.emplace(key, chunk);
+		}
+
+		TRY_ASSIGN(const uint32_t item_count =, strm.read_u32());
+		for (uint32_t i = 0; i < item_count; ++i)
+		{
+			index_key_t key;
+			item_record_t item;
+			TRY_ASSIGN(key.source =, strm.read_u64());
+			TRY_ASSIGN(key.offset =, strm.read_u64());
+			TRY_ASSIGN(item.handle =, strm.read_u32());
+			TRY_ASSIGN(item.mode = (encoding_t), strm.read_u16());
+			TRY_ASSIGN(item.data_size =, strm.read_u32());
+			TRY_ASSIGN(item.expected_size =, strm.read_u32());
+			TRY_ASSIGN(item.has_image =, strm.read_u8());
+			if (item.has_image)
+			{
+				auto &image = item.image;
+				TRY_ASSIGN(image.checksum =, strm.read_u32());
+				TRY_ASSIGN(image.reference =, strm.read_u32());
+				TRY_ASSIGN(image.data_size =, strm.read_u32());
+				TRY_ASSIGN(image.width =, strm.read_u16());
+				TRY_ASSIGN(image.height =, strm.read_u16());
+				TRY_ASSIGN(image.graphics_mode = (graphics_mode_t), strm.read_u8());
+				TRY_ASSIGN(image.flags = (image_flag_t), strm.read_u8());
+				TRY_ASSIGN(image.unknown =, strm.read_u16());
+				TRY_ASSIGN(image.hotspot_x =, strm.read_u16());
+				TRY_ASSIGN(image.hotspot_y =, strm.read_u16());
+				TRY_ASSIGN(image.action_x =, strm.read_u16());
+				TRY_ASSIGN(image.action_y =, strm.read_u16());
+				for (auto &channel : image.transparent)
+				{
+					TRY_ASSIGN(channel =, strm.read_u8());
+				}
+				TRY_ASSIGN(image.data_position =, strm.read_u32());
+			}
+			index.items.emplace(key, item);
+		}
+
+		return lak::ok_t{};
+	}
+
+	bool chunk_index_t::load(const std::filesystem::path &path)
+	{
+		FUNCTION_CHECKPOINT("chunk_index_t::");
+
+		clear();
+
+		std::error_code err;
+		if (!std::filesystem::exists(path, err)) return false;
+
+		auto file = lak::read_file(path);
+		if (file.is_err())
+		{
+			DEBUG("Failed To Read Index");
+			return false;
+		}
+
+		data_reader_t strm(make_data_ref_ptr(file.unsafe_unwrap()));
+
+		auto header = [&]() -> error_t
+		{
+			TRY_ASSIGN(const uint32_t magic =, strm.read_u32());
+			TRY_ASSIGN(const uint32_t version =, strm.read_u32());
+			TRY_ASSIGN(const uint64_t size =, strm.read_u64());
+			TRY_ASSIGN(const uint64_t time =, strm.read_u64());
+			TRY_ASSIGN(const uint64_t hash =, strm.read_u64());
+			TRY_ASSIGN(const uint8_t is_compat =, strm.read_u8());
+
+			if (magic != INDEX_MAGIC || version != parser_version ||
+			    size != file_size || time != file_time || hash != file_hash ||
+			    bool(is_compat) != compat)
+				return lak::err_t{
+				  error(LINE_TRACE, error::str_err, "Stale Index")};
+
+			return lak::ok_t{};
+		}();
+
+		if (header.is_err())
+		{
+			DEBUG("Index Does Not Match: ", header.unsafe_unwrap_err());
+			return false;
+		}
+
+		if (auto result = ReadIndex(*this, strm); result.is_err())
+		{
+			WARNING("Failed To Read Index: ", result.unsafe_unwrap_err());
+			clear();
+			return false;
+		}
+
+		DEBUG("Loaded Index With ",
+		      chunks.size(),
+		      " Chunks And ",
+		      items.size(),
+		      " Items");
+
+		return true;
+	}
+
+	bool chunk_index_t::save(const std::filesystem::path &path) const
+	{
+		FUNCTION_CHECKPOINT("chunk_index_t::");
+
+		lak::binary_array_writer strm;
+
+		strm.write_u32(INDEX_MAGIC);
+		strm.write_u32(parser_version);
+		strm.write_u64(file_size);
+		strm.write_u64(file_time);
+		strm.write_u64(file_hash);
+		strm.write_u8(compat ? 1 : 0);
+
+		strm.write_u32(static_cast<uint32_t>(chunks.size()));
+		for (const auto &[key, chunk] : chunks)
+		{
+			strm.write_u64(key.source);
+			strm.write_u64(key.offset);
+			strm.write_u32(chunk.size);
+			strm.write_u16(static_cast<uint16_t>(chunk.ID));
+			strm.write_u16(static_cast<uint16_t>(chunk.mode));
+		}
+
+		strm.write_u32(static_cast<uint32_t>(items.size()));
+		for (const auto &[key, item] : items)
+		{
+			strm.write_u64(key.source);
+			strm.write_u64(key.offset);
+			strm.write_u32(item.handle);
+			strm.write_u16(static_cast<uint16_t>(item.mode));
+			strm.write_u32(item.data_size);
+			strm.write_u32(item.expected_size);
+			strm.write_u8(item.has_image ? 1 : 0);
+			if (item.has_image)
+			{
+				const auto &image = item.image;
+				strm.write_u32(image.checksum);
+				strm.write_u32(image.reference);
+				strm.write_u32(image.data_size);
+				strm.write_u16(image.width);
+				strm.write_u16(image.height);
+				strm.write_u8(static_cast<uint8_t>(image.graphics_mode));
+				strm.write_u8(static_cast<uint8_t>(image.flags));
+				strm.write_u16(image.unknown);
+				strm.write_u16(image.hotspot_x);
+				strm.write_u16(image.hotspot_y);
+				strm.write_u16(image.action_x);
+				strm.write_u16(image.action_y);
+				for (const auto &channel : image.transparent)
+					strm.write_u8(channel);
+				strm.write_u32(image.data_position);
+			}
+		}
+
+		std::error_code err;
+		std::filesystem::create_directories(path.parent_path(), err);
+		if (err || !lak::save_file(path, strm.release()))
+		{
+			DEBUG("Failed To Save Index To ", path);
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,138 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_CHUNK_INDEX_H
+#define SOURCE_EXPLORER_CHUNK_INDEX_H
+
+#include "defines.h"
+
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+#include <unordered_map>
+
+namespace SourceExplorer
+{
+	// Identifies a chunk or item by the root position of the buffer it was
+	// read from (0 for the file itself, otherwise the position of the encoded
+	// data it was decoded from) and its offset within that buffer.
+	struct index_key_t
+	{
+		uint64_t source;
+		uint64_t offset;
+
+		bool operator==(const index_key_t &) const = default;
+	};
+
+	struct index_key_hash_t
+	{
+		size_t operator()(const index_key_t &key) const
+		{
+			return size_t(key.source * 0x9E3779B97F4A7C15ULL ^ key.offset);
+		}
+	};
+
+	struct chunk_record_t
+	{
+		uint32_t size;
+		chunk_t ID;
+		encoding_t mode;
+	};
+
+	struct image_record_t
+	{
+		uint32_t checksum;
+		uint32_t reference;
+		uint32_t data_size;
+		uint16_t width;
+		uint16_t height;
+		graphics_mode_t graphics_mode;
+		image_flag_t flags;
+		uint16_t unknown;
+		uint16_t hotspot_x;
+		uint16_t hotspot_y;
+		uint16_t action_x;
+		uint16_t action_y;
+		uint8_t transparent[4];
+		uint32_t data_position;
+	};
+
+	struct item_record_t
+	{
+		uint32_t handle;
+		encoding_t mode;
+		uint32_t data_size;
+		uint32_t expected_size;
+		bool has_image = false;
+		image_record_t image;
+	};
+
+	// Index of every chunk and item in a game, so reopening an unchanged
+	// file can skip the expensive parts of parsing (inflating old game items
+	// to find their size, inflating image headers). Indices are kept in the
+	// user's cache folder, never next to the game.
+	struct chunk_index_t
+	{
+		// Bump whenever the parser changes what it reads from a file, indices
+		// written by an older parser are then ignored.
+		static constexpr uint32_t parser_version = 2;
+
+		uint64_t file_size = 0;
+		// Last write time, in the filesystem clock's ticks.
+		uint64_t file_time = 0;
+		uint64_t file_hash = 0;
+		bool compat        = false;
+
+		std::unordered_map<index_key_t, chunk_record_t, index_key_hash_t>
+		  chunks;
+		std::unordered_map<index_key_t, item_record_t, index_key_hash_t> items;
+
+		static uint64_t hash(lak::span<const byte_t> data);
+
+		// Hash of the start and end of data and a few pages spread evenly
+		// between them, so large games aren't faulted in just to find their
+		// index. Together with the size and write time this is enough to spot
+		// a game that was replaced or rebuilt.
+		static uint64_t sample_hash(lak::span<const byte_t> data);
+
+		// Where the index for game_path is kept, named after a hash of its
+		// absolute path.
+		static std::filesystem::path path_for(
+		  const std::filesystem::path &game_path);
+
+		const item_record_t *find_item(const index_key_t &key,
+		                               uint32_t handle) const;
+
+		// file_size, file_time, file_hash and compat must already be set.
+		// Returns false if the index is missing, corrupt or was written for a
+		// different file or parser version.
+		bool load(const std::filesystem::path &path);
+
+		bool save(const std::filesystem::path &path) const;
+
+		void clear();
+	};
+}
+
+#endif
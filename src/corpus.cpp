@@ -0,0 +1,326 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "corpus.h"
+#include "batch_events.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace se = SourceExplorer;
+
+namespace
+{
+	using corpus_clock_t = std::chrono::steady_clock;
+
+	double SecondsSince(corpus_clock_t::time_point start)
+	{
+		return std::chrono::duration<double>(corpus_clock_t::now() - start)
+		  .count();
+	}
+
+	template<typename BANK>
+	size_t ItemCount(const BANK &bank)
+	{
+		return bank ? bank->items.size() : 0;
+	}
+
+	struct corpus_game_t
+	{
+		fs::path path;
+		fs::path out;
+	};
+
+	struct corpus_totals_t
+	{
+		std::mutex mutex;
+		size_t loaded      = 0;
+		size_t load_failed = 0;
+		size_t dump_failed = 0;
+		size_t over_budget = 0;
+		size_t files       = 0;
+		size_t bytes       = 0;
+		size_t failed      = 0;
+	};
+}
+
+std::vector<fs::path> se::FindCorpusGames(const fs::path &input)
+{
+	std::vector<fs::path> result;
+	std::error_code err;
+
+	if (fs::is_directory(input, err))
+	{
+		for (fs::recursive_directory_iterator it(
+		       input, fs::directory_options::skip_permission_denied, err),
+		     end;
+		     !err && it != end;
+		     it.increment(err))
+		{
+			if (!it->is_regular_file(err)) continue;
+			auto extension = it->path().extension().string();
+			for (auto &c : extension) c = char(std::tolower((unsigned char)c));
+			if (extension == ".exe" || extension == ".dat" || extension == ".ccn")
+				result.push_back(it->path());
+		}
+		if (err) ERROR("File System Error: (", err.value(), ")", err.message());
+
+		// Directory order isn't stable, keep reports comparable between runs.
+		std::sort(result.begin(), result.end());
+	}
+	else
+	{
+		std::ifstream list(input);
+		for (std::string line; std::getline(list, line);)
+		{
+			while (!line.empty() && std::isspace((unsigned char)line.back()))
+				line.pop_back();
+			if (line.empty() || line.front() == '#') continue;
+			result.push_back(fs::path(std::u8string(line.begin(), line.end())));
+		}
+	}
+
+	return result;
+}
+
+se::batch_status_t se::CorpusDump(const source_explorer_t &settings,
+                                  const corpus_options_t &options)
+{
+	std::vector<const batch_dump_t *> dumps;
+	if (!FindBatchDumps(options.dumps, dumps)) return batch_status_t::usage;
+
+	std::error_code err;
+	if (!fs::exists(options.input, err))
+	{
+		BatchEvent("error",
+		           JsonField("stage", "arguments"),
+		           JsonField("message", "corpus input does not exist"));
+		return batch_status_t::usage;
+	}
+
+	fs::create_directories(options.out, err);
+	if (err)
+	{
+		BatchEvent("error",
+		           JsonField("stage", "arguments"),
+		           JsonField("message", err.message()));
+		return batch_status_t::usage;
+	}
+
+	// Every game gets its own output folder, named after the game where that
+	// doesn't clash with another one.
+	std::vector<corpus_game_t> games;
+	{
+		std::map<fs::path, size_t> names;
+		for (auto &path : FindCorpusGames(options.input))
+		{
+			fs::path name = path.stem();
+			if (const size_t count = names[name]++; count > 0)
+				name += " (" + std::to_string(count) + ")";
+			games.push_back({lak::move(path), options.out / name});
+		}
+	}
+
+	auto &pool                 = thread_pool_t::global();
+	const size_t games_at_once = std::min(
+	  games.size(),
+	  options.games_at_once ? options.games_at_once
+	                        : std::max<size_t>(1, (pool.size() + 1) / 2));
+
+	BatchEvent("corpus",
+	           JsonField("games", games.size()),
+	           JsonField("games_at_once", games_at_once));
+
+	std::ofstream report(options.out / "report.jsonl");
+	corpus_totals_t totals;
+	const auto corpus_start = corpus_clock_t::now();
+
+	auto RunGame = [&](size_t index)
+	{
+		const auto &game = games[index];
+
+		// Nothing is shared between games except the thread pool (and the log).
+		auto srcexp                    = std::make_unique<source_explorer_t>();
+		srcexp->baby_mode              = false;
+		srcexp->dump_color_transparent = settings.dump_color_transparent;
+		srcexp->lazy_load              = settings.lazy_load;
+		srcexp->windowed_load          = settings.windowed_load;
+		srcexp->force_compat           = settings.force_compat;
+		srcexp->image_encoding         = settings.image_encoding;
+		srcexp->decode_cache_budget    = settings.decode_cache_budget;
+		srcexp->memory_budget          = options.memory_budget;
+		if (options.memory_budget)
+			srcexp->decode_cache_budget =
+			  std::min(srcexp->decode_cache_budget, options.memory_budget / 2);
+		// Triage runs are one-shot, don't leave an index behind for every
+		// game.
+		srcexp->cache_index = false;
+		srcexp->exe.path    = game.path;
+
+		// Decoding stops once the arena goes over the budget, so this is
+		// checked before blaming the game itself for the failure.
+		auto OverBudget = [&] { return srcexp->state.arena->over_budget(); };
+
+		const char *status = "ok";
+		lak::u8string message;
+		job_t job;
+		double load_seconds = 0.0;
+
+		try
+		{
+			const auto load_start = corpus_clock_t::now();
+			auto loaded           = LoadGame(*srcexp);
+			load_seconds          = SecondsSince(load_start);
+
+			if (OverBudget())
+			{
+				status = "over_budget";
+			}
+			else if (loaded.is_err())
+			{
+				status  = "load_failed";
+				message = lak::streamify(loaded.unsafe_unwrap_err());
+			}
+			else
+			{
+				srcexp->loaded = true;
+				for (const auto *dump : dumps)
+				{
+					file_state_t &file_state = srcexp.get()->*(dump->state);
+					file_state.path          = game.out / dump->name;
+					fs::create_directories(file_state.path);
+					dump->func(*srcexp, job);
+					if (OverBudget())
+					{
+						status = "over_budget";
+						break;
+					}
+				}
+				if (job.failed > 0 && status == std::string_view("ok"))
+					status = "dump_failed";
+			}
+		}
+		catch (const std::exception &e)
+		{
+			status  = "exception";
+			message = lak::to_u8string(lak::astring(e.what()));
+		}
+		job.finish();
+
+		const auto &state = srcexp->state;
+		const auto line   = JsonEvent(
+		  "game",
+		  JsonField("index", index),
+		  JsonField("path", game.path.u8string()),
+		  JsonField("status", status),
+		  JsonField("error", message),
+		  JsonField("product_build", state.product_build),
+		  JsonField("product_version", state.product_version),
+		  JsonField("runtime_version", unsigned(state.runtime_version)),
+		  JsonField("runtime_sub_version", state.runtime_sub_version),
+		  JsonField("unicode", state.unicode),
+		  JsonField("old_game", state.old_game),
+		  JsonField("frames", ItemCount(state.game.frame_bank)),
+		  JsonField("objects", ItemCount(state.game.object_bank)),
+		  JsonField("images", ItemCount(state.game.image_bank)),
+		  JsonField("sounds", ItemCount(state.game.sound_bank)),
+		  JsonField("music", ItemCount(state.game.music_bank)),
+		  JsonField("fonts", ItemCount(state.game.font_bank)),
+		  JsonField("unknown_chunks",
+		            state.game.unknown_chunks.size() +
+		              state.game.unknown_strings.size() +
+		              state.game.unknown_compressed.size()),
+		  JsonField("load_seconds", load_seconds),
+		  JsonField("dump_seconds", job.elapsed() - load_seconds),
+		  JsonField("files", job.items.load()),
+		  JsonField("bytes", job.bytes.load()),
+		  JsonField("failed", job.failed.load()),
+		  JsonField("arena_bytes", state.arena->reserved()));
+
+		BatchLine(line);
+		UnloadGame(*srcexp);
+
+		std::lock_guard lock(totals.mutex);
+		report << line << '\n';
+		const std::string_view result = status;
+		if (result == "ok" || result == "dump_failed")
+			++totals.loaded;
+		else if (result == "over_budget")
+			++totals.over_budget;
+		else
+			++totals.load_failed;
+		if (result == "dump_failed") ++totals.dump_failed;
+		totals.files += job.items;
+		totals.bytes += job.bytes;
+		totals.failed += job.failed;
+	};
+
+	std::atomic<size_t> next = 0;
+	auto Runner              = [&]
+	{
+		for (size_t i; (i = next.fetch_add(1)) < games.size();) RunGame(i);
+	};
+
+	if (games_at_once > 0)
+	{
+		task_group_t group(pool);
+		for (size_t i = 1; i < games_at_once; ++i) group.run(Runner);
+		Runner();
+		group.wait();
+	}
+
+	const auto summary =
+	  JsonEvent("summary",
+	            JsonField("games", games.size()),
+	            JsonField("loaded", totals.loaded),
+	            JsonField("load_failed", totals.load_failed),
+	            JsonField("dump_failed", totals.dump_failed),
+	            JsonField("over_budget", totals.over_budget),
+	            JsonField("files", totals.files),
+	            JsonField("bytes", totals.bytes),
+	            JsonField("failed", totals.failed),
+	            JsonField("seconds", SecondsSince(corpus_start)));
+	BatchLine(summary);
+	report << summary << '\n';
+
+	const batch_status_t status = totals.load_failed > 0
+	                                ? batch_status_t::load_failed
+	                              : totals.over_budget > 0
+	                                ? batch_status_t::over_budget
+	                              : totals.dump_failed > 0
+	                                ? batch_status_t::dump_failed
+	                                : batch_status_t::ok;
+
+	if (status != batch_status_t::ok)
+		if (const fs::path log_path = options.out / "error_log.txt";
+		    lak::save_file(log_path, lak::debugger.str()))
+			BatchEvent("log", JsonField("path", log_path.u8string()));
+
+	BatchEvent("finished", JsonField("status", int(status)));
+	return status;
+}
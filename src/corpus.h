@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_CORPUS_H
+#define SOURCE_EXPLORER_CORPUS_H
+
+#include "dump.h"
+#include "explorer.h"
+
+#include <string>
+#include <vector>
+
+namespace SourceExplorer
+{
+	struct corpus_options_t
+	{
+		// A folder to search (recursively) for games, or a text file listing
+		// one game path per line.
+		fs::path input;
+		// Each game is dumped into its own folder under here, the report is
+		// saved here too.
+		fs::path out;
+		// Names of the dumps to run on each game, empty to only parse them.
+		std::vector<std::string> dumps;
+		// Games loaded at once, 0 to pick based on the thread pool size.
+		size_t games_at_once = 0;
+		// Bytes each game may decode into its arena before it is abandoned,
+		// 0 for no limit. Also caps the game's decode cache.
+		size_t memory_budget = 0;
+	};
+
+	// Games srcexp would open from options.input.
+	std::vector<fs::path> FindCorpusGames(const fs::path &input);
+
+	// Load (and dump) every game in options.input concurrently on the shared
+	// thread pool, each with its own source_explorer_t set up like settings.
+	// One "game" event is written to stdout per game as it finishes and the
+	// same lines are saved to out/report.jsonl, followed by a "summary".
+	// Returns ok only if every game loaded and dumped cleanly.
+	batch_status_t CorpusDump(const source_explorer_t &settings,
+	                          const corpus_options_t &options);
+}
+
+#endif
@@ -0,0 +1,668 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "deflate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace SourceExplorer
+{
+	static constexpr size_t min_match     = 3;
+	static constexpr size_t max_match     = 258;
+	static constexpr size_t min_lookahead = max_match + min_match + 1;
+	static constexpr size_t stored_max    = 0xFFFF;
+
+	static constexpr uint16_t length_base[29] = {
+	  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+	  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	static constexpr uint8_t length_extra[29] = {
+	  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+	  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	static constexpr uint16_t dist_base[30] = {
+	  1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+	  33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+	  1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+	static constexpr uint8_t dist_extra[30] = {
+	  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+	  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+	static constexpr uint8_t codelen_order[19] = {
+	  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	// Length (3-258) to length code index (0-28), and distance to distance
+	// code, distances past 256 are looked up by (dist - 1) >> 7.
+	struct code_tables_t
+	{
+		uint8_t length[max_match + 1] = {};
+		uint8_t dist_small[256]       = {};
+		uint8_t dist_large[256]       = {};
+
+		constexpr code_tables_t()
+		{
+			for (size_t code = 0; code < 29; ++code)
+				for (size_t len = length_base[code];
+				     len < length_base[code] + (size_t(1) << length_extra[code]) &&
+				     len <= max_match;
+				     ++len)
+					length[len] = uint8_t(code);
+			// 258 has its own code even though 227 + 31 would cover it.
+			length[max_match] = 28;
+
+			for (size_t code = 0; code < 30; ++code)
+				for (size_t d = dist_base[code];
+				     d < dist_base[code] + (size_t(1) << dist_extra[code]) &&
+				     d <= 0x8000;
+				     ++d)
+				{
+					if (d <= 256)
+						dist_small[d - 1] = uint8_t(code);
+					else
+						dist_large[(d - 1) >> 7] = uint8_t(code);
+				}
+		}
+	};
+
+	static constexpr code_tables_t code_tables;
+
+	static inline size_t dist_code(size_t dist)
+	{
+		return dist <= 256 ? code_tables.dist_small[dist - 1]
+		                   : code_tables.dist_large[(dist - 1) >> 7];
+	}
+
+	static inline uint32_t reverse_bits(uint32_t code, unsigned length)
+	{
+		uint32_t result = 0;
+		for (unsigned i = 0; i < length; ++i, code >>= 1)
+			result = (result << 1) | (code & 1);
+		return result;
+	}
+
+	// Length limited Huffman code lengths for freq. Always gives at least two
+	// symbols a code, some decoders reject a code with only one.
+	static void huffman_lengths(const uint32_t *freq,
+	                            size_t count,
+	                            unsigned limit,
+	                            uint8_t *lengths)
+	{
+		std::fill_n(lengths, count, uint8_t(0));
+
+		struct node_t
+		{
+			uint32_t weight;
+			uint32_t parent;
+		};
+		std::vector<uint16_t> symbols;
+		for (size_t i = 0; i < count; ++i)
+			if (freq[i]) symbols.push_back(uint16_t(i));
+
+		if (symbols.size() < 2)
+		{
+			const size_t used = symbols.empty() ? 0 : symbols[0];
+			lengths[used]     = 1;
+			lengths[used == 0 ? 1 : 0] = 1;
+			return;
+		}
+
+		std::stable_sort(symbols.begin(),
+		                 symbols.end(),
+		                 [&](uint16_t a, uint16_t b)
+		                 { return freq[a] < freq[b]; });
+
+		// Leaves are nodes [0, n), internal nodes are appended in increasing
+		// weight order so two queues are enough to always pick the lightest.
+		const size_t n = symbols.size();
+		std::vector<node_t> nodes;
+		nodes.reserve(2 * n - 1);
+		for (uint16_t symbol : symbols) nodes.push_back({freq[symbol], 0});
+
+		size_t next_leaf = 0, next_internal = n;
+		auto pick = [&]() -> size_t
+		{
+			if (next_leaf < n && (next_internal >= nodes.size() ||
+			                      nodes[next_leaf].weight <=
+			                        nodes[next_internal].weight))
+				return next_leaf++;
+			return next_internal++;
+		};
+		for (size_t i = 0; i < n - 1; ++i)
+		{
+			const size_t a = pick();
+			const size_t b = pick();
+			nodes[a].parent = nodes[b].parent = uint32_t(nodes.size());
+			nodes.push_back({nodes[a].weight + nodes[b].weight, 0});
+		}
+
+		// Depth of every node, parents always come after their children.
+		std::vector<uint8_t> depth(nodes.size(), 0);
+		unsigned counts[64] = {};
+		for (size_t i = nodes.size() - 1; i-- > 0;)
+		{
+			depth[i] = uint8_t(std::min<size_t>(depth[nodes[i].parent] + 1, 63));
+			if (i < n) ++counts[depth[i]];
+		}
+
+		// Pull any codes longer than limit back in, then fix up the Kraft sum
+		// by lengthening codes from just under the limit.
+		for (size_t i = limit + 1; i < 64; ++i)
+		{
+			counts[limit] += counts[i];
+			counts[i] = 0;
+		}
+		uint32_t total = 0;
+		for (unsigned i = limit; i > 0; --i) total += counts[i] << (limit - i);
+		while (total > (uint32_t(1) << limit))
+		{
+			--counts[limit];
+			for (unsigned i = limit - 1; i > 0; --i)
+			{
+				if (counts[i])
+				{
+					--counts[i];
+					counts[i + 1] += 2;
+					break;
+				}
+			}
+			--total;
+		}
+
+		// Most frequent symbols get the shortest codes.
+		size_t index = n;
+		for (unsigned length = 1; length <= limit; ++length)
+			for (unsigned i = 0; i < counts[length]; ++i)
+				lengths[symbols[--index]] = uint8_t(length);
+	}
+
+	// Canonical codes for lengths, bit reversed ready to be written LSB first.
+	static void huffman_codes(const uint8_t *lengths,
+	                          size_t count,
+	                          uint16_t *codes)
+	{
+		uint16_t bl_count[16] = {};
+		for (size_t i = 0; i < count; ++i) ++bl_count[lengths[i]];
+		bl_count[0] = 0;
+
+		uint16_t next_code[16] = {};
+		for (unsigned bits = 1, code = 0; bits < 16; ++bits)
+		{
+			code            = (code + bl_count[bits - 1]) << 1;
+			next_code[bits] = uint16_t(code);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			if (lengths[i])
+				codes[i] =
+				  uint16_t(reverse_bits(next_code[lengths[i]]++, lengths[i]));
+	}
+
+	deflate_encoder_t::deflate_encoder_t(deflate_level_t level,
+	                                     byte_sink_t &sink)
+	: _level(level),
+	  _sink(sink),
+	  _max_chain(level == deflate_level_t::best ? 256 : 8),
+	  _nice_length(level == deflate_level_t::best ? max_match : 32),
+	  _window(2 * window_size)
+	{
+		if (_level != deflate_level_t::stored)
+		{
+			_head.assign(size_t(1) << hash_bits, -1);
+			_prev.assign(window_size, -1);
+			_symbols.reserve(block_symbols);
+		}
+
+		// 32KiB window, FLEVEL set to match the level.
+		_output.push_back(byte_t(0x78));
+		switch (_level)
+		{
+			case deflate_level_t::stored: _output.push_back(byte_t(0x01)); break;
+			case deflate_level_t::fast: _output.push_back(byte_t(0x5E)); break;
+			case deflate_level_t::best: _output.push_back(byte_t(0xDA)); break;
+		}
+	}
+
+	void deflate_encoder_t::write(lak::span<const byte_t> data)
+	{
+		const byte_t *in = data.data();
+		size_t remaining = data.size();
+
+		// Adler-32, 5552 is the most bytes that can be summed before b could
+		// overflow.
+		for (const byte_t *p = in; remaining > 0;)
+		{
+			const size_t n = std::min<size_t>(remaining, 5552);
+			for (size_t i = 0; i < n; ++i)
+			{
+				_adler_a += uint8_t(p[i]);
+				_adler_b += _adler_a;
+			}
+			_adler_a %= 65521;
+			_adler_b %= 65521;
+			p += n;
+			remaining -= n;
+		}
+
+		remaining = data.size();
+		while (remaining > 0)
+		{
+			if (_level == deflate_level_t::stored)
+			{
+				if (_fill == stored_max)
+				{
+					emit_stored({_window.data(), _fill}, false);
+					_fill = 0;
+				}
+				const size_t n = std::min(remaining, stored_max - _fill);
+				std::memcpy(_window.data() + _fill, in, n);
+				_fill += n;
+				in += n;
+				remaining -= n;
+				continue;
+			}
+
+			if (_fill == _window.size()) slide();
+			const size_t n = std::min(remaining, _window.size() - _fill);
+			std::memcpy(_window.data() + _fill, in, n);
+			_fill += n;
+			in += n;
+			remaining -= n;
+			process(false);
+		}
+
+		flush_output(false);
+	}
+
+	void deflate_encoder_t::finish()
+	{
+		if (_finished) return;
+		_finished = true;
+
+		if (_level == deflate_level_t::stored)
+		{
+			emit_stored({_window.data(), _fill}, true);
+			_fill = 0;
+		}
+		else
+		{
+			process(true);
+			emit_block(true);
+		}
+
+		align();
+		_output.push_back(byte_t(_adler_b >> 8));
+		_output.push_back(byte_t(_adler_b));
+		_output.push_back(byte_t(_adler_a >> 8));
+		_output.push_back(byte_t(_adler_a));
+		flush_output(true);
+	}
+
+	void deflate_encoder_t::slide()
+	{
+		std::memcpy(_window.data(), _window.data() + window_size, window_size);
+		_fill -= window_size;
+		_pos -= window_size;
+
+		auto rebase = [](int32_t pos) -> int32_t
+		{ return pos >= int32_t(window_size) ? pos - int32_t(window_size) : -1; };
+		for (auto &pos : _head) pos = rebase(pos);
+		for (auto &pos : _prev) pos = rebase(pos);
+	}
+
+	static inline size_t hash_at(const byte_t *p, size_t bits)
+	{
+		const uint32_t v = uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+		                   (uint32_t(p[2]) << 16);
+		return (v * 2654435761U) >> (32 - bits);
+	}
+
+	void deflate_encoder_t::insert(size_t pos)
+	{
+		if (pos + min_match > _fill) return;
+		auto &head = _head[hash_at(&_window[pos], hash_bits)];
+		_prev[pos & (window_size - 1)] = head;
+		head                           = int32_t(pos);
+	}
+
+	size_t deflate_encoder_t::find_match(size_t pos, size_t &dist) const
+	{
+		const size_t max_length = std::min(max_match, _fill - pos);
+		if (max_length < min_match) return 0;
+
+		const byte_t *current = &_window[pos];
+		size_t best_length    = min_match - 1;
+		int32_t candidate     = _head[hash_at(current, hash_bits)];
+		for (size_t chain = _max_chain;
+		     candidate >= 0 && pos - size_t(candidate) <= window_size && chain > 0;
+		     --chain)
+		{
+			const byte_t *other = &_window[size_t(candidate)];
+			if (other[best_length] == current[best_length] &&
+			    other[0] == current[0] && other[1] == current[1])
+			{
+				size_t length = 2;
+				while (length < max_length && other[length] == current[length])
+					++length;
+				if (length > best_length)
+				{
+					best_length = length;
+					dist        = pos - size_t(candidate);
+					if (length >= _nice_length || length == max_length) break;
+				}
+			}
+
+			const int32_t next = _prev[size_t(candidate) & (window_size - 1)];
+			if (next >= candidate) break;
+			candidate = next;
+		}
+
+		// Short matches a long way back usually cost more than the literals.
+		if (best_length == min_match && dist > 4096) return 0;
+		return best_length >= min_match ? best_length : 0;
+	}
+
+	void deflate_encoder_t::literal(size_t pos)
+	{
+		_symbols.push_back({uint8_t(_window[pos]), 0});
+		if (_symbols.size() == block_symbols) emit_block(false);
+	}
+
+	void deflate_encoder_t::match(size_t length, size_t dist)
+	{
+		_symbols.push_back({uint16_t(length), uint16_t(dist)});
+		if (_symbols.size() == block_symbols) emit_block(false);
+	}
+
+	void deflate_encoder_t::process(bool flush)
+	{
+		if (!flush && _fill < min_lookahead) return;
+		const size_t limit = flush ? _fill : _fill - min_lookahead;
+
+		if (_level == deflate_level_t::fast)
+		{
+			while (_pos < limit)
+			{
+				size_t dist         = 0;
+				const size_t length = find_match(_pos, dist);
+				insert(_pos);
+				if (length)
+				{
+					match(length, dist);
+					// Indexing every byte of a long match costs more than the
+					// matches it would find.
+					if (length <= 32)
+						for (size_t i = 1; i < length; ++i) insert(_pos + i);
+					_pos += length;
+				}
+				else
+				{
+					literal(_pos);
+					++_pos;
+				}
+			}
+			return;
+		}
+
+		while (_pos < limit)
+		{
+			size_t dist   = 0;
+			size_t length = 0;
+			if (_prev_length < _nice_length) length = find_match(_pos, dist);
+			insert(_pos);
+
+			if (_match_available && _prev_length >= min_match &&
+			    length <= _prev_length)
+			{
+				// The match starting at _pos - 1 is at least as good.
+				match(_prev_length, _prev_dist);
+				const size_t end = _pos - 1 + _prev_length;
+				for (size_t i = _pos + 1; i < end; ++i) insert(i);
+				_pos             = end;
+				_match_available = false;
+				_prev_length     = 0;
+				continue;
+			}
+
+			if (_match_available) literal(_pos - 1);
+			_match_available = true;
+			_prev_length     = length;
+			_prev_dist       = dist;
+			++_pos;
+		}
+
+		if (flush && _match_available)
+		{
+			literal(_pos - 1);
+			_match_available = false;
+			_prev_length     = 0;
+		}
+	}
+
+	void deflate_encoder_t::emit_block(bool final_block)
+	{
+		uint32_t litlen_freq[286] = {};
+		uint32_t dist_freq[30]    = {};
+		for (const auto &symbol : _symbols)
+		{
+			if (symbol.dist == 0)
+			{
+				++litlen_freq[symbol.litlen];
+			}
+			else
+			{
+				++litlen_freq[257 + code_tables.length[symbol.litlen]];
+				++dist_freq[dist_code(symbol.dist)];
+			}
+		}
+		litlen_freq[256] = 1;
+
+		// 288 so the fixed codes can be built over the whole fixed alphabet.
+		uint8_t litlen_lengths[288] = {};
+		uint8_t dist_lengths[30];
+		huffman_lengths(litlen_freq, 286, 15, litlen_lengths);
+		huffman_lengths(dist_freq, 30, 15, dist_lengths);
+
+		size_t hlit = 286;
+		while (hlit > 257 && litlen_lengths[hlit - 1] == 0) --hlit;
+		size_t hdist = 30;
+		while (hdist > 1 && dist_lengths[hdist - 1] == 0) --hdist;
+
+		// Run length encode the code lengths, 16 repeats the previous length
+		// 3-6 times, 17 and 18 are runs of 3-10 and 11-138 zeros.
+		uint8_t all_lengths[286 + 30];
+		std::memcpy(all_lengths, litlen_lengths, hlit);
+		std::memcpy(all_lengths + hlit, dist_lengths, hdist);
+		const size_t total = hlit + hdist;
+
+		struct codelen_t
+		{
+			uint8_t symbol;
+			uint8_t extra;
+		};
+		std::vector<codelen_t> codelens;
+		uint32_t codelen_freq[19] = {};
+		for (size_t i = 0; i < total;)
+		{
+			const uint8_t length = all_lengths[i];
+			size_t run           = 1;
+			while (i + run < total && all_lengths[i + run] == length) ++run;
+			i += run;
+
+			if (length == 0)
+			{
+				while (run >= 11)
+				{
+					const size_t n = std::min<size_t>(run, 138);
+					codelens.push_back({18, uint8_t(n - 11)});
+					run -= n;
+				}
+				if (run >= 3)
+				{
+					codelens.push_back({17, uint8_t(run - 3)});
+					run = 0;
+				}
+			}
+			else
+			{
+				codelens.push_back({length, 0});
+				--run;
+				while (run >= 3)
+				{
+					const size_t n = std::min<size_t>(run, 6);
+					codelens.push_back({16, uint8_t(n - 3)});
+					run -= n;
+				}
+			}
+			for (; run > 0; --run) codelens.push_back({length, 0});
+		}
+		for (const auto &codelen : codelens) ++codelen_freq[codelen.symbol];
+
+		uint8_t codelen_lengths[19];
+		huffman_lengths(codelen_freq, 19, 7, codelen_lengths);
+		size_t hclen = 19;
+		while (hclen > 4 && codelen_lengths[codelen_order[hclen - 1]] == 0)
+			--hclen;
+
+		// Compare against the fixed codes, small blocks are often smaller
+		// without the code length header.
+		size_t dynamic_bits = 14 + 3 * hclen;
+		for (const auto &codelen : codelens)
+			dynamic_bits += codelen_lengths[codelen.symbol] +
+			                (codelen.symbol == 16   ? 2
+			                 : codelen.symbol == 17 ? 3
+			                 : codelen.symbol == 18 ? 7
+			                                        : 0);
+		size_t fixed_bits = 0;
+		for (size_t i = 0; i < 286; ++i)
+		{
+			const size_t extra  = i > 256 ? length_extra[i - 257] : 0;
+			const size_t length = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+			dynamic_bits += litlen_freq[i] * (litlen_lengths[i] + extra);
+			fixed_bits += litlen_freq[i] * (length + extra);
+		}
+		for (size_t i = 0; i < 30; ++i)
+		{
+			dynamic_bits += dist_freq[i] * (dist_lengths[i] + dist_extra[i]);
+			fixed_bits += dist_freq[i] * (5 + dist_extra[i]);
+		}
+
+		const bool fixed = fixed_bits <= dynamic_bits;
+		if (fixed)
+		{
+			for (size_t i = 0; i < 288; ++i)
+				litlen_lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+			std::fill_n(dist_lengths, 30, uint8_t(5));
+		}
+
+		uint16_t litlen_codes[288] = {};
+		uint16_t dist_codes[30]    = {};
+		huffman_codes(litlen_lengths, fixed ? 288 : 286, litlen_codes);
+		huffman_codes(dist_lengths, 30, dist_codes);
+
+		put_bits(final_block ? 1 : 0, 1);
+		put_bits(fixed ? 1 : 2, 2);
+
+		if (!fixed)
+		{
+			uint16_t codelen_codes[19] = {};
+			huffman_codes(codelen_lengths, 19, codelen_codes);
+
+			put_bits(uint32_t(hlit - 257), 5);
+			put_bits(uint32_t(hdist - 1), 5);
+			put_bits(uint32_t(hclen - 4), 4);
+			for (size_t i = 0; i < hclen; ++i)
+				put_bits(codelen_lengths[codelen_order[i]], 3);
+			for (const auto &codelen : codelens)
+			{
+				put_bits(codelen_codes[codelen.symbol],
+				         codelen_lengths[codelen.symbol]);
+				switch (codelen.symbol)
+				{
+					case 16: put_bits(codelen.extra, 2); break;
+					case 17: put_bits(codelen.extra, 3); break;
+					case 18: put_bits(codelen.extra, 7); break;
+					default: break;
+				}
+			}
+		}
+
+		for (const auto &symbol : _symbols)
+		{
+			if (symbol.dist == 0)
+			{
+				put_bits(litlen_codes[symbol.litlen],
+				         litlen_lengths[symbol.litlen]);
+				continue;
+			}
+
+			const size_t lcode = code_tables.length[symbol.litlen];
+			put_bits(litlen_codes[257 + lcode], litlen_lengths[257 + lcode]);
+			put_bits(symbol.litlen - length_base[lcode], length_extra[lcode]);
+
+			const size_t dcode = dist_code(symbol.dist);
+			put_bits(dist_codes[dcode], dist_lengths[dcode]);
+			put_bits(symbol.dist - dist_base[dcode], dist_extra[dcode]);
+		}
+		put_bits(litlen_codes[256], litlen_lengths[256]);
+
+		_symbols.clear();
+		flush_output(false);
+	}
+
+	void deflate_encoder_t::emit_stored(lak::span<const byte_t> data,
+	                                    bool final_block)
+	{
+		put_bits(final_block ? 1 : 0, 1);
+		put_bits(0, 2);
+		align();
+		const uint16_t length = uint16_t(data.size());
+		_output.push_back(byte_t(length));
+		_output.push_back(byte_t(length >> 8));
+		_output.push_back(byte_t(~length));
+		_output.push_back(byte_t(~length >> 8));
+		_output.insert(_output.end(), data.begin(), data.end());
+		flush_output(false);
+	}
+
+	void deflate_encoder_t::put_bits(uint32_t value, unsigned count)
+	{
+		_bits |= uint64_t(value) << _bit_count;
+		_bit_count += count;
+		while (_bit_count >= 8)
+		{
+			_output.push_back(byte_t(_bits));
+			_bits >>= 8;
+			_bit_count -= 8;
+		}
+	}
+
+	void deflate_encoder_t::align()
+	{
+		if (_bit_count > 0) put_bits(0, 8 - _bit_count);
+	}
+
+	void deflate_encoder_t::flush_output(bool force)
+	{
+		if (_output.empty() || (!force && _output.size() < 0x10000)) return;
+		_sink.write({_output.data(), _output.size()});
+		_output.clear();
+	}
+}
@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_DEFLATE_H
+#define SOURCE_EXPLORER_DEFLATE_H
+
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <ostream>
+#include <vector>
+
+namespace SourceExplorer
+{
+	// Receives encoded output a piece at a time, as it is produced.
+	struct byte_sink_t
+	{
+		virtual ~byte_sink_t() = default;
+
+		virtual void write(lak::span<const byte_t> bytes) = 0;
+	};
+
+	struct vector_sink_t : byte_sink_t
+	{
+		std::vector<byte_t> data;
+
+		void write(lak::span<const byte_t> bytes) override
+		{
+			data.insert(data.end(), bytes.begin(), bytes.end());
+		}
+	};
+
+	struct ostream_sink_t : byte_sink_t
+	{
+		std::ostream &out;
+		size_t written = 0;
+
+		ostream_sink_t(std::ostream &o) : out(o) {}
+
+		void write(lak::span<const byte_t> bytes) override
+		{
+			out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+			written += bytes.size();
+		}
+	};
+
+	enum struct deflate_level_t : uint8_t
+	{
+		// Stored blocks, no compression at all.
+		stored,
+		// Greedy matching against a short hash chain.
+		fast,
+		// Lazy matching against a long hash chain.
+		best,
+	};
+
+	// Streaming zlib (RFC 1950) encoder. Input can be written in pieces of any
+	// size, the compressed stream is passed on to sink a block at a time. Only
+	// the 32KiB window and one block of pending symbols are held in memory.
+	struct deflate_encoder_t
+	{
+		deflate_encoder_t(deflate_level_t level, byte_sink_t &sink);
+
+		deflate_encoder_t(const deflate_encoder_t &) = delete;
+		deflate_encoder_t &operator=(const deflate_encoder_t &) = delete;
+
+		void write(lak::span<const byte_t> data);
+
+		// End the stream, nothing more can be written after this.
+		void finish();
+
+	private:
+		static constexpr size_t window_size   = 0x8000;
+		static constexpr size_t hash_bits     = 15;
+		static constexpr size_t block_symbols = 0x4000;
+
+		struct symbol_t
+		{
+			uint16_t litlen;
+			uint16_t dist; // 0 for literals.
+		};
+
+		void process(bool flush);
+		void slide();
+		void insert(size_t pos);
+		size_t find_match(size_t pos, size_t &dist) const;
+		void literal(size_t pos);
+		void match(size_t length, size_t dist);
+		void emit_block(bool final_block);
+		void emit_stored(lak::span<const byte_t> data, bool final_block);
+		void put_bits(uint32_t value, unsigned count);
+		void align();
+		void flush_output(bool force);
+
+		deflate_level_t _level;
+		byte_sink_t &_sink;
+		size_t _max_chain;
+		size_t _nice_length;
+
+		// Two windows worth of input, the lower half is history once the read
+		// head passes into the upper half.
+		std::vector<byte_t> _window;
+		size_t _fill = 0;
+		size_t _pos  = 0;
+		// Most recent position for each hash and the previous position with
+		// the same hash for each window position, -1 for none.
+		std::vector<int32_t> _head;
+		std::vector<int32_t> _prev;
+
+		// Lazy matching carries the match found at _pos - 1 over to _pos.
+		bool _match_available = false;
+		size_t _prev_length   = 0;
+		size_t _prev_dist     = 0;
+
+		std::vector<symbol_t> _symbols;
+
+		std::vector<byte_t> _output;
+		uint64_t _bits      = 0;
+		unsigned _bit_count = 0;
+
+		uint32_t _adler_a = 1;
+		uint32_t _adler_b = 0;
+
+		bool _finished = false;
+	};
+}
+
+#endif
@@ -22,13 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#ifdef _WIN32
-#	define STBI_MSC_SECURE_CRT
-#endif
-#include <stb_image_write.h>
-
 #include "dump.h"
+#include "batch_events.hpp"
 #include "explorer.h"
+#include "perf_counters.hpp"
 #include "tostring.hpp"
 
 #include <lak/char_utils.hpp>
@@ -36,6 +33,8 @@ SOFTWARE.
 #include <lak/string_utils.hpp>
 #include <lak/visit.hpp>
 
+#include <map>
+#include <thread>
 #include <unordered_set>
 
 #ifdef GetObject
@@ -44,15 +43,55 @@ SOFTWARE.
 
 namespace se = SourceExplorer;
 
-se::error_t se::SaveImage(const lak::image4_t &image, const fs::path &filename)
+static uint64_t PaletteHash(const lak::array<lak::color4_t, 256> &colors)
+{
+	// FNV-1a
+	uint64_t hash = 0xCBF29CE484222325U;
+	for (const auto &color : colors)
+		for (uint8_t c : {color.r, color.g, color.b, color.a})
+			hash = (hash ^ c) * 0x100000001B3U;
+	// 0 is reserved for "no palette".
+	return hash ? hash : 1;
+}
+
+static lak::span<const byte_t> ImagePixels(const lak::image4_t &image)
+{
+	return lak::span<const byte_t>(
+	  reinterpret_cast<const byte_t *>(&(image[0].r)),
+	  image.size().x * image.size().y * 4);
+}
+
+se::result_t<std::vector<byte_t>> se::EncodeImage(
+  const lak::image4_t &image, const image_encoding_t &encoding)
 {
-	if (stbi_write_png(
-	      reinterpret_cast<const char *>(filename.u8string().c_str()),
-	      (int)image.size().x,
-	      (int)image.size().y,
-	      4,
-	      &(image[0].r),
-	      (int)(image.size().x * 4)) != 1)
+	perf_timer_t perf(perf_stage_t::image_encode);
+	vector_sink_t sink;
+	if (image.size().x == 0 || image.size().y == 0 ||
+	    !EncodeImage(
+	      ImagePixels(image), image.size().x, image.size().y, encoding, sink))
+	{
+		return lak::err_t{
+		  se::error(LINE_TRACE, se::error::str_err, "Failed to encode image")};
+	}
+	perf.add(sink.data.size());
+	return lak::ok_t{lak::move(sink.data)};
+}
+
+se::result_t<size_t> se::WriteImage(const lak::image4_t &image,
+                                    const fs::path &filename,
+                                    const image_encoding_t &encoding)
+{
+	if (image.size().x == 0 || image.size().y == 0)
+		return lak::err_t{
+		  se::error(LINE_TRACE, se::error::str_err, "Image is empty")};
+
+	perf_timer_t perf(perf_stage_t::image_encode);
+	std::ofstream file(filename, std::ios::binary | std::ios::out);
+	ostream_sink_t sink(file);
+	if (!file.is_open() ||
+	    !EncodeImage(
+	      ImagePixels(image), image.size().x, image.size().y, encoding, sink) ||
+	    !file.flush())
 	{
 		return lak::err_t{se::error(LINE_TRACE,
 		                            se::error::str_err,
@@ -60,7 +99,16 @@ se::error_t se::SaveImage(const lak::image4_t &image, const fs::path &filename)
 		                            filename,
 		                            "'")};
 	}
-	return lak::ok_t{};
+	perf.add(sink.written);
+	return lak::ok_t{sink.written};
+}
+
+se::error_t se::SaveImage(const lak::image4_t &image,
+                          const fs::path &filename,
+                          const image_encoding_t &encoding)
+{
+	return WriteImage(image, filename, encoding)
+	  .map([](size_t) { return lak::monostate{}; });
 }
 
 se::error_t se::SaveImage(source_explorer_t &srcexp,
@@ -78,206 +126,425 @@ se::error_t se::SaveImage(source_explorer_t &srcexp,
 		      (frame && frame->palette) ? frame->palette->colors.data() : nullptr);
 	    })
 	  .MAP_SE_ERR("failed to read image data")
-	  .and_then([&](const auto &image) { return SaveImage(image, filename); });
+	  .and_then(
+	    [&](const auto &image)
+	    { return SaveImage(image, filename, srcexp.image_encoding); });
 }
 
-lak::await_result<se::error_t> se::OpenGame(source_explorer_t &srcexp)
+std::optional<se::error_t> se::OpenGame(source_explorer_t &srcexp)
 {
-	static lak::await<se::error_t> awaiter;
-
-	if (auto result = awaiter(LoadGame, std::ref(srcexp)); result.is_ok())
+	if (!srcexp.exe.job)
 	{
-		return lak::ok_t{result.unwrap().MAP_SE_ERR("OpenGame")};
+		// A pending image decode reads from the game LoadGame is about to
+		// drop, let it finish here on the UI thread that owns it.
+		if (srcexp.pending_image.valid()) srcexp.pending_image.get();
+		srcexp.pending_image = {};
+
+		srcexp.exe.job       = std::make_shared<job_t>();
+		srcexp.exe.job->name = "Open Game";
+		srcexp.exe.job->result =
+		  async([&srcexp]() -> error_t { return LoadGame(srcexp); });
 	}
-	else
+
+	if (srcexp.exe.job->running())
 	{
-		switch (result.unwrap_err())
+		const auto str_id = "Open Game";
+		if (ImGui::BeginPopup(str_id, ImGuiWindowFlags_AlwaysAutoResize))
 		{
-			case lak::await_error::running:
+			ImGui::Text("Loading, please wait...");
+			ImGui::Checkbox("Print to debug console?",
+			                &lak::debugger.live_output_enabled);
+			if (lak::debugger.live_output_enabled)
 			{
-				const auto str_id = "Open Game";
-				if (ImGui::BeginPopup(str_id, ImGuiWindowFlags_AlwaysAutoResize))
-				{
-					ImGui::Text("Loading, please wait...");
-					ImGui::Checkbox("Print to debug console?",
-					                &lak::debugger.live_output_enabled);
-					if (lak::debugger.live_output_enabled)
-					{
-						ImGui::Checkbox("Only errors?", &lak::debugger.live_errors_only);
-						ImGui::Checkbox("Developer mode?",
-						                &lak::debugger.line_info_enabled);
-					}
-					ImGui::ProgressBar(srcexp.state.completed);
-					ImGui::ProgressBar(srcexp.state.bank_completed);
-					ImGui::EndPopup();
-				}
-				else
-				{
-					ImGui::OpenPopup(str_id);
-				}
-
-				return lak::err_t{lak::await_error::running};
+				ImGui::Checkbox("Only errors?", &lak::debugger.live_errors_only);
+				ImGui::Checkbox("Developer mode?", &lak::debugger.line_info_enabled);
 			}
-			break;
-
-			case lak::await_error::failed:
-				return lak::err_t{lak::await_error::failed};
-				break;
-
-			default:
-				ASSERT_NYI();
-				// return lak::err_t{lak::await_error::failed};
-				// break;
+			ImGui::ProgressBar(srcexp.state.completed);
+			ImGui::ProgressBar(srcexp.state.bank_completed);
+			ImGui::EndPopup();
+		}
+		else
+		{
+			ImGui::OpenPopup(str_id);
 		}
+
+		return std::nullopt;
 	}
+
+	const auto job = std::exchange(srcexp.exe.job, nullptr);
+	if (const auto &result = job->result.get(); result)
+		return result->MAP_SE_ERR("OpenGame");
+	else
+		return lak::err_t{error(LINE_TRACE, error::str_err, "LoadGame threw")};
+}
+
+bool se::source_explorer_t::jobs_running() const
+{
+	return std::any_of(jobs.begin(),
+	                   jobs.end(),
+	                   [](const auto &job) { return job->running(); });
 }
 
 bool se::DumpStuff(source_explorer_t &srcexp,
+                   file_state_t &file_state,
                    const char *str_id,
                    dump_function_t *func)
 {
-	static lak::await<se::error_t> awaiter;
-	static std::atomic<float> completed = 0.0f;
+	// Only one job at a time can use a file state, the next one would change
+	// its path from under the running job.
+	if (file_state.busy()) return false;
+
+	auto job  = std::make_shared<job_t>();
+	job->name = str_id;
 
-	auto functor = [&, func]() -> se::error_t
+	auto functor = [&srcexp, func, job]() -> se::error_t
 	{
-		func(srcexp, completed);
+		// Dumps walk the banks in order, let the OS read ahead for us.
+		if (srcexp.state.file)
+			srcexp.state.file->advise(access_hint_t::sequential);
+		func(srcexp, *job);
+		job->completed = 1.0f;
+		job->finish();
+		if (srcexp.state.file) srcexp.state.file->advise(access_hint_t::random);
 		return lak::ok_t{};
 	};
 
-	if (auto result = awaiter(functor); result.is_ok())
+	job->result    = async(functor);
+	file_state.job = job;
+	srcexp.jobs.push_back(lak::move(job));
+	return true;
+}
+
+namespace
+{
+	const se::batch_dump_t batch_dumps[] = {
+	  {"images", &se::source_explorer_t::images, &se::DumpImages},
+	  {"sorted", &se::source_explorer_t::sorted_images, &se::DumpSortedImages},
+	  {"icon", &se::source_explorer_t::appicon, &se::DumpAppIcon},
+	  {"sounds", &se::source_explorer_t::sounds, &se::DumpSounds},
+	  {"music", &se::source_explorer_t::music, &se::DumpMusic},
+	  {"shaders", &se::source_explorer_t::shaders, &se::DumpShaders},
+	  {"binary", &se::source_explorer_t::binary_files, &se::DumpBinaryFiles},
+	  {"pack", &se::source_explorer_t::pack_files, &se::DumpPackFiles},
+	};
+
+	template<typename DONE, typename REPORT>
+	void BatchWait(DONE done, REPORT report)
 	{
-		return true;
+		while (!done())
+		{
+			report();
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
 	}
-	else
+}
+
+const char *se::batch_dump_names =
+  "images,sorted,icon,sounds,music,shaders,binary,pack";
+
+const se::batch_dump_t *se::FindBatchDump(std::string_view name)
+{
+	for (const auto &dump : batch_dumps)
+		if (name == dump.name) return &dump;
+	return nullptr;
+}
+
+bool se::FindBatchDumps(const std::vector<std::string> &names,
+                        std::vector<const batch_dump_t *> &dumps)
+{
+	for (const auto &name : names)
 	{
-		switch (result.unwrap_err())
+		if (const auto *dump = FindBatchDump(name); dump)
 		{
-			case lak::await_error::running:
-			{
-				if (ImGui::BeginPopup(str_id, ImGuiWindowFlags_AlwaysAutoResize))
-				{
-					ImGui::Text("Dumping, please wait...");
-					ImGui::Checkbox("Print to debug console?",
-					                &lak::debugger.live_output_enabled);
-					if (lak::debugger.live_output_enabled)
-					{
-						ImGui::Checkbox("Only errors?", &lak::debugger.live_errors_only);
-						ImGui::Checkbox("Developer mode?",
-						                &lak::debugger.line_info_enabled);
-					}
-					ImGui::ProgressBar(completed);
-					ImGui::EndPopup();
-				}
-				else
-				{
-					ImGui::OpenPopup(str_id);
-				}
-				return false;
-			}
-			break;
+			dumps.push_back(dump);
+		}
+		else
+		{
+			BatchEvent("error",
+			           JsonField("stage", "arguments"),
+			           JsonField("message", "unknown dump '" + name + "'"));
+			return false;
+		}
+	}
+	return true;
+}
 
-			case lak::await_error::failed:
-			default:
-			{
-				ASSERT_NYI();
-				return false;
-			}
-			break;
+se::batch_status_t se::BatchDump(source_explorer_t &srcexp,
+                                 const std::vector<std::string> &dumps,
+                                 const fs::path &out)
+{
+	std::vector<const batch_dump_t *> selected;
+	if (!FindBatchDumps(dumps, selected)) return batch_status_t::usage;
+
+	auto Finish = [&](batch_status_t status)
+	{
+		if (status != batch_status_t::ok)
+		{
+			const fs::path log_path = out / "error_log.txt";
+			std::error_code err;
+			fs::create_directories(out, err);
+			if (!err && lak::save_file(log_path, lak::debugger.str()))
+				BatchEvent("log", JsonField("path", log_path.u8string()));
+		}
+		BatchEvent("finished", JsonField("status", int(status)));
+		return status;
+	};
+
+	BatchEvent("load", JsonField("path", srcexp.exe.path.u8string()));
+
+	const auto load_start = std::chrono::steady_clock::now();
+	auto loaded = async([&srcexp]() -> error_t { return LoadGame(srcexp); });
+	BatchWait([&] { return loaded.ready(); },
+	          [&]
+	          {
+		          BatchEvent("progress",
+		                     JsonField("stage", "load"),
+		                     JsonField("progress", srcexp.state.completed.load()));
+	          });
+
+	if (const auto &result = loaded.get(); !result || result->is_err())
+	{
+		BatchEvent(
+		  "error",
+		  JsonField("stage", "load"),
+		  JsonField("message",
+		            result ? lak::streamify(result->unsafe_unwrap_err())
+		                   : lak::streamify("LoadGame threw")));
+		return Finish(batch_status_t::load_failed);
+	}
+	srcexp.loaded = true;
+
+	BatchEvent("loaded",
+	           JsonField("seconds",
+	                     std::chrono::duration<double>(
+	                       std::chrono::steady_clock::now() - load_start)
+	                       .count()));
+
+	batch_status_t status = batch_status_t::ok;
+	for (const auto *dump : selected)
+	{
+		file_state_t &file_state = srcexp.*(dump->state);
+		file_state.path          = out / dump->name;
+
+		std::error_code err;
+		fs::create_directories(file_state.path, err);
+		if (err || !DumpStuff(srcexp, file_state, dump->name, dump->func))
+		{
+			BatchEvent("error",
+			           JsonField("stage", dump->name),
+			           JsonField("message",
+			                     err ? err.message() : "already running"));
+			status = batch_status_t::dump_failed;
+			continue;
+		}
+
+		const auto job = file_state.job;
+		auto Report    = [&](const char *event)
+		{
+			BatchEvent(event,
+			           JsonField("stage", dump->name),
+			           JsonField("progress", job->completed.load()),
+			           JsonField("items", job->items.load()),
+			           JsonField("bytes", job->bytes.load()),
+			           JsonField("failed", job->failed.load()),
+			           JsonField("seconds", job->elapsed()));
+		};
+		BatchWait([&] { return !job->running(); },
+		          [&] { Report("progress"); });
+		Report("done");
+
+		if (job->failed > 0) status = batch_status_t::dump_failed;
+	}
+
+	return Finish(status);
+}
+
+se::batch_status_t se::BenchGame(source_explorer_t &srcexp)
+{
+	using bench_clock_t = std::chrono::steady_clock;
+	auto SecondsSince   = [](bench_clock_t::time_point start)
+	{
+		return std::chrono::duration<double>(bench_clock_t::now() - start)
+		  .count();
+	};
+
+	perf_counters.reset();
+
+	auto Finish = [&](batch_status_t status)
+	{
+		for (size_t i = 0; i < size_t(perf_stage_t::count); ++i)
+		{
+			const auto stage = perf_stage_t(i);
+			const auto stats = perf_counters.get(stage);
+			BatchEvent("stage",
+			           JsonField("stage", perf_stage_name(stage)),
+			           JsonField("bytes", stats.bytes),
+			           JsonField("items", stats.items),
+			           JsonField("seconds", stats.seconds),
+			           JsonField("mib_per_s", stats.mib_per_second()));
 		}
+		BatchEvent("finished", JsonField("status", int(status)));
+		return status;
+	};
+
+	BatchEvent("load", JsonField("path", srcexp.exe.path.u8string()));
+
+	const auto load_start = bench_clock_t::now();
+	if (auto err = LoadGame(srcexp); err.is_err())
+	{
+		BatchEvent("error",
+		           JsonField("stage", "load"),
+		           JsonField("message", lak::streamify(err.unsafe_unwrap_err())));
+		return Finish(batch_status_t::load_failed);
 	}
+	srcexp.loaded = true;
+	BatchEvent("loaded", JsonField("seconds", SecondsSince(load_start)));
+
+	auto &game                      = srcexp.state.game;
+	const bool color_transparent    = srcexp.dump_color_transparent;
+	const image_encoding_t encoding = srcexp.image_encoding;
+
+	batch_status_t status = batch_status_t::ok;
+	auto Phase            = [&](const char *name, size_t count, auto &&func)
+	{
+		std::atomic<size_t> failed = 0;
+		const auto start           = bench_clock_t::now();
+		parallel_for(count,
+		             [&](size_t index)
+		             {
+			             if (!func(index)) ++failed;
+		             });
+		BatchEvent("done",
+		           JsonField("stage", name),
+		           JsonField("items", count),
+		           JsonField("failed", failed.load()),
+		           JsonField("seconds", SecondsSince(start)));
+		if (failed > 0) status = batch_status_t::dump_failed;
+	};
+
+	// Images are encoded in memory, only the decoders and encoders are
+	// timed, not the disk.
+	if (game.image_bank)
+		Phase("images",
+		      game.image_bank->items.size(),
+		      [&](size_t index)
+		      {
+			      return game.image_bank->items[index]
+			        .image(color_transparent)
+			        .and_then([&](const auto &image)
+			                  { return EncodeImage(image, encoding); })
+			        .is_ok();
+		      });
+
+	auto DecodeBank = [&](const char *name, const auto &bank)
+	{
+		if (!bank) return;
+		Phase(name,
+		      bank->items.size(),
+		      [&](size_t index)
+		      { return bank->items[index].entry.decode_body().is_ok(); });
+	};
+	DecodeBank("sounds", game.sound_bank);
+	DecodeBank("music", game.music_bank);
+	DecodeBank("fonts", game.font_bank);
+
+	return Finish(status);
 }
 
-void se::DumpImages(source_explorer_t &srcexp, std::atomic<float> &completed)
+void se::DumpImages(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.image_bank)
 	{
 		ERROR("No Image Bank");
+		++job.failed;
 		return;
 	}
 
-	const size_t count = srcexp.state.game.image_bank->items.size();
-	size_t index       = 0;
-	for (const auto &item : srcexp.state.game.image_bank->items)
-	{
-		lak::image4_t image = item.image(srcexp.dump_color_transparent).UNWRAP();
-		fs::path filename =
-		  srcexp.images.path / (std::to_string(item.entry.handle) + ".png");
-		(void)SaveImage(image, filename);
-		completed = (float)((double)(index++) / (double)count);
-	}
+	const auto &items               = srcexp.state.game.image_bank->items;
+	const bool color_transparent    = srcexp.dump_color_transparent;
+	const image_encoding_t encoding = srcexp.image_encoding;
+	const char *extension           = image_extension(encoding.format);
+	const fs::path &path            = srcexp.images.path;
+
+	// Decode, encode and write images on the pool, each file is streamed out
+	// as it is encoded. This thread just keeps count, a couple of images per
+	// worker in flight.
+	ordered_pipeline(
+	  items.size(),
+	  2 * (thread_pool_t::global().size() + 1),
+	  [&](size_t index) -> result_t<size_t>
+	  {
+		  const auto &item = items[index];
+		  fs::path filename =
+		    path / (std::to_string(item.entry.handle) + extension);
+		  return item.image(color_transparent)
+		    .and_then([&](const auto &image)
+		              { return WriteImage(image, filename, encoding); })
+		    .MAP_SE_ERR("failed to save image ", item.entry.handle);
+	  },
+	  [&](size_t index, result_t<size_t> written)
+	  {
+		  job.completed = (float)((double)(index + 1) / (double)items.size());
+
+		  if (written.is_err())
+		  {
+			  ERROR(written.unsafe_unwrap_err());
+			  ++job.failed;
+			  return;
+		  }
+
+		  ++job.items;
+		  job.bytes += written.unsafe_unwrap();
+	  });
 }
 
-void se::DumpSortedImages(se::source_explorer_t &srcexp,
-                          std::atomic<float> &completed)
+void se::DumpSortedImages(se::source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.image_bank)
 	{
 		ERROR("No Image Bank");
+		++job.failed;
 		return;
 	}
 
 	if (!srcexp.state.game.frame_bank)
 	{
 		ERROR("No Frame Bank");
+		++job.failed;
 		return;
 	}
 
 	if (!srcexp.state.game.object_bank)
 	{
 		ERROR("No Object Bank");
+		++job.failed;
 		return;
 	}
 
-	auto LinkImages = [](const fs::path &From, const fs::path &To)
-	  -> lak::error_codes<lak::error_code_error, lak::u8string>
-	{
-		auto errno_map = [](lak::error_code_error err)
-		  -> lak::variant<lak::error_code_error, lak::u8string>
-		{ return lak::var_t<0>(err); };
-
-		return lak::path_exists(From)
-		  .IF_ERR("from path ", From, " existence check failed")
-		  .map_err(errno_map)
-		  .map_expect_value(
-		    true,
-		    [&](auto &&) -> lak::variant<lak::error_code_error, lak::u8string>
-		    { return lak::var_t<1>(lak::streamify(From, " does not exist")); })
-		  .and_then(
-		    [&](auto &&)
-		    {
-			    return lak::path_exists(To)
-			      .IF_ERR("to path ", To, " existence check failed")
-			      .map_err(errno_map);
-		    })
-		  .map_expect_value(
-		    false,
-		    [&](auto &&) -> lak::variant<lak::error_code_error, lak::u8string>
-		    { return lak::var_t<1>(lak::streamify(From, " already exist")); })
-		  .and_then(
+	// A hard link is much cheaper than a second copy of the image, fall back
+	// to copying if the file system doesn't support them.
+	auto LinkImage = [](const fs::path &From, const fs::path &To) -> bool
+	{
+		// Replace whatever a previous dump left at To, linking and copying
+		// both refuse to overwrite it.
+		std::error_code err;
+		fs::remove(To, err);
+		if (err)
+		{
+			ERROR("remove ", To, " failed: (", err.value(), ")", err.message());
+			return false;
+		}
+
+		return lak::create_hard_link(From, To)
+		  .IF_ERR_WARN(
+		    "create hard link from ", From, " to ", To, " failed, trying copy")
+		  .or_else(
 		    [&](auto &&)
 		    {
-			    return lak::create_directory(To.parent_path())
-			      .IF_ERR("create directory failed")
-			      .map_err(errno_map);
+			    return lak::copy_file(From, To).IF_ERR(
+			      "copy file from ", From, " to ", To, " failed");
 		    })
-		  .and_then(
-		    [&](auto &&)
-		    {
-			    return lak::create_hard_link(From, To)
-			      .IF_ERR_WARN("create hard link from ",
-			                   From,
-			                   " to ",
-			                   To,
-			                   " failed, trying copy instead")
-			      .or_else(
-			        [&](auto &&)
-			        {
-				        return lak::copy_file(From, To).IF_ERR(
-				          "copy file from ", From, " to ", To, " failed");
-			        })
-			      .map_err(errno_map);
-		    });
+		  .is_ok();
 	};
 
 	using namespace std::string_literals;
@@ -302,185 +569,259 @@ void se::DumpSortedImages(se::source_explorer_t &srcexp,
 		       lak::to_u16string(result);
 	};
 
+	const image_encoding_t encoding = srcexp.image_encoding;
+	const std::u16string extension =
+	  lak::to_u16string(lak::astring(image_extension(encoding.format)));
+
+	// Every (image, palette) pair is decoded and encoded exactly once, all
+	// other places it appears are linked to that file.
+	struct sorted_image_t
+	{
+		const image::item_t *item;
+		const lak::color4_t *palette;
+		fs::path path;
+		bool saved = false;
+	};
+
+	struct sorted_link_t
+	{
+		size_t image;
+		fs::path path;
+	};
+
+	std::vector<sorted_image_t> images;
+	// Keyed on the image handle and a hash of the palette (0 for none).
+	std::map<std::pair<uint32_t, uint64_t>, size_t> image_cache;
+	// Links are grouped by frame so they can be made in parallel.
+	std::vector<std::vector<sorted_link_t>> frame_links;
+	std::vector<fs::path> directories;
+	// Objects are shared between frames, only work out their images once.
+	std::unordered_map<uint16_t,
+	                   std::unordered_map<uint32_t, std::vector<std::u16string>>>
+	  object_images;
+
 	fs::path root_path     = srcexp.sorted_images.path;
 	fs::path unsorted_path = root_path / "[unsorted]";
-	fs::create_directories(unsorted_path);
-	std::error_code err;
+	directories.push_back(unsorted_path);
 
-	size_t image_index       = 0;
-	const size_t image_count = srcexp.state.game.image_bank->items.size();
 	for (const auto &image : srcexp.state.game.image_bank->items)
 	{
-		std::u16string image_name = se::to_u16string(image.entry.handle) + u".png";
-		fs::path image_path       = unsorted_path / image_name;
-		(void)SaveImage(image.image(srcexp.dump_color_transparent).UNWRAP(),
-		                image_path);
-		completed = (float)((double)image_index++ / image_count);
+		image_cache.emplace(std::pair{image.entry.handle, uint64_t(0)},
+		                    images.size());
+		images.push_back(
+		  {&image,
+		   nullptr,
+		   unsorted_path /
+		     (se::to_u16string(image.entry.handle) + extension)});
 	}
 
-	size_t frame_index       = 0;
-	const size_t frame_count = srcexp.state.game.frame_bank->items.size();
+	size_t frame_index = 0;
 	for (const auto &frame : srcexp.state.game.frame_bank->items)
 	{
-		std::u16string frame_name = HandleName(frame.name, frame_index);
-		fs::path frame_path       = root_path / frame_name;
-		fs::create_directories(frame_path / "[unsorted]", err);
-		if (err)
-		{
-			ERROR("File System Error: (", err.value(), ")", err.message());
-			continue;
-		}
+		auto &links = frame_links.emplace_back();
+
+		fs::path frame_path = root_path / HandleName(frame.name, frame_index++);
+		fs::path frame_unsorted = frame_path / "[unsorted]";
+		directories.push_back(frame_unsorted);
+
+		const lak::color4_t *palette =
+		  frame.palette ? frame.palette->colors.data() : nullptr;
+		const uint64_t palette_hash =
+		  palette ? PaletteHash(frame.palette->colors) : 0;
 
-		if (frame.object_instances)
+		// Image handle -> the image this frame's [unsorted] copy comes from.
+		std::unordered_map<uint32_t, size_t> frame_images;
+		auto FrameImage = [&](uint32_t handle,
+		                      const image::item_t *img) -> size_t
 		{
-			std::unordered_set<uint32_t> used_images;
-			std::unordered_set<uint16_t> used_objects;
-			for (const auto &object : frame.object_instances->objects)
+			if (auto it = frame_images.find(handle); it != frame_images.end())
+				return it->second;
+
+			fs::path path = frame_unsorted / (se::to_u16string(handle) + extension);
+
+			size_t index;
+			if (palette && img->need_palette())
 			{
-				if (used_objects.find(object.handle) != used_objects.end()) continue;
-				used_objects.insert(object.handle);
-				if (const auto *obj =
-				      lak::as_ptr(se::GetObject(srcexp.state, object.handle).ok());
-				    obj)
+				auto [it, inserted] =
+				  image_cache.try_emplace({handle, palette_hash}, images.size());
+				if (inserted ||
+				    !std::equal(palette, palette + 256, images[it->second].palette))
 				{
-					std::u16string object_name = HandleName(
-					  obj->name,
-					  obj->handle,
-					  u"[" +
-					    lak::to_u16string(lak::astring(GetObjectTypeString(obj->type))) +
-					    u"]");
-					fs::path object_path = frame_path / object_name;
-					fs::create_directories(object_path, err);
-					if (err)
-					{
-						ERROR("File System Error: (", err.value(), ")", err.message());
-						continue;
-					}
-
-					for (auto [imghandle, imgnames] : obj->image_handles())
-					{
-						if (imghandle == 0xFFFF) continue;
-						if (const auto *img =
-						      lak::as_ptr(GetImage(srcexp.state, imghandle).ok());
-						    img)
-						{
-							if (used_images.find(imghandle) == used_images.end())
-							{
-								used_images.insert(imghandle);
-								std::u16string image_name =
-								  se::to_u16string(imghandle) + u".png";
-								fs::path image_path = frame_path / "[unsorted]" / image_name;
-
-								// check if 8bit image
-								if (img->need_palette() && frame.palette)
-									(void)SaveImage(img
-									                  ->image(srcexp.dump_color_transparent,
-									                          frame.palette->colors.data())
-									                  .UNWRAP(),
-									                image_path);
-								else if (auto res =
-								           LinkImages(unsorted_path / image_name, image_path);
-								         res.is_err())
-									lak::visit(res.unwrap_err(),
-									           lak::overloaded{
-									             [](const std::error_code &err) {
-										             ERROR("Linking Failed: (",
-										                   err.value(),
-										                   ")",
-										                   err.message());
-									             },
-									             [](const auto &err)
-									             { ERROR("Linking Failed: ", err); },
-									           });
-							}
-							for (const auto &imgname : imgnames)
-							{
-								std::u16string unsorted_image_name =
-								  se::to_u16string(imghandle) + u".png";
-								fs::path unsorted_image_path =
-								  frame_path / "[unsorted]" / unsorted_image_name;
-								std::u16string image_name = imgname + u".png";
-								fs::path image_path       = object_path / image_name;
-								if (const auto *i =
-								      lak::as_ptr(GetImage(srcexp.state, imghandle).ok());
-								    i)
-									if (auto res = LinkImages(unsorted_image_path, image_path);
-									    res.is_err())
-										lak::visit(res.unwrap_err(),
-										           lak::overloaded{
-										             [](const std::error_code &err) {
-											             ERROR("Linking Failed: (",
-											                   err.value(),
-											                   ")",
-											                   err.message());
-										             },
-										             [](const auto &err)
-										             { ERROR("Linking Failed: ", err); },
-										           });
-							}
-						}
-					}
+					// New palette (or a hash collision), this frame gets its own copy.
+					images.push_back({img, palette, lak::move(path)});
+					return frame_images[handle] = images.size() - 1;
 				}
+				index = it->second;
+			}
+			else if (auto it = image_cache.find({handle, uint64_t(0)});
+			         it != image_cache.end())
+			{
+				index = it->second;
+			}
+			else
+			{
+				// Not in the image bank's own list, save it here instead.
+				image_cache.emplace(std::pair{handle, uint64_t(0)}, images.size());
+				images.push_back({img, nullptr, lak::move(path)});
+				return frame_images[handle] = images.size() - 1;
+			}
+
+			links.push_back({index, lak::move(path)});
+			return frame_images[handle] = index;
+		};
+
+		if (!frame.object_instances) continue;
+
+		std::unordered_set<uint16_t> used_objects;
+		for (const auto &object : frame.object_instances->objects)
+		{
+			if (!used_objects.insert(object.handle).second) continue;
+
+			const auto *obj =
+			  lak::as_ptr(se::GetObject(srcexp.state, object.handle).ok());
+			if (!obj) continue;
+
+			fs::path object_path =
+			  frame_path /
+			  HandleName(obj->name,
+			             obj->handle,
+			             u"[" +
+			               lak::to_u16string(
+			                 lak::astring(GetObjectTypeString(obj->type))) +
+			               u"]");
+			directories.push_back(object_path);
+
+			auto it = object_images.find(obj->handle);
+			if (it == object_images.end())
+				it = object_images.emplace(obj->handle, obj->image_handles()).first;
+
+			for (const auto &[imghandle, imgnames] : it->second)
+			{
+				if (imghandle == 0xFFFF) continue;
+				const auto *img =
+				  lak::as_ptr(GetImage(srcexp.state, imghandle).ok());
+				if (!img) continue;
+
+				const size_t index = FrameImage(imghandle, img);
+				for (const auto &imgname : imgnames)
+					links.push_back({index, object_path / (imgname + extension)});
 			}
 		}
-		completed = (float)((double)frame_index++ / frame_count);
 	}
+
+	for (const auto &directory : directories)
+	{
+		std::error_code err;
+		fs::create_directories(directory, err);
+		if (err) ERROR("File System Error: (", err.value(), ")", err.message());
+	}
+
+	const double work_count       = double(images.size() + frame_links.size());
+	std::atomic<size_t> work_done = 0;
+
+	auto Progress = [&]
+	{
+		job.completed = (float)(double(++work_done) / work_count);
+	};
+
+	auto SaveSortedImage = [&](size_t index)
+	{
+		auto &image = images[index];
+		auto written =
+		  image.item->image(srcexp.dump_color_transparent, image.palette)
+		    .and_then([&](const auto &decoded)
+		              { return WriteImage(decoded, image.path, encoding); })
+		    .MAP_SE_ERR("failed to save image ", image.item->entry.handle);
+		if (written.is_ok())
+		{
+			image.saved = true;
+			++job.items;
+			job.bytes += written.unsafe_unwrap();
+		}
+		else
+		{
+			ERROR(written.unsafe_unwrap_err());
+			++job.failed;
+		}
+		Progress();
+	};
+
+	auto LinkFrame = [&](size_t frame)
+	{
+		for (const auto &link : frame_links[frame])
+		{
+			// An image that failed to save leaves every link to it missing.
+			if (images[link.image].saved &&
+			    LinkImage(images[link.image].path, link.path))
+				++job.items;
+			else
+				++job.failed;
+		}
+		Progress();
+	};
+
+	parallel_for(images.size(), SaveSortedImage);
+	parallel_for(frame_links.size(), LinkFrame);
 }
 
-void se::DumpAppIcon(source_explorer_t &srcexp, std::atomic<float> &)
+void se::DumpAppIcon(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.icon)
 	{
 		ERROR("No Icon");
+		++job.failed;
 		return;
 	}
 
 	lak::image4_t &bitmap = srcexp.state.game.icon->bitmap;
 
+	// .ICO files can only embed PNGs, whatever the image format is set to.
+	auto png = EncodeImage(bitmap);
+	if (png.is_err())
+	{
+		ERROR(png.unsafe_unwrap_err());
+		++job.failed;
+		return;
+	}
+	const auto &data = png.unsafe_unwrap();
+
+	lak::binary_array_writer strm;
+	strm.reserve(0x16);
+	strm.write_u16(0); // reserved
+	strm.write_u16(1); // .ICO
+	strm.write_u16(1); // 1 image
+	strm.write_u8(static_cast<uint8_t>(bitmap.size().x));
+	strm.write_u8(static_cast<uint8_t>(bitmap.size().y));
+	strm.write_u8(0);      // no palette
+	strm.write_u8(0);      // reserved
+	strm.write_u16(1);     // color plane
+	strm.write_u16(8 * 4); // bits per pixel
+	strm.write_u32(static_cast<uint32_t>(data.size()));
+	strm.write_u32(static_cast<uint32_t>(strm.size() + sizeof(uint32_t)));
+	auto result = strm.release();
+
 	fs::path filename = srcexp.appicon.path / "favicon.ico";
 	std::ofstream file(filename,
 	                   std::ios::binary | std::ios::out | std::ios::ate);
-	if (!file.is_open()) return;
-
-	stbi_write_func *func = [](void *context, void *png, int len)
-	{
-		auto [out, image] =
-		  *static_cast<std::tuple<std::ofstream *, lak::image4_t *> *>(context);
-		lak::binary_array_writer strm;
-		strm.reserve(0x16);
-		strm.write_u16(0); // reserved
-		strm.write_u16(1); // .ICO
-		strm.write_u16(1); // 1 image
-		strm.write_u8(static_cast<uint8_t>(image->size().x));
-		strm.write_u8(static_cast<uint8_t>(image->size().y));
-		strm.write_u8(0);      // no palette
-		strm.write_u8(0);      // reserved
-		strm.write_u16(1);     // color plane
-		strm.write_u16(8 * 4); // bits per pixel
-		strm.write_u32(len);
-		strm.write_u32(static_cast<uint32_t>(strm.size() + sizeof(uint32_t)));
-		auto result = strm.release();
-		out->write(reinterpret_cast<const char *>(result.data()), result.size());
-		out->write((const char *)png, len);
-	};
-
-	auto context = std::tuple<std::ofstream *, lak::image4_t *>(&file, &bitmap);
-	stbi_write_png_to_func(func,
-	                       &context,
-	                       (int)bitmap.size().x,
-	                       (int)bitmap.size().y,
-	                       4,
-	                       bitmap.data(),
-	                       (int)(bitmap.size().x * 4));
+	file.write(reinterpret_cast<const char *>(result.data()), result.size());
+	file.write(reinterpret_cast<const char *>(data.data()), data.size());
+	if (!file)
+	{
+		ERROR("Failed To Save File '", filename, "'");
+		++job.failed;
+		return;
+	}
 
-	file.close();
+	++job.items;
+	job.bytes += result.size() + data.size();
 }
 
-void se::DumpSounds(source_explorer_t &srcexp, std::atomic<float> &completed)
+void se::DumpSounds(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.sound_bank)
 	{
 		ERROR("No Sound Bank");
+		++job.failed;
 		return;
 	}
 
@@ -587,17 +928,24 @@ void se::DumpSounds(source_explorer_t &srcexp, std::atomic<float> &completed)
 		if (!lak::save_file(filename, result))
 		{
 			ERROR("Failed To Save File '", filename, "'");
+			++job.failed;
+		}
+		else
+		{
+			++job.items;
+			job.bytes += result.size();
 		}
 
-		completed = (float)((double)(index++) / (double)count);
+		job.completed = (float)((double)(index++) / (double)count);
 	}
 }
 
-void se::DumpMusic(source_explorer_t &srcexp, std::atomic<float> &completed)
+void se::DumpMusic(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.music_bank)
 	{
 		ERROR("No Music Bank");
+		++job.failed;
 		return;
 	}
 
@@ -654,17 +1002,24 @@ void se::DumpMusic(source_explorer_t &srcexp, std::atomic<float> &completed)
 		if (!lak::save_file(filename, sound.remaining()))
 		{
 			ERROR("Failed To Save File '", filename, "'");
+			++job.failed;
+		}
+		else
+		{
+			++job.items;
+			job.bytes += sound.remaining().size();
 		}
 
-		completed = (float)((double)(index++) / (double)count);
+		job.completed = (float)((double)(index++) / (double)count);
 	}
 }
 
-void se::DumpShaders(source_explorer_t &srcexp, std::atomic<float> &completed)
+void se::DumpShaders(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.shaders)
 	{
 		ERROR("No Shaders");
+		++job.failed;
 		return;
 	}
 
@@ -697,18 +1052,24 @@ void se::DumpShaders(source_explorer_t &srcexp, std::atomic<float> &completed)
 		                file.size())))
 		{
 			ERROR("Failed To Save File '", filename, "'");
+			++job.failed;
+		}
+		else
+		{
+			++job.items;
+			job.bytes += file.size();
 		}
 
-		completed = (float)((double)count++ / (double)offsets.size());
+		job.completed = (float)((double)count++ / (double)offsets.size());
 	}
 }
 
-void se::DumpBinaryFiles(source_explorer_t &srcexp,
-                         std::atomic<float> &completed)
+void se::DumpBinaryFiles(source_explorer_t &srcexp, job_t &job)
 {
 	if (!srcexp.state.game.binary_files)
 	{
 		ERROR("No Binary Files");
+		++job.failed;
 		return;
 	}
 
@@ -722,15 +1083,93 @@ void se::DumpBinaryFiles(source_explorer_t &srcexp,
 		fs::path filename = lak::to_u16string(file.name);
 		filename          = srcexp.binary_files.path / filename.filename();
 		DEBUG(filename);
-		if (!lak::save_file(filename, file.data))
+		if (!lak::save_file(filename, file.data.get()))
 		{
 			ERROR("Failed To Save File '", filename, "'");
+			++job.failed;
 		}
-		completed = (float)((double)index++ / (double)count);
+		else
+		{
+			++job.items;
+			job.bytes += file.data.size();
+		}
+		job.completed = (float)((double)index++ / (double)count);
 	}
 }
 
-void se::SaveErrorLog(source_explorer_t &srcexp, std::atomic<float> &)
+void se::DumpPackFiles(source_explorer_t &srcexp, job_t &job)
+{
+	if (srcexp.state.pack_files.empty())
+	{
+		ERROR("No Pack Files");
+		++job.failed;
+		return;
+	}
+
+	// Pack files can be large, stream them out of the game file a block at a
+	// time rather than copying (or mapping) each one in full first.
+	constexpr size_t block_size = 0x100000;
+
+	size_t total_size = 0;
+	for (const auto &file : srcexp.state.pack_files)
+		total_size += file.data.size();
+
+	size_t written = 0;
+	for (const auto &file : srcexp.state.pack_files)
+	{
+		fs::path filename = file.filename;
+		filename          = srcexp.pack_files.path / filename.filename();
+		DEBUG(filename);
+
+		std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			ERROR("Failed To Open File '", filename, "'");
+			++job.failed;
+			written += file.data.size();
+			continue;
+		}
+
+		auto reader = file.data.reader();
+		bool saved  = true;
+		for (size_t offset = 0; offset < file.data.size(); offset += block_size)
+		{
+			const auto block =
+			  reader.read_ref_span(std::min(block_size, file.data.size() - offset));
+			if (block.is_err())
+			{
+				ERROR("Failed To Read File '", filename, "'");
+				++job.failed;
+				saved = false;
+				break;
+			}
+
+			const auto &span = block.unsafe_unwrap();
+			out.write(reinterpret_cast<const char *>(span.data()),
+			          static_cast<std::streamsize>(span.size()));
+			if (!out)
+			{
+				ERROR("Failed To Save File '", filename, "'");
+				++job.failed;
+				saved = false;
+				break;
+			}
+
+			if (total_size > 0)
+				job.completed = (float)((double)(written + offset + span.size()) /
+				                        (double)total_size);
+		}
+
+		if (saved)
+		{
+			++job.items;
+			job.bytes += file.data.size();
+		}
+		written += file.data.size();
+	}
+}
+
+void se::SaveErrorLog(source_explorer_t &srcexp, job_t &)
 {
 	if (!lak::save_file(srcexp.error_log.path, lak::debugger.str()))
 	{
@@ -738,7 +1177,7 @@ void se::SaveErrorLog(source_explorer_t &srcexp, std::atomic<float> &)
 	}
 }
 
-void se::SaveBinaryBlock(source_explorer_t &srcexp, std::atomic<float> &)
+void se::SaveBinaryBlock(source_explorer_t &srcexp, job_t &)
 {
 	srcexp.binary_block.path += ".bin";
 	if (!lak::save_file(srcexp.binary_block.path,
@@ -818,14 +1257,13 @@ void se::AttemptExe(source_explorer_t &srcexp)
 	  srcexp.exe,
 	  [&srcexp]
 	  {
-		  if (auto result = OpenGame(srcexp); result.is_err())
+		  if (auto result = OpenGame(srcexp); !result)
 		  {
-			  ASSERT(result.unwrap_err() == lak::await_error::running);
 			  return false;
 		  }
-		  else if (result.unwrap().is_err())
+		  else if (result->is_err())
 		  {
-			  result.unwrap().IF_ERR("AttemptExe failed").discard();
+			  result->IF_ERR("AttemptExe failed").discard();
 			  // ERROR(result.unwrap()
 			  //         .MAP_SE_ERR("AttemptExe failed")
 			  //         .unwrap_err());
@@ -942,58 +1380,109 @@ void se::AttemptImages(source_explorer_t &srcexp)
 {
 	AttemptFolder(srcexp.images,
 	              [&srcexp]
-	              { return DumpStuff(srcexp, "Dump Images", &DumpImages); });
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.images,
+		                               "Dump Images",
+		                               &DumpImages);
+	              });
 }
 
 void se::AttemptSortedImages(source_explorer_t &srcexp)
 {
-	AttemptFolder(
-	  srcexp.sorted_images,
-	  [&srcexp]
-	  { return DumpStuff(srcexp, "Dump Sorted Images", &DumpSortedImages); });
+	AttemptFolder(srcexp.sorted_images,
+	              [&srcexp]
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.sorted_images,
+		                               "Dump Sorted Images",
+		                               &DumpSortedImages);
+	              });
 }
 
 void se::AttemptAppIcon(source_explorer_t &srcexp)
 {
 	AttemptFolder(srcexp.appicon,
 	              [&srcexp]
-	              { return DumpStuff(srcexp, "Dump App Icon", &DumpAppIcon); });
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.appicon,
+		                               "Dump App Icon",
+		                               &DumpAppIcon);
+	              });
 }
 
 void se::AttemptSounds(source_explorer_t &srcexp)
 {
 	AttemptFolder(srcexp.sounds,
 	              [&srcexp]
-	              { return DumpStuff(srcexp, "Dump Sounds", &DumpSounds); });
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.sounds,
+		                               "Dump Sounds",
+		                               &DumpSounds);
+	              });
 }
 
 void se::AttemptMusic(source_explorer_t &srcexp)
 {
 	AttemptFolder(srcexp.music,
 	              [&srcexp]
-	              { return DumpStuff(srcexp, "Dump Music", &DumpMusic); });
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.music,
+		                               "Dump Music",
+		                               &DumpMusic);
+	              });
 }
 
 void se::AttemptShaders(source_explorer_t &srcexp)
 {
 	AttemptFolder(srcexp.shaders,
 	              [&srcexp]
-	              { return DumpStuff(srcexp, "Dump Shaders", &DumpShaders); });
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.shaders,
+		                               "Dump Shaders",
+		                               &DumpShaders);
+	              });
 }
 
 void se::AttemptBinaryFiles(source_explorer_t &srcexp)
 {
-	AttemptFolder(
-	  srcexp.binary_files,
-	  [&srcexp]
-	  { return DumpStuff(srcexp, "Dump Binary Files", &DumpBinaryFiles); });
+	AttemptFolder(srcexp.binary_files,
+	              [&srcexp]
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.binary_files,
+		                               "Dump Binary Files",
+		                               &DumpBinaryFiles);
+	              });
+}
+
+void se::AttemptPackFiles(source_explorer_t &srcexp)
+{
+	AttemptFolder(srcexp.pack_files,
+	              [&srcexp]
+	              {
+		              return DumpStuff(srcexp,
+		                               srcexp.pack_files,
+		                               "Dump Pack Files",
+		                               &DumpPackFiles);
+	              });
 }
 
 void se::AttemptErrorLog(source_explorer_t &srcexp)
 {
 	AttemptFile(
 	  srcexp.error_log,
-	  [&srcexp] { return DumpStuff(srcexp, "Save Error Log", &SaveErrorLog); },
+	  [&srcexp]
+	  {
+		  return DumpStuff(srcexp,
+		                   srcexp.error_log,
+		                   "Save Error Log",
+		                   &SaveErrorLog);
+	  },
 	  true);
 }
 
@@ -1002,6 +1491,11 @@ void se::AttemptBinaryBlock(source_explorer_t &srcexp)
 	AttemptFile(
 	  srcexp.binary_block,
 	  [&srcexp]
-	  { return DumpStuff(srcexp, "Save Binary Block", &SaveBinaryBlock); },
+	  {
+		  return DumpStuff(srcexp,
+		                   srcexp.binary_block,
+		                   "Save Binary Block",
+		                   &SaveBinaryBlock);
+	  },
 	  true);
 }
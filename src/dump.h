@@ -27,40 +27,104 @@ SOFTWARE.
 #include "explorer.h"
 
 #include <atomic>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <tuple>
+#include <vector>
 
 namespace SourceExplorer
 {
+	// Encode image exactly as SaveImage would write it.
+	[[nodiscard]] result_t<std::vector<byte_t>> EncodeImage(
+	  const lak::image4_t &image, const image_encoding_t &encoding = {});
+
+	// Stream image straight into filename as it is encoded, returns the number
+	// of bytes written.
+	[[nodiscard]] result_t<size_t> WriteImage(
+	  const lak::image4_t &image,
+	  const fs::path &filename,
+	  const image_encoding_t &encoding = {});
+
 	[[nodiscard]] error_t SaveImage(const lak::image4_t &image,
-	                                const fs::path &filename);
+	                                const fs::path &filename,
+	                                const image_encoding_t &encoding = {});
 
 	[[nodiscard]] error_t SaveImage(source_explorer_t &srcexp,
 	                                uint16_t handle,
 	                                const fs::path &filename,
 	                                const frame::item_t *frame);
 
-	[[nodiscard]] lak::await_result<error_t> OpenGame(source_explorer_t &srcexp);
+	// Start loading srcexp.exe on the thread pool if it isn't already, returns
+	// the result once it has finished.
+	[[nodiscard]] std::optional<error_t> OpenGame(source_explorer_t &srcexp);
 
-	using dump_data_t = std::tuple<source_explorer_t &, std::atomic<float> &>;
-
-	using dump_function_t = void(source_explorer_t &, std::atomic<float> &);
+	using dump_function_t = void(source_explorer_t &, job_t &);
 
+	// Start func as a job on the thread pool, returns false (try again later)
+	// if file_state is still in use by an earlier job.
 	bool DumpStuff(source_explorer_t &srcexp,
+	               file_state_t &file_state,
 	               const char *str_id,
 	               dump_function_t *func);
 
-	void DumpImages(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void DumpSortedImages(source_explorer_t &srcexp,
-	                      std::atomic<float> &completed);
-	void DumpAppIcon(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void DumpSounds(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void DumpMusic(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void DumpShaders(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void DumpBinaryFiles(source_explorer_t &srcexp,
-	                     std::atomic<float> &completed);
-	void SaveErrorLog(source_explorer_t &srcexp, std::atomic<float> &completed);
-	void SaveBinaryBlock(source_explorer_t &srcexp,
-	                     std::atomic<float> &completed);
+	enum struct batch_status_t : int
+	{
+		ok = 0,
+		// Bad command line, nothing was attempted.
+		usage = 1,
+		// The game failed to load.
+		load_failed = 2,
+		// The game loaded but some files could not be dumped.
+		dump_failed = 3,
+		// The game went over its memory budget and was abandoned (-corpus
+		// only).
+		over_budget = 4,
+	};
+
+	// Comma separated list of the dumps BatchDump accepts.
+	extern const char *batch_dump_names;
+
+	struct batch_dump_t
+	{
+		const char *name;
+		// Where the dump writes to.
+		file_state_t source_explorer_t::*state;
+		dump_function_t *func;
+	};
+
+	// nullptr if there is no dump called name.
+	const batch_dump_t *FindBatchDump(std::string_view name);
+
+	// Look up every name in names, reporting the first that doesn't exist as
+	// an error event and returning false.
+	bool FindBatchDumps(const std::vector<std::string> &names,
+	                    std::vector<const batch_dump_t *> &dumps);
+
+	// Load srcexp.exe.path and run each of the named dumps into its own folder
+	// under out, without any UI. Progress is written to stdout as one JSON
+	// object per line. If anything goes wrong the error log is saved to
+	// out/error_log.txt.
+	batch_status_t BatchDump(source_explorer_t &srcexp,
+	                         const std::vector<std::string> &dumps,
+	                         const fs::path &out);
+
+	// Load srcexp.exe.path and decode everything in it: every image (then
+	// encoded as srcexp.image_encoding, in memory) and every sound, music
+	// and font item. Reports each phase's wall time, then the perf_counters
+	// totals as one "stage" event per stage. Nothing is written to disk.
+	batch_status_t BenchGame(source_explorer_t &srcexp);
+
+	void DumpImages(source_explorer_t &srcexp, job_t &job);
+	void DumpSortedImages(source_explorer_t &srcexp, job_t &job);
+	void DumpAppIcon(source_explorer_t &srcexp, job_t &job);
+	void DumpSounds(source_explorer_t &srcexp, job_t &job);
+	void DumpMusic(source_explorer_t &srcexp, job_t &job);
+	void DumpShaders(source_explorer_t &srcexp, job_t &job);
+	void DumpBinaryFiles(source_explorer_t &srcexp, job_t &job);
+	void DumpPackFiles(source_explorer_t &srcexp, job_t &job);
+	void SaveErrorLog(source_explorer_t &srcexp, job_t &job);
+	void SaveBinaryBlock(source_explorer_t &srcexp, job_t &job);
 
 	template<typename LOAD, typename MANIP>
 	void Attempt(file_state_t &file_state, LOAD load, MANIP mamip)
@@ -86,6 +150,7 @@ namespace SourceExplorer
 	void AttemptMusic(source_explorer_t &srcexp);
 	void AttemptShaders(source_explorer_t &srcexp);
 	void AttemptBinaryFiles(source_explorer_t &srcexp);
+	void AttemptPackFiles(source_explorer_t &srcexp);
 	void AttemptErrorLog(source_explorer_t &srcexp);
 	void AttemptBinaryBlock(source_explorer_t &srcexp);
 }
@@ -1,12 +1,14 @@
 #include "encryption.h"
 
+#include <lak/debug.hpp>
+
+#include <algorithm>
 #include <numeric>
 
 bool encryption_table::init(lak::span<const uint8_t, 0x100U> magic_key,
                             const char magic_char)
 {
-	std::iota(decode_buffer.u32, decode_buffer.u32 + 256U, 0U);
-	// u32 never exceeds the max value of u8 (255)
+	std::iota(state, state + 256U, uint8_t(0U));
 
 	auto rotate = [](uint8_t value) -> uint8_t
 	{ return (value << 7U) | (value >> 1U); };
@@ -38,9 +40,9 @@ bool encryption_table::init(lak::span<const uint8_t, 0x100U> magic_key,
 			never_reset_key = false;
 		}
 
-		i2 += static_cast<uint8_t>((hash ^ *key) + decode_buffer.u32[i]);
+		i2 += static_cast<uint8_t>((hash ^ *key) + state[i]);
 
-		std::swap(decode_buffer.u32[i], decode_buffer.u32[i2]);
+		std::swap(state[i], state[i2]);
 	}
 
 	valid = true;
@@ -51,19 +53,91 @@ bool encryption_table::decode(lak::span<byte_t> chunk) const
 {
 	if (!valid) return false;
 
-	decode_buffer_t buffer;
-	lak::memcpy(&buffer, &decode_buffer);
+	encryption_stream(*this).decode(chunk, chunk);
+	return true;
+}
 
-	uint8_t i  = 0U;
-	uint8_t i2 = 0U;
-	for (uint8_t &elem : lak::span<uint8_t>(chunk))
+encryption_stream::encryption_stream(const encryption_table &table)
+{
+	assert(table.valid);
+	const __m128i zero = _mm_setzero_si128();
+	for (size_t n = 0; n < 256; n += 16)
 	{
-		++i;
-		i2 += (uint8_t)buffer.u32[i];
-		std::swap(buffer.u32[i], buffer.u32[i2]);
-		elem ^= buffer.u8[4U * uint8_t(buffer.u32[i] + buffer.u32[i2])];
+		const __m128i bytes =
+		  _mm_loadu_si128(reinterpret_cast<const __m128i *>(table.state + n));
+		const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+		__m128i *out     = reinterpret_cast<__m128i *>(state + n);
+		_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+	}
+}
+
+void encryption_stream::generate()
+{
+	// Work on locals, the keystream stores could otherwise alias i and i2.
+	uint32_t *s     = state;
+	uint8_t *stream = _keystream;
+	uint32_t x      = (i + 1U) & 0xFFU;
+	uint32_t y      = i2;
+	uint32_t a      = s[x];
+	for (size_t n = 0; n < block_size; ++n)
+	{
+		// Load the next entry before this swap rather than after it, so i2
+		// doesn't have to wait on the store. It only changes if the swap wrote
+		// to it.
+		const uint32_t next_x = (x + 1U) & 0xFFU;
+		const uint32_t next_a = s[next_x];
+
+		y                = (y + a) & 0xFFU;
+		const uint32_t b = s[y];
+		s[x]             = b;
+		s[y]             = a;
+		stream[n]        = uint8_t(s[(a + b) & 0xFFU]);
+
+		a = y == next_x ? a : next_a;
+		x = next_x;
+	}
+	i     = uint8_t(x - 1U);
+	i2    = uint8_t(y);
+	_used = 0;
+}
+
+void encryption_stream::decode(lak::span<const byte_t> src,
+                               lak::span<byte_t> dst)
+{
+	assert(src.size() == dst.size());
+
+	const uint8_t *in = reinterpret_cast<const uint8_t *>(src.data());
+	uint8_t *out      = reinterpret_cast<uint8_t *>(dst.data());
+	size_t size       = src.size();
+
+	while (size > 0)
+	{
+		if (_used == block_size) generate();
+
+		const uint8_t *key = _keystream + _used;
+		const size_t count = std::min(size, block_size - _used);
+
+		size_t n = 0;
+		for (; n + 16 <= count; n += 16)
+		{
+			const __m128i data =
+			  _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + n));
+			const __m128i mask =
+			  _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + n));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + n),
+			                 _mm_xor_si128(data, mask));
+		}
+		for (; n < count; ++n) out[n] = in[n] ^ key[n];
+
+		in += count;
+		out += count;
+		size -= count;
+		_used += count;
 	}
-	return true;
 }
 
 std::vector<uint8_t> KeyString(const std::u16string &str)
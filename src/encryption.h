@@ -1,50 +1,22 @@
 #ifndef ENCRYPTION_H
 #define ENCRYPTION_H
 
-#include "explorer.h"
-
 #include <lak/span.hpp>
+#include <lak/stdint.hpp>
 
 #include <assert.h>
 #include <cstring>
 #include <emmintrin.h>
 #include <iostream>
 #include <stdint.h>
+#include <string>
 #include <utility>
 #include <vector>
 
-union alignas(__m128i) m128i_t
-{
-	__m128i m128i;
-	int8_t m128i_i8[16];
-	int16_t m128i_i16[8];
-	int32_t m128i_i32[4];
-	int64_t m128i_i64[2];
-	uint8_t m128i_u8[16];
-	uint16_t m128i_u16[8];
-	uint32_t m128i_u32[4];
-	uint64_t m128i_u64[2];
-	operator __m128i() const { return m128i; }
-	operator __m128i &() { return m128i; }
-	operator const __m128i &() const { return m128i; }
-};
-
 struct encryption_table
 {
-	union decode_buffer_t
-	{
-		m128i_t m128i[64];
-		__m128i _m128i[64];
-		int8_t i8[64 * 16];
-		int16_t i16[64 * 8];
-		int32_t i32[64 * 4];
-		int64_t i64[64 * 2];
-		uint8_t u8[64 * 16];
-		uint16_t u16[64 * 8];
-		uint32_t u32[64 * 4];
-		uint64_t u64[64 * 2];
-	};
-	decode_buffer_t decode_buffer;
+	// A permutation of 0..255, the keystream generator's starting state.
+	uint8_t state[256];
 	bool valid = false;
 
 	bool init(lak::span<const uint8_t, 0x100> magic_key, const char magic_char);
@@ -52,6 +24,34 @@ struct encryption_table
 	bool decode(lak::span<byte_t> chunk) const;
 };
 
+// Decodes one chunk a block at a time, each call carries the keystream on
+// from where the last one stopped.
+struct encryption_stream
+{
+	// Keystream is generated this many bytes at a time, then XOR-ed over the
+	// data 16 bytes at a time.
+	static constexpr size_t block_size = 256;
+
+	// The table's permutation widened back out to 32 bits per entry, byte
+	// sized entries are noticeably slower to shuffle on x86.
+	uint32_t state[256];
+	uint8_t i  = 0U;
+	uint8_t i2 = 0U;
+
+	// table must be valid.
+	encryption_stream(const encryption_table &table);
+
+	// Decode src into dst, which must be the same size. They may be the same
+	// memory.
+	void decode(lak::span<const byte_t> src, lak::span<byte_t> dst);
+
+private:
+	void generate();
+
+	alignas(16) uint8_t _keystream[block_size];
+	size_t _used = block_size;
+};
+
 std::vector<uint8_t> KeyString(const std::u16string &str);
 
 #endif
\ No newline at end of file
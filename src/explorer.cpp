@@ -19,15 +19,17 @@
 #	define NOMINMAX
 #endif
 
-#include "lak/compression/deflate.hpp"
 #include "lak/compression/lz4.hpp"
 #include "lak/string.hpp"
 #include "lak/string_utils.hpp"
 #include "lak/string_view.hpp"
 
 #include "explorer.h"
+#include "perf_counters.hpp"
 #include "tostring.hpp"
 
+#include <cinttypes>
+
 #ifdef GetObject
 #	undef GetObject
 #endif
@@ -37,14 +39,6 @@
 
 namespace SourceExplorer
 {
-	bool force_compat = false;
-	encryption_table decryptor;
-	std::vector<uint8_t> _magic_key;
-	game_mode_t _mode = game_mode_t::_OLD;
-	uint8_t _magic_char;
-	std::atomic<float> game_t::completed      = 0.0f;
-	std::atomic<float> game_t::bank_completed = 0.0f;
-
 	using namespace std::string_literals;
 
 	std::vector<uint8_t> &operator+=(std::vector<uint8_t> &lhs,
@@ -54,26 +48,253 @@ namespace SourceExplorer
 		return lhs;
 	}
 
+	lazy_span_t::lazy_span_t(const data_ref_span_t &span) : _size(span.size())
+	{
+		if (span.in_window())
+		{
+			_file   = span._source->_mapping->owner();
+			_arena  = span._source->_arena;
+			_offset = span.position().UNWRAP();
+		}
+		if (!_file) _span = span;
+	}
+
+	lazy_span_t::lazy_span_t(std::shared_ptr<windowed_file_t> file,
+	                         std::shared_ptr<decode_arena_t> arena,
+	                         uint64_t offset,
+	                         size_t size)
+	: _file(lak::move(file)),
+	  _arena(lak::move(arena)),
+	  _offset(offset),
+	  _size(size)
+	{
+	}
+
+	data_ref_span_t lazy_span_t::get() const
+	{
+		if (!_file || _size == 0) return _span;
+
+		auto window = _file->window(_offset, _size);
+		if (window.is_err()) return {};
+
+		auto source = make_data_ref_ptr(window.unsafe_unwrap(), _arena);
+		return data_ref_span_t(
+		  source, size_t(_offset - source->file_offset()), _size);
+	}
+
+	data_reader_t lazy_span_t::reader() const
+	{
+		if (!_file) return data_reader_t(_span);
+
+		data_reader_t result(_file, _arena, _offset, _size);
+		if (result.seek(0).is_err())
+			WARNING("Failed To Map Window At ", _offset);
+		return result;
+	}
+
+	uint64_t lazy_span_t::position() const
+	{
+		if (_file) return _offset;
+		return lak::ok_or_err(_span.position().map_err(
+		  [](auto &&) -> uint64_t { return UINT64_MAX; }));
+	}
+
+	index_key_t lazy_span_t::index_key() const
+	{
+		// Windows are always roots, see data_ref_span_t::index_key.
+		if (_file) return {0, _offset};
+		return _span.index_key();
+	}
+
+	void lazy_span_t::reset()
+	{
+		_span.reset();
+		_file.reset();
+		_arena.reset();
+		_offset = 0;
+		_size   = 0;
+	}
+
+	lak::result<> data_reader_t::seek(uint64_t pos)
+	{
+		if (!_file)
+		{
+			if (pos > SIZE_MAX || lak::binary_reader::seek(size_t(pos)).is_err())
+				return lak::err_t{};
+			return lak::ok_t{};
+		}
+
+		if (pos > size()) return lak::err_t{};
+
+		const uint64_t target = _start + pos;
+		const uint64_t end    = _base + lak::binary_reader::size();
+		if (_source && target >= _base && target <= end &&
+		    (end - target >= window_margin || end == _end))
+		{
+			if (lak::binary_reader::seek(size_t(target - _base)).is_err())
+				return lak::err_t{};
+			return lak::ok_t{};
+		}
+
+		return map_window(pos, window_margin);
+	}
+
+	lak::result<> data_reader_t::ensure(size_t count)
+	{
+		if (!_file || (_source && remaining().size() >= count))
+			return lak::ok_t{};
+
+		const uint64_t pos = position();
+		if (pos >= size()) return lak::ok_t{};
+
+		// The current window already reaches the end of the range.
+		if (_source && remaining().size() == size() - pos) return lak::ok_t{};
+
+		// Keep the margin past the requested range paged in too, so the next
+		// chunk header can be peeked without remapping.
+		return map_window(pos, std::min(count, SIZE_MAX - window_margin) +
+		                         window_margin);
+	}
+
+	lak::result<> data_reader_t::map_window(uint64_t pos, size_t count)
+	{
+		FUNCTION_CHECKPOINT("data_reader_t::");
+
+		ASSERT(_file);
+
+		if (pos >= size())
+		{
+			// Nothing left to map, park the read head at the end of the range.
+			_source = {};
+			_base   = _end;
+			static_cast<lak::binary_reader &>(*this) =
+			  lak::binary_reader(lak::span<const byte_t>());
+			return lak::ok_t{};
+		}
+
+		const uint64_t target = _start + pos;
+		RES_TRY_ASSIGN(
+		  auto window =,
+		  _file->window(target, size_t(std::min<uint64_t>(count, _end - target))));
+
+		_source = make_data_ref_ptr(lak::move(window), _arena);
+
+		// Clip the window to the range so the reader never sees past _end.
+		const uint64_t window_start = _source->file_offset();
+		const uint64_t window_end   = window_start + _source->get().size();
+		_base                       = std::max(window_start, _start);
+		static_cast<lak::binary_reader &>(*this) =
+		  lak::binary_reader(lak::span<const byte_t>(_source->get()).subspan(
+		    size_t(_base - window_start),
+		    size_t(std::min(window_end, _end) - _base)));
+
+		if (lak::binary_reader::seek(size_t(target - _base)).is_err())
+			return lak::err_t{};
+		return lak::ok_t{};
+	}
+
+	result_t<data_ref_ptr_t> OpenFile(const fs::path &path,
+	                                  std::shared_ptr<decode_arena_t> arena)
+	{
+		FUNCTION_CHECKPOINT();
+
+		if (auto mapping = mapped_file_t::open(path); mapping.is_ok())
+			return lak::ok_t{make_data_ref_ptr(mapping.unsafe_unwrap(), arena)};
+
+		DEBUG("Failed To Map File, Reading Instead");
+
+		RES_TRY_ASSIGN(auto bytes =, lak::read_file(path).MAP_ERR("OpenFile"));
+
+		return lak::ok_t{make_data_ref_ptr(lak::move(bytes), arena)};
+	}
+
+	void UnloadGame(source_explorer_t &srcexp)
+	{
+		if (srcexp.state.arena) srcexp.state.arena->abandon();
+		srcexp.state = game_t{};
+	}
+
 	error_t LoadGame(source_explorer_t &srcexp)
 	{
 		FUNCTION_CHECKPOINT();
 
 		DEBUG("Attempting To Load ", srcexp.exe.path);
 
-		srcexp.state.completed      = 0.0f;
-		srcexp.state.bank_completed = 0.0f;
+		perf_timer_t perf(perf_stage_t::read);
+
+		UnloadGame(srcexp);
+
+		srcexp.state.compat     = srcexp.force_compat;
+		srcexp.state.lazy_banks = srcexp.lazy_load;
+		srcexp.state.decode_cache->set_budget(srcexp.decode_cache_budget);
+		srcexp.state.arena->set_budget(srcexp.memory_budget);
+
+		// Games that are too large to map in one piece (i.e. on 32 bit builds)
+		// are paged in one window at a time instead of being read into memory.
+		if (!srcexp.windowed_load)
+		{
+			if (auto mapping = mapped_file_t::open(srcexp.exe.path);
+			    mapping.is_ok())
+				srcexp.state.file =
+				  make_data_ref_ptr(mapping.unsafe_unwrap(), srcexp.state.arena);
+		}
+
+		if (!srcexp.state.file)
+		{
+			if (auto windowed = windowed_file_t::open(srcexp.exe.path);
+			    windowed.is_ok())
+			{
+				DEBUG("Loading Game In Windows");
+				srcexp.state.windowed_file = windowed.unsafe_unwrap();
+			}
+			else
+			{
+				RES_TRY_ASSIGN(srcexp.state.file =,
+				               OpenFile(srcexp.exe.path, srcexp.state.arena)
+				                 .MAP_SE_ERR("LoadGame"));
+			}
+		}
+
+		auto advise = [&](access_hint_t hint)
+		{
+			if (srcexp.state.file) srcexp.state.file->advise(hint);
+		};
+
+		// The PE and game headers and the pack data are read front to back.
+		advise(access_hint_t::sequential);
+
+		const auto index_path = chunk_index_t::path_for(srcexp.exe.path);
+		if (srcexp.cache_index && !srcexp.state.file)
+		{
+			DEBUG("Chunk Index Is Not Used For Windowed Games");
+		}
+		else if (srcexp.cache_index)
+		{
+			std::error_code err;
+			const auto write_time = fs::last_write_time(srcexp.exe.path, err);
 
-		srcexp.state        = game_t{};
-		srcexp.state.compat = force_compat;
+			auto &index     = srcexp.state.index;
+			index.file_size = srcexp.state.file->size();
+			index.file_time =
+			  err ? 0 : uint64_t(write_time.time_since_epoch().count());
+			index.file_hash =
+			  chunk_index_t::sample_hash(srcexp.state.file->get());
+			index.compat = srcexp.state.compat;
 
-		RES_TRY_ASSIGN(auto bytes =,
-		               lak::read_file(srcexp.exe.path).MAP_ERR("LoadGame"));
+			srcexp.state.index_loaded = index.load(index_path);
+			srcexp.state.build_index  = !srcexp.state.index_loaded;
 
-		srcexp.state.file = make_data_ref_ptr(lak::move(bytes));
+			DEBUG("File Hash: ", index.file_hash);
+			DEBUG("Index Loaded: ", srcexp.state.index_loaded);
+		}
 
-		data_reader_t strm(srcexp.state.file);
+		data_reader_t strm =
+		  srcexp.state.file
+		    ? data_reader_t(srcexp.state.file)
+		    : data_reader_t(srcexp.state.windowed_file, srcexp.state.arena);
+		TRY(strm.seek(0x0));
 
-		DEBUG("File Size: ", srcexp.state.file->size());
+		DEBUG("File Size: ", strm.size());
 
 		if (auto err = ParsePEHeader(strm).MAP_SE_ERR(
 		      "LoadGame: while parsing PE header at: ", strm.position());
@@ -94,25 +315,23 @@ namespace SourceExplorer
 
 		DEBUG("Successfully Parsed Game Header");
 
-		_magic_key.clear();
+		SetDecryptionMode(srcexp.state);
 
-		if (srcexp.state.product_build < 284 || srcexp.state.old_game ||
-		    srcexp.state.compat)
-			_mode = game_mode_t::_OLD;
-		else if (srcexp.state.product_build > 284)
-			_mode = game_mode_t::_288;
-		else
-			_mode = game_mode_t::_284;
-
-		if (_mode == game_mode_t::_OLD)
-			_magic_char = 99; // '6';
-		else
-			_magic_char = 54; // 'c';
+		// Old games have to inflate every item to find where it ends, so the
+		// whole file gets read in order. Newer games store the size of each
+		// item and only touch the pages holding chunk headers.
+		advise(srcexp.state.old_game ? access_hint_t::sequential
+		                             : access_hint_t::random);
 
 		RES_TRY(srcexp.state.game.read(srcexp.state, strm)
 		          .MAP_SE_ERR("LoadGame: while parsing PE header at: ",
 		                      strm.position()));
 
+		perf.add(strm.size(), 0);
+
+		// From here on the file is browsed in no particular order.
+		advise(access_hint_t::random);
+
 		DEBUG("Successfully Read Game Entry");
 
 		DEBUG("Unicode: ", (srcexp.state.unicode ? "true" : "false"));
@@ -151,39 +370,81 @@ namespace SourceExplorer
 			}
 		}
 
+		if (srcexp.state.build_index)
+		{
+			auto &index = srcexp.state.index;
+
+			if (srcexp.state.game.image_bank)
+			{
+				for (const auto &image : srcexp.state.game.image_bank->items)
+				{
+					if (!image.header_loaded) continue;
+					auto it = index.items.find(image.entry.ref_span.index_key());
+					if (it == index.items.end()) continue;
+					it->second.has_image = true;
+					it->second.image     = image.record();
+				}
+			}
+
+			if (index.save(index_path)) DEBUG("Saved Index To ", index_path);
+
+			srcexp.state.build_index = false;
+		}
+
 		return lak::ok_t{};
 	}
 
+	void SetDecryptionMode(game_t &game_state)
+	{
+		auto &decryption = *game_state.decryption;
+
+		if (game_state.product_build < 284 || game_state.old_game ||
+		    game_state.compat)
+			decryption.mode = game_mode_t::_OLD;
+		else if (game_state.product_build > 284)
+			decryption.mode = game_mode_t::_288;
+		else
+			decryption.mode = game_mode_t::_284;
+
+		if (decryption.mode == game_mode_t::_OLD)
+			decryption.magic_char = 99; // '6';
+		else
+			decryption.magic_char = 54; // 'c';
+	}
+
 	void GetEncryptionKey(game_t &game_state)
 	{
-		_magic_key.clear();
-		_magic_key.reserve(256);
+		auto &decryption = *game_state.decryption;
+		auto &magic_key  = decryption.magic_key;
 
-		if (_mode == game_mode_t::_284)
+		magic_key.clear();
+		magic_key.reserve(256);
+
+		if (decryption.mode == game_mode_t::_284)
 		{
 			if (game_state.game.project_path)
-				_magic_key += KeyString(game_state.game.project_path->value);
-			if (_magic_key.size() < 0x80 && game_state.game.title)
-				_magic_key += KeyString(game_state.game.title->value);
-			if (_magic_key.size() < 0x80 && game_state.game.copyright)
-				_magic_key += KeyString(game_state.game.copyright->value);
+				magic_key += KeyString(game_state.game.project_path->value);
+			if (magic_key.size() < 0x80 && game_state.game.title)
+				magic_key += KeyString(game_state.game.title->value);
+			if (magic_key.size() < 0x80 && game_state.game.copyright)
+				magic_key += KeyString(game_state.game.copyright->value);
 		}
 		else
 		{
 			if (game_state.game.title)
-				_magic_key += KeyString(game_state.game.title->value);
-			if (_magic_key.size() < 0x80 && game_state.game.copyright)
-				_magic_key += KeyString(game_state.game.copyright->value);
-			if (_magic_key.size() < 0x80 && game_state.game.project_path)
-				_magic_key += KeyString(game_state.game.project_path->value);
+				magic_key += KeyString(game_state.game.title->value);
+			if (magic_key.size() < 0x80 && game_state.game.copyright)
+				magic_key += KeyString(game_state.game.copyright->value);
+			if (magic_key.size() < 0x80 && game_state.game.project_path)
+				magic_key += KeyString(game_state.game.project_path->value);
 		}
-		_magic_key.resize(0x100);
-		std::memset(_magic_key.data() + 0x80, 0, 0x80);
+		magic_key.resize(0x100);
+		std::memset(magic_key.data() + 0x80, 0, 0x80);
 
-		uint8_t *key_ptr = _magic_key.data();
+		uint8_t *key_ptr = magic_key.data();
 		size_t len       = strlen((char *)key_ptr);
-		uint8_t accum    = _magic_char;
-		uint8_t hash     = _magic_char;
+		uint8_t accum    = decryption.magic_char;
+		uint8_t hash     = decryption.magic_char;
 		for (size_t i = 0; i <= len; ++i)
 		{
 			hash = (hash << 7) + (hash >> 1);
@@ -193,19 +454,70 @@ namespace SourceExplorer
 		}
 		*key_ptr = accum;
 
-		decryptor.valid = false;
+		// Built now rather than on first use, so decrypting never writes to
+		// the game's decryption state. Only the loader and the Crypto panel
+		// rebuild it, and the panel waits until nothing else is decoding.
+		decryption.table.valid = false;
+		decryption.table.init(lak::span(magic_key).first<0x100>(),
+		                      decryption.magic_char);
+
+		// Anything decrypted with the old key is stale now, the cache keys
+		// don't include the key.
+		game_state.decode_cache->clear();
+	}
+
+	std::optional<encryption_stream> decryption_t::stream() const
+	{
+		if (!table.valid) return std::nullopt;
+		return encryption_stream(table);
+	}
+
+	uint8_t ChunkIDXor(const decryption_t &decryption, chunk_t ID)
+	{
+		return ((decryption.mode != game_mode_t::_284) &&
+		        ((uint16_t)ID & 0x1) != 0)
+		         ? uint8_t(((uint16_t)ID & 0xFF) ^ ((uint16_t)ID >> 0x8))
+		         : 0;
 	}
 
-	bool DecodeChunk(lak::span<byte_t> chunk)
+	// Decrypt the next src.size() bytes of a chunk into dst. id_xor is the
+	// extra obfuscation some chunks have on their first byte, 0 for none.
+	static void DecryptChunk(encryption_stream &stream,
+	                         lak::span<const byte_t> src,
+	                         lak::span<byte_t> dst,
+	                         uint8_t id_xor)
 	{
-		if (!decryptor.valid)
+		if (src.empty()) return;
+		const byte_t first = byte_t(uint8_t(src[0]) ^ id_xor);
+		stream.decode(lak::span<const byte_t>(&first, 1), dst.first(1));
+		stream.decode(src.subspan(1), dst.subspan(1));
+	}
+
+	// Hands a MODE3 chunk to FastInflate a block at a time, decrypting each
+	// block as it goes.
+	struct decrypt_source_t final : inflate_source_t
+	{
+		encryption_stream stream;
+		lak::span<const byte_t> encrypted;
+		uint8_t id_xor;
+
+		decrypt_source_t(const encryption_stream &s,
+		                 lak::span<const byte_t> e,
+		                 uint8_t x)
+		: stream(s), encrypted(e), id_xor(x)
 		{
-			if (!decryptor.init(lak::span(_magic_key).first<0x100>(), _magic_char))
-				return false;
 		}
 
-		return decryptor.decode(chunk);
-	}
+		size_t read(lak::span<byte_t> buffer) override
+		{
+			const size_t size = std::min(buffer.size(), encrypted.size());
+			DecryptChunk(
+			  stream, encrypted.first(size), buffer.first(size), id_xor);
+			encrypted = encrypted.subspan(size);
+			id_xor    = 0;
+			return size;
+		}
+	};
 
 	error_t ParsePEHeader(data_reader_t &strm)
 	{
@@ -512,6 +824,8 @@ namespace SourceExplorer
 				  array.begin(), array.end());
 			};
 
+			TRY(strm.ensure(unicode ? read * 2 : read));
+
 			if (unicode)
 			{
 				TRY_ASSIGN(game_state.pack_files[i].filename =,
@@ -547,7 +861,7 @@ namespace SourceExplorer
 			TRY_ASSIGN(read =, strm.read_u32());
 
 			DEBUG("Pack File Data Size: ", read, ", Pos: ", strm.position());
-			TRY_ASSIGN(game_state.pack_files[i].data =, strm.read<byte_t>(read));
+			TRY_ASSIGN(game_state.pack_files[i].data =, strm.read_lazy_span(read));
 		}
 
 		TRY_ASSIGN(header =, strm.peek_u32()); // PAMU sometimes
@@ -1116,6 +1430,25 @@ namespace SourceExplorer
 
 	void ViewImage(source_explorer_t &srcexp, const float scale)
 	{
+		if (srcexp.pending_image.valid())
+		{
+			if (!srcexp.pending_image.ready())
+			{
+				ImGui::Text("Decoding image...");
+				return;
+			}
+
+			if (const auto &decoded = srcexp.pending_image.get();
+			    !decoded || decoded->is_err())
+				ERROR("Failed To Read Image Data: ",
+				      decoded ? lak::streamify(decoded->unsafe_unwrap_err())
+				              : lak::streamify("image decode threw"));
+			else
+				srcexp.image =
+				  CreateTexture(decoded->unsafe_unwrap(), srcexp.graphics_mode);
+			srcexp.pending_image = {};
+		}
+
 		// :TODO: Select palette
 		if (std::holds_alternative<lak::opengl::texture>(srcexp.image))
 		{
@@ -1313,89 +1646,139 @@ namespace SourceExplorer
 		}
 	}
 
-	result_t<data_ref_span_t> Decode(data_ref_span_t encoded,
+	result_t<data_ref_span_t> Decode(const decryption_t &decryption,
+	                                 data_ref_span_t encoded,
 	                                 chunk_t id,
-	                                 encoding_t mode)
+	                                 encoding_t mode,
+	                                 size_t size_hint)
 	{
 		FUNCTION_CHECKPOINT();
 
 		switch (mode)
 		{
 			case encoding_t::mode3:
-			case encoding_t::mode2: return Decrypt(encoded, id, mode);
+			case encoding_t::mode2: return Decrypt(decryption, encoded, id, mode);
 			case encoding_t::mode1:
-				return lak::ok_t{
-				  lak::ok_or_err(Inflate(encoded, false, false)
-				                   .map_err([&](auto &&) { return encoded; }))};
+				return lak::ok_t{lak::ok_or_err(
+				  Inflate(encoded, false, false, SIZE_MAX, size_hint)
+				    .map_err([&](auto &&) { return encoded; }))};
 			default:
 				if (encoded.size() > 0 && uint8_t(encoded[0]) == 0x78)
-					return lak::ok_t{
-					  lak::ok_or_err(Inflate(encoded, false, false)
-					                   .map_err([&](auto &&) { return encoded; }))};
+					return lak::ok_t{lak::ok_or_err(
+					  Inflate(encoded, false, false, SIZE_MAX, size_hint)
+					    .map_err([&](auto &&) { return encoded; }))};
 				else
 					return lak::ok_t{encoded};
 		}
 	}
 
+	// DEFLATE can't expand data by more than ~1032:1, anything above that is
+	// a corrupt size field and shouldn't be trusted with an allocation.
+	static size_t ClampSizeHint(size_t size_hint, size_t compressed_size)
+	{
+		return std::min(size_hint, compressed_size * 1032 + 0x100);
+	}
+
+	// Decoding gives up as soon as the game's arena goes over its budget,
+	// rather than the game being abandoned only after it has all been decoded.
+	static error_t CheckBudget(const arena_buffer_t &buffer)
+	{
+		if (buffer.arena()->over_budget())
+			return lak::err_t{error(LINE_TRACE, error::over_budget)};
+		return lak::ok_t{};
+	}
+
 	result_t<data_ref_span_t> Inflate(data_ref_span_t compressed,
 	                                  bool skip_header,
 	                                  bool anaconda,
-	                                  size_t max_size)
+	                                  size_t max_size,
+	                                  size_t size_hint)
 	{
 		FUNCTION_CHECKPOINT();
 
-		lak::array<byte_t, 0x8000> buffer;
-		auto inflater =
-		  lak::deflate_iterator(compressed, buffer, !skip_header, anaconda);
-
-		lak::array<byte_t> output;
-		output.reserve(buffer.size());
-		if (auto err = inflater.read(
-		      [&](lak::span<byte_t> v)
-		      {
-			      bool hit_max = output.size() + v.size() > max_size;
-			      if (hit_max) v = v.first(max_size - output.size());
-			      output.reserve(output.size() + v.size());
-			      for (const byte_t &b : v) output.push_back(b);
-			      if (hit_max) DEBUG("Hit Max");
-			      return !hit_max;
-		      });
-		    err.is_ok())
-		{
-			return lak::ok_t{make_data_ref_ptr(compressed, lak::move(output))};
-		}
-// #ifndef NDEBUG
-#if 0
-		else if (err.unsafe_unwrap_err() ==
-		         lak::deflate_iterator::error_t::corrupt_stream)
-		{
-			auto [bytes_read, bits_read] = inflater.bytes_read();
-			ERROR("Corrupt Stream. Bytes Read: ",
-			      bytes_read,
-			      ", Bits Read: ",
-			      bits_read);
-			return lak::ok_t{make_data_ref_ptr(compressed, lak::move(output))};
-		}
-#endif
-		else if (err.unsafe_unwrap_err() == lak::deflate_iterator::error_t::ok)
-		{
-			// This is not (always) an error, we may intentionally stop the decode
-			// early to not waste time and memory.
+		perf_timer_t perf(perf_stage_t::inflate);
 
-			CHECKPOINT();
-			return lak::ok_t{make_data_ref_ptr(compressed, lak::move(output))};
-		}
-		else
+		// With a (correct) size hint this is the only allocation.
+		auto output = make_decode_buffer(compressed);
+		size_hint =
+		  std::min(ClampSizeHint(size_hint, compressed.size()), max_size);
+		if (size_hint > 0) output.reserve(size_hint);
+		RES_TRY(CheckBudget(output));
+
+		const auto backend = inflate_backend.load(std::memory_order_relaxed);
+		if (auto err =
+		      GetInflater(backend, anaconda)
+		        .inflate(compressed, output, !skip_header, anaconda, max_size);
+		    err.is_err())
 		{
 			DEBUG("Max Size: ", max_size);
-			DEBUG("Final? ", (inflater.is_final_block() ? "True" : "False"));
 			return lak::err_t{
 			  error(LINE_TRACE,
 			        error::inflate_failed,
 			        "Failed To Inflate (",
-			        lak::deflate_iterator::error_name(err.unsafe_unwrap_err()),
+			        inflate_error_name(err.unsafe_unwrap_err()),
 			        ")")};
 		}
+		RES_TRY(CheckBudget(output));
+
+		perf.add(output.size());
+		return lak::ok_t{make_data_ref_ptr(compressed, lak::move(output))};
+	}
+
+	// Inflate a zlib stream up to max_size bytes, continuing from (and/or
+	// leaving behind) a paused decode of the same stream in cache.
+	static result_t<data_ref_span_t> ResumableInflate(
+	  decode_cache_t &cache,
+	  const data_ref_span_t &compressed,
+	  size_t max_size,
+	  size_t size_hint)
+	{
+		FUNCTION_CHECKPOINT();
+
+		const auto key = decode_cache_t::make_partial_key(compressed, false);
+
+		perf_timer_t perf(perf_stage_t::inflate);
+
+		auto partial = cache.take_partial(key);
+		if (!partial)
+			partial = std::make_shared<partial_inflate_t>(
+			  true, make_decode_buffer(compressed).arena());
+		const size_t resumed_at = partial->output.size();
+
+		// Only allocate the whole output once it's actually wanted.
+		if (max_size == SIZE_MAX)
+			partial->output.reserve(ClampSizeHint(size_hint, compressed.size()));
+		RES_TRY(CheckBudget(partial->output));
+
+		if (auto err =
+		      FastInflate(partial->state, compressed, partial->output, max_size);
+		    err.is_err())
+			return lak::err_t{
+			  error(LINE_TRACE,
+			        error::inflate_failed,
+			        "Failed To Inflate (",
+			        inflate_error_name(err.unsafe_unwrap_err()),
+			        ")")};
+		RES_TRY(CheckBudget(partial->output));
+
+		// Only count the stream as an item once it has been inflated fully.
+		perf.add(partial->output.size() - resumed_at,
+		         partial->state.done() ? 1 : 0);
+
+		if (partial->state.done())
+		{
+			partial->output.resize(std::min(partial->output.size(), max_size));
+			return lak::ok_t{
+			  make_data_ref_ptr(compressed, lak::move(partial->output))};
+		}
+
+		// Stopped early, hand out a copy of the part that was asked for and
+		// keep the decoder (and its output) to continue from next time.
+		auto prefix = make_decode_buffer(compressed);
+		prefix.append(partial->output.span().first(
+		  std::min(partial->output.size(), max_size)));
+		cache.insert_partial(key, compressed, lak::move(partial));
+		return lak::ok_t{make_data_ref_ptr(compressed, lak::move(prefix))};
 	}
 
 	result_t<data_ref_span_t> LZ4Decode(data_ref_span_t compressed,
@@ -1403,6 +1786,8 @@ namespace SourceExplorer
 	{
 		FUNCTION_CHECKPOINT();
 
+		perf_timer_t perf(perf_stage_t::lz4);
+
 		lak::binary_reader reader(compressed);
 
 		return lak::decode_lz4_block(reader, out_size)
@@ -1410,6 +1795,7 @@ namespace SourceExplorer
 		  .map(
 		    [&](auto &&decompressed)
 		    {
+			    perf.add(decompressed.size());
 			    return data_ref_span_t(
 			      make_data_ref_ptr(compressed, lak::move(decompressed)));
 		    })
@@ -1430,44 +1816,43 @@ namespace SourceExplorer
 	{
 		FUNCTION_CHECKPOINT();
 
-		lak::array<byte_t, 0x8000> buffer;
-		auto inflater = lak::deflate_iterator(strm.remaining(),
-		                                      buffer,
-		                                      /* parse_header */ false,
-		                                      /* anaconda */ true);
-
-		lak::array<byte_t> output;
-		if (auto err = inflater.read(
-		      [&](lak::span<byte_t> v)
-		      {
-			      output.reserve(output.size() + v.size());
-			      for (const byte_t &b : v) output.push_back(b);
-			      return true;
-		      });
-		    err.is_ok())
-		{
-			const auto offset = strm.position();
-			const auto bytes_read =
-			  inflater.compressed().begin() - strm.remaining().begin();
-			ASSERT_GREATER_OR_EQUAL(bytes_read, 0);
-			strm.skip(bytes_read).UNWRAP();
-			return lak::ok_t{make_data_ref_ptr(
-			  strm._source, offset, bytes_read, lak::move(output))};
-		}
-		else
+		perf_timer_t perf(perf_stage_t::inflate);
+
+		auto output = make_decode_buffer(data_ref_span_t(strm._source));
+		const size_t size_hint =
+		  ClampSizeHint(out_size, strm.remaining().size());
+		if (size_hint > 0) output.reserve(size_hint);
+		RES_TRY(CheckBudget(output));
+
+		const auto backend = inflate_backend.load(std::memory_order_relaxed);
+		auto consumed =
+		  GetInflater(backend, /* anaconda */ true)
+		    .inflate(strm.remaining(),
+		             output,
+		             /* parse_header */ false,
+		             /* anaconda */ true);
+		if (consumed.is_err())
 		{
 			DEBUG("Out Size: ", out_size);
-			DEBUG("Final? ", (inflater.is_final_block() ? "True" : "False"));
 			return lak::err_t{
 			  error(LINE_TRACE,
 			        error::inflate_failed,
 			        "Failed To Inflate (",
-			        lak::deflate_iterator::error_name(err.unsafe_unwrap_err()),
+			        inflate_error_name(consumed.unsafe_unwrap_err()),
 			        ")")};
 		}
+		RES_TRY(CheckBudget(output));
+
+		const size_t offset = strm.remaining().data() - strm._source->data();
+		const size_t bytes_read = consumed.unsafe_unwrap();
+		strm.skip(bytes_read).UNWRAP();
+		perf.add(output.size());
+		return lak::ok_t{make_data_ref_ptr(
+		  strm._source, offset, bytes_read, lak::move(output))};
 	}
 
-	result_t<data_ref_span_t> Decrypt(data_ref_span_t encrypted,
+	result_t<data_ref_span_t> Decrypt(const decryption_t &decryption,
+	                                  data_ref_span_t encrypted,
 	                                  chunk_t ID,
 	                                  encoding_t mode)
 	{
@@ -1475,6 +1860,8 @@ namespace SourceExplorer
 
 		data_reader_t estrm(encrypted);
 
+		const uint8_t id_xor = ChunkIDXor(decryption, ID);
+
 		if (mode == encoding_t::mode3)
 		{
 			if (encrypted.size() <= 4)
@@ -1486,36 +1873,71 @@ namespace SourceExplorer
 			// size_t dataLen = *reinterpret_cast<const uint32_t*>(&encrypted[0]);
 			TRY(estrm.skip(4));
 
-			auto mem_ptr  = estrm.copy_remaining();
-			auto mem_span = lak::span<byte_t>(mem_ptr->get());
+			auto body   = estrm.read_remaining_ref_span();
+			auto stream = decryption.stream();
+			if (!stream)
+				return lak::err_t{error(
+				  LINE_TRACE, error::decrypt_failed, "MODE 3 Decryption Failed")};
 
-			data_reader_t mem_reader(mem_ptr);
+			if (body.size() <= 4)
+				return lak::err_t{
+				  error(LINE_TRACE,
+				        error::decrypt_failed,
+				        "MODE 3 Decryption Failed: Decoded Chunk Too Small")};
 
-			if ((_mode != game_mode_t::_284) && ((uint16_t)ID & 0x1) != 0)
-				(uint8_t &)(mem_span[0]) ^=
-				  ((uint16_t)ID & 0xFF) ^ ((uint16_t)ID >> 0x8);
+			// Read once, the fallback below has to agree with what was tried.
+			const auto backend = inflate_backend.load(std::memory_order_relaxed);
 
-			if (DecodeChunk(mem_span))
+			if (backend == inflate_backend_t::fast)
 			{
-				if (mem_reader.remaining().size() <= 4)
-					return lak::err_t{
-					  error(LINE_TRACE,
-					        error::decrypt_failed,
-					        "MODE 3 Decryption Failed: Decoded Chunk Too Small")};
+				// Decrypt straight into the inflater, the decrypted chunk is never
+				// held in memory all at once.
+				perf_timer_t perf(perf_stage_t::decrypt);
+				decrypt_source_t source(*stream, body, id_xor);
 				// dataLen = *reinterpret_cast<uint32_t*>(&mem[0]);
+				byte_t data_len[4];
+				source.read(data_len);
+				const size_t size_hint = ClampSizeHint(
+				  size_t(uint8_t(data_len[0])) |
+				    (size_t(uint8_t(data_len[1])) << 8) |
+				    (size_t(uint8_t(data_len[2])) << 16) |
+				    (size_t(uint8_t(data_len[3])) << 24),
+				  body.size());
+
+				auto output = make_decode_buffer(body);
+				if (size_hint > 0) output.reserve(size_hint);
+				if (FastInflate(source, output, true).is_ok())
+				{
+					perf.add(body.size());
+					// The time is all counted as decrypt, see perf_stage_t.
+					perf_counters.add(perf_stage_t::inflate, output.size(), 1);
+					return lak::ok_t{make_data_ref_ptr(body, lak::move(output))};
+				}
+			}
 
-				TRY(mem_reader.skip(4));
+			auto decrypted = make_decode_buffer(body);
+			decrypted.resize(body.size());
+			{
+				perf_timer_t perf(perf_stage_t::decrypt);
+				DecryptChunk(*stream, body, decrypted.span(), id_xor);
+				perf.add(body.size());
+			}
+			auto mem_ptr = make_data_ref_ptr(body, lak::move(decrypted));
 
-				auto rem_span = mem_reader.read_remaining_ref_span();
+			data_reader_t mem_reader(mem_ptr);
+			TRY(mem_reader.skip(4));
 
-				// Try Inflate even if it doesn't need to be
-				return lak::ok_t{lak::ok_or_err(
-				  Inflate(rem_span, false, false)
-				    .map_err([&](auto &&) { return rem_span; })
-				    .if_err([](auto ref_span) { DEBUG("Size: ", ref_span.size()); }))};
-			}
-			return lak::err_t{
-			  error(LINE_TRACE, error::decrypt_failed, "MODE 3 Decryption Failed")};
+			auto rem_span = mem_reader.read_remaining_ref_span();
+
+			// The fused path has already found this isn't compressed.
+			if (backend == inflate_backend_t::fast)
+				return lak::ok_t{rem_span};
+
+			// Try Inflate even if it doesn't need to be
+			return lak::ok_t{lak::ok_or_err(
+			  Inflate(rem_span, false, false)
+			    .map_err([&](auto &&) { return rem_span; })
+			    .if_err([](auto ref_span) { DEBUG("Size: ", ref_span.size()); }))};
 		}
 		else
 		{
@@ -1525,23 +1947,21 @@ namespace SourceExplorer
 				        error::decrypt_failed,
 				        "MODE 2 Decryption Failed: Encrypted Buffer Too Small")};
 
-			auto mem_ptr  = estrm.copy_remaining();
-			auto mem_span = lak::span<byte_t>(mem_ptr->get());
-
-			if ((_mode != game_mode_t::_284) && (uint16_t)ID & 0x1)
-				(uint8_t &)(mem_span[0]) ^=
-				  ((uint16_t)ID & 0xFF) ^ ((uint16_t)ID >> 0x8);
+			auto stream = decryption.stream();
+			if (!stream)
+				return lak::err_t{error(
+				  LINE_TRACE, error::decrypt_failed, "MODE 2 Decryption Failed")};
 
-			if (!DecodeChunk(mem_span))
+			// Decrypt while copying instead of copying and then decrypting.
+			auto decrypted = make_decode_buffer(encrypted);
+			decrypted.resize(encrypted.size());
 			{
-				if (mode == encoding_t::mode2)
-				{
-					return lak::err_t{error(
-					  LINE_TRACE, error::decrypt_failed, "MODE 2 Decryption Failed")};
-				}
+				perf_timer_t perf(perf_stage_t::decrypt);
+				DecryptChunk(*stream, encrypted, decrypted.span(), id_xor);
+				perf.add(encrypted.size());
 			}
 
-			return lak::ok_t{mem_ptr};
+			return lak::ok_t{make_data_ref_ptr(encrypted, lak::move(decrypted))};
 		}
 	}
 
@@ -1594,24 +2014,161 @@ namespace SourceExplorer
 		if (iter->second >= game.game.image_bank->items.size())
 			return lak::err_t{error(LINE_TRACE, u8"Image Bank Handle Out Of Range")};
 
-		return lak::ok_t{game.game.image_bank->items[iter->second]};
+		auto &item = game.game.image_bank->items[iter->second];
+
+		RES_TRY(item.load_header().MAP_SE_ERR("GetImage"));
+
+		return lak::ok_t{item};
+	}
+
+	std::optional<data_ref_span_t> decode_cache_t::find(const key_t &key)
+	{
+		std::lock_guard lock(_mutex);
+
+		auto it = _entries.find(key);
+		if (it == _entries.end() && key.max_size != SIZE_MAX)
+		{
+			// A size limited decode is just the start of the full one.
+			key_t full_key    = key;
+			full_key.max_size = SIZE_MAX;
+			if (it = _entries.find(full_key); it != _entries.end())
+			{
+				++_hits;
+				_lru.splice(_lru.begin(), _lru, it->second);
+				const auto &result = it->second->result;
+				return data_ref_span_t(result._source,
+				                       result.data() - result._source->data(),
+				                       std::min(result.size(), key.max_size));
+			}
+		}
+
+		if (it == _entries.end())
+		{
+			++_misses;
+			return std::nullopt;
+		}
+
+		++_hits;
+		_lru.splice(_lru.begin(), _lru, it->second);
+		return it->second->result;
+	}
+
+	void decode_cache_t::insert(const key_t &key,
+	                            const data_ref_span_t &raw,
+	                            const data_ref_span_t &result)
+	{
+		// Results that are just a view of the raw data (MODE0, uncompressed old
+		// items) cost nothing to recompute and hold no memory of their own.
+		if (!result._source || result._source == raw._source ||
+		    result.in_window())
+			return;
+
+		insert_entry(entry_t{key,
+		                     raw.in_window() ? data_ref_span_t{} : raw,
+		                     result,
+		                     {},
+		                     result.size()});
 	}
 
-	result_t<data_ref_span_t> data_point_t::decode(const chunk_t ID,
-	                                               const encoding_t mode) const
+	void decode_cache_t::insert_partial(
+	  const key_t &key,
+	  const data_ref_span_t &raw,
+	  std::shared_ptr<partial_inflate_t> partial)
 	{
-		return Decode(data, ID, mode);
+		const size_t bytes = partial->output.capacity() + sizeof(*partial);
+		insert_entry(entry_t{key,
+		                     raw.in_window() ? data_ref_span_t{} : raw,
+		                     {},
+		                     lak::move(partial),
+		                     bytes});
+	}
+
+	std::shared_ptr<partial_inflate_t> decode_cache_t::take_partial(
+	  const key_t &key)
+	{
+		std::lock_guard lock(_mutex);
+
+		auto it = _entries.find(key);
+		if (it == _entries.end()) return {};
+
+		auto result = lak::move(it->second->partial);
+		_bytes -= it->second->bytes;
+		_lru.erase(it->second);
+		_entries.erase(it);
+		return result;
+	}
+
+	void decode_cache_t::insert_entry(entry_t entry)
+	{
+		std::lock_guard lock(_mutex);
+
+		if (entry.bytes > _budget || _entries.contains(entry.key)) return;
+
+		_bytes += entry.bytes;
+		_lru.push_front(lak::move(entry));
+		_entries.emplace(_lru.front().key, _lru.begin());
+
+		evict();
+	}
+
+	void decode_cache_t::set_budget(size_t budget)
+	{
+		std::lock_guard lock(_mutex);
+		_budget = budget;
+		evict();
+	}
+
+	void decode_cache_t::clear()
+	{
+		std::lock_guard lock(_mutex);
+		_entries.clear();
+		_lru.clear();
+		_bytes = 0;
+	}
+
+	decode_cache_t::stats_t decode_cache_t::stats() const
+	{
+		std::lock_guard lock(_mutex);
+		return {_hits, _misses, _evictions, _entries.size(), _bytes, _budget};
+	}
+
+	void decode_cache_t::evict()
+	{
+		while (_bytes > _budget && !_lru.empty())
+		{
+			auto &entry = _lru.back();
+			_bytes -= entry.bytes;
+			_entries.erase(entry.key);
+			_lru.pop_back();
+			++_evictions;
+		}
+	}
+
+	result_t<data_ref_span_t> data_point_t::decode(
+	  const decryption_t &decryption,
+	  const chunk_t ID,
+	  const encoding_t mode) const
+	{
+		return Decode(decryption, data.get(), ID, mode, expected_size);
 	}
 
 	error_t chunk_entry_t::read(game_t &game, data_reader_t &strm)
 	{
 		FUNCTION_CHECKPOINT("chunk_entry_t::");
 
+		perf_counters.add(perf_stage_t::read, 0, 1);
+
+		// Only the header has to be paged in, the body of a windowed chunk is
+		// only mapped once something decodes or reads it (see lazy_span_t).
+		TRY(strm.ensure(16));
+
 		const auto strm_ref_span = strm.peek_remaining_ref_span();
 
 		const auto start = strm.position();
 
-		old = game.old_game;
+		old        = game.old_game;
+		cache      = game.decode_cache;
+		decryption = game.decryption;
 		TRY_ASSIGN(ID = (chunk_t), strm.read_u16());
 		TRY_ASSIGN(mode = (encoding_t), strm.read_u16());
 
@@ -1624,13 +2181,27 @@ namespace SourceExplorer
 		DEBUG("Root Position: ", strm_ref_span.root_position().UNWRAP());
 
 		if ((mode == encoding_t::mode2 || mode == encoding_t::mode3) &&
-		    _magic_key.size() < 256)
+		    game.decryption->magic_key.size() < 256)
 			GetEncryptionKey(game);
 
 		TRY_ASSIGN(const auto chunk_size =, strm.read_u32());
 		const auto chunk_data_end = strm.position() + chunk_size;
 
-		CHECK_REMAINING(strm, chunk_size);
+		// Checked against the whole reader, a windowed reader may not have the
+		// chunk paged in yet.
+		if (const uint64_t remaining = strm.size() - strm.position();
+		    remaining < chunk_size)
+		{
+			ERROR("Out Of Data: ",
+			      remaining,
+			      " Bytes Remaining, Expected ",
+			      chunk_size);
+			return lak::err_t{error(LINE_TRACE,
+			                        error::out_of_data,
+			                        remaining,
+			                        " Bytes Remaining, Expected ",
+			                        chunk_size)};
+		}
 
 		if (mode == encoding_t::mode1)
 		{
@@ -1640,7 +2211,7 @@ namespace SourceExplorer
 			{
 				if (chunk_size > 4)
 				{
-					TRY_ASSIGN(body.data =, strm.read_ref_span(chunk_size - 4));
+					TRY_ASSIGN(body.data =, strm.read_lazy_span(chunk_size - 4));
 				}
 				else
 					body.data.reset();
@@ -1649,7 +2220,7 @@ namespace SourceExplorer
 			{
 				TRY_ASSIGN(const auto data_size =, strm.read_u32());
 
-				TRY_ASSIGN(body.data =, strm.read_ref_span(data_size));
+				TRY_ASSIGN(body.data =, strm.read_lazy_span(data_size));
 
 				if (strm.position() > chunk_data_end)
 				{
@@ -1666,36 +2237,54 @@ namespace SourceExplorer
 		else
 		{
 			body.expected_size = 0;
-			TRY_ASSIGN(body.data =, strm.read_ref_span(chunk_size));
+			TRY_ASSIGN(body.data =, strm.read_lazy_span(chunk_size));
 		}
 
 		const auto size = strm.position() - start;
 		strm.seek(start).UNWRAP();
-		ref_span = strm.read_ref_span(size).UNWRAP();
+		ref_span = strm.read_lazy_span(size).UNWRAP();
 		DEBUG("Ref Span Size: ", ref_span.size());
 
+		if (game.build_index)
+		{
+			game.index.chunks.insert_or_assign(
+			  ref_span.index_key(),
+			  chunk_record_t{static_cast<uint32_t>(ref_span.size()), ID, mode});
+		}
+		else if (game.index_loaded)
+		{
+			auto it = game.index.chunks.find(ref_span.index_key());
+			if (it == game.index.chunks.end() || it->second.ID != ID ||
+			    it->second.mode != mode || it->second.size != ref_span.size())
+			{
+				WARNING("Chunk Does Not Match Index, Ignoring Index");
+				game.index_loaded = false;
+				game.index.clear();
+			}
+		}
+
 		return lak::ok_t{};
 	}
 
 	void chunk_entry_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("Entry Information##%zX", position())
+		LAK_TREE_NODE("Entry Information##%" PRIX64, position())
 		{
 			if (old)
 				ImGui::Text("Old Entry");
 			else
 				ImGui::Text("New Entry");
-			ImGui::Text("Position: 0x%zX", position());
+			ImGui::Text("Position: 0x%" PRIX64, position());
 			ImGui::Text("Size: 0x%zX", ref_span.size());
 
 			ImGui::Text("ID: 0x%zX", (size_t)ID);
 			ImGui::Text("Mode: MODE%zu", (size_t)mode);
 
-			ImGui::Text("Head Position: 0x%zX", head.position());
+			ImGui::Text("Head Position: 0x%" PRIX64, head.position());
 			ImGui::Text("Head Expected Size: 0x%zX", head.expected_size);
 			ImGui::Text("Head Size: 0x%zX", head.data.size());
 
-			ImGui::Text("Body Position: 0x%zX", body.position());
+			ImGui::Text("Body Position: 0x%" PRIX64, body.position());
 			ImGui::Text("Body Expected Size: 0x%zX", body.expected_size);
 			ImGui::Text("Body Size: 0x%zX", body.data.size());
 		}
@@ -1711,12 +2300,18 @@ namespace SourceExplorer
 	{
 		FUNCTION_CHECKPOINT("item_entry_t::");
 
+		perf_counters.add(perf_stage_t::read, 0, 1);
+
 		DEBUG("Compressed: ", compressed);
 		DEBUG("Header Size: ", header_size);
 
+		TRY(strm.ensure(16));
+
 		const auto start = strm.position();
+		const auto key   = strm.peek_remaining_ref_span(0).index_key();
 
-		old  = game.old_game;
+		old   = game.old_game;
+		cache = game.decode_cache;
 		mode = encoding_t::mode0;
 		if (has_handle)
 		{
@@ -1750,20 +2345,33 @@ namespace SourceExplorer
 		DEBUG("Body Expected Size: ", body.expected_size);
 
 		size_t data_size = 0;
-		if (game.old_game)
-		{
-			const size_t old_start = strm.position();
-			// Figure out exactly how long the compressed data is
-			// :TODO: It should be possible to figure this out without
-			// actually decompressing it... surely...
+		data_ref_span_t inflated;
+		if (const item_record_t *cached =
+		      game.index_loaded ? game.index.find_item(key, handle) : nullptr;
+		    game.old_game && cached &&
+		    cached->expected_size == body.expected_size)
+		{
+			data_size = cached->data_size;
+			DEBUG("Data Size (From Index): ", data_size);
+		}
+		else if (game.old_game)
+		{
+			const auto old_start = strm.position();
+			// The only way to find out how long the compressed data is, is to
+			// decompress it. The result is handed to the decode cache below so
+			// decode_body() doesn't have to do it all again.
+			// StreamDecompress reads straight from the current window, so page
+			// in as much as the compressed data could possibly take up.
+			TRY(strm.ensure(size_t(body.expected_size) +
+			                body.expected_size / 0x4000 + 0x100));
 			RES_TRY_ASSIGN(
-			  const auto raw =,
+			  inflated =,
 			  StreamDecompress(strm, static_cast<unsigned int>(body.expected_size))
 			    .MAP_SE_ERR("item_entry_t::read"));
-			if (raw.size() != body.expected_size)
+			if (inflated.size() != body.expected_size)
 			{
 				WARNING("Actual decompressed size (",
-				        raw.size(),
+				        inflated.size(),
 				        ") was not equal to the expected size (",
 				        body.expected_size,
 				        ").");
@@ -1779,38 +2387,62 @@ namespace SourceExplorer
 			DEBUG("Data Size: ", data_size);
 		}
 
-		TRY_ASSIGN(body.data =, strm.read_ref_span(data_size));
-		DEBUG("Data Size: ", body.data.size());
+		TRY_ASSIGN(const auto body_data =, strm.read_ref_span(data_size));
+		body.data = body_data;
+		DEBUG("Data Size: ", body_data.size());
 
 		// hack because one of MMF1.5 or tinf_uncompress is a bitch
 		if (game.old_game) mode = encoding_t::mode1;
 
+		// decode_body() inflates the exact same stream (capped at the expected
+		// size) unless the data starts with an uncompressed header.
+		const bool uncompressed_header =
+		  body_data.size() >= 3 && uint8_t(body_data[0]) == 0x0F &&
+		  (uint8_t(body_data[1]) | (uint8_t(body_data[2]) << 8)) ==
+		    body.expected_size;
+		if (cache && inflated._source && !uncompressed_header &&
+		    inflated.size() <= body.expected_size)
+			cache->insert(
+			  decode_cache_t::make_key(body_data, SIZE_MAX, false),
+			  body_data,
+			  inflated);
+
 		const auto size = strm.position() - start;
 		strm.seek(start).UNWRAP();
 		ref_span = strm.read_ref_span(size).UNWRAP();
 		DEBUG("Ref Span Size: ", ref_span.size());
 
+		if (game.build_index)
+		{
+			item_record_t record;
+			record.handle        = handle;
+			record.mode          = mode;
+			record.data_size     = static_cast<uint32_t>(body.data.size());
+			record.expected_size = static_cast<uint32_t>(body.expected_size);
+			game.index.items.insert_or_assign(key, record);
+		}
+
 		return lak::ok_t{};
 	}
 
 	void item_entry_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("Entry Information##%zX", position())
+		LAK_TREE_NODE("Entry Information##%" PRIX64, position())
 		{
 			if (old)
 				ImGui::Text("Old Entry");
 			else
 				ImGui::Text("New Entry");
-			ImGui::Text("Position: 0x%zX", position());
+			ImGui::Text("Position: 0x%" PRIX64, position());
 			ImGui::Text("Size: 0x%zX", ref_span.size());
 
 			ImGui::Text("Handle: 0x%zX", (size_t)handle);
 
-			ImGui::Text("Head Position: 0x%zX", head.position());
+			ImGui::Text("Head Position: 0x%" PRIX64, head.position());
 			ImGui::Text("Head Expected Size: 0x%zX", head.expected_size);
 			ImGui::Text("Head Size: 0x%zX", head.data.size());
 
-			ImGui::Text("Body Position: 0x%zX", body.position());
+			ImGui::Text("Body Position: 0x%" PRIX64, body.position());
 			ImGui::Text("Body Expected Size: 0x%zX", body.expected_size);
 			ImGui::Text("Body Size: 0x%zX", body.data.size());
 		}
@@ -1822,15 +2454,44 @@ namespace SourceExplorer
 	{
 		FUNCTION_CHECKPOINT("basic_entry_t::");
 
+		if (!cache) return decode_body_uncached(max_size);
+
+		const auto raw = raw_body();
+		const auto key = decode_cache_t::make_key(raw, max_size, false);
+		if (auto cached = cache->find(key); cached) return lak::ok_t{*cached};
+
+		// New games' compressed bodies (i.e. images) are usually decoded
+		// twice, first just far enough to read the header and then in full.
+		// The inflater is paused in between rather than starting over.
+		if (!old && mode == encoding_t::mode1 &&
+		    inflate_backend.load(std::memory_order_relaxed) ==
+		      inflate_backend_t::fast)
+			return ResumableInflate(*cache, raw, max_size, body.expected_size)
+			  .MAP_SE_ERR("MODE1 Failed To Inflate")
+			  .if_ok([&](const data_ref_span_t &result)
+			         { cache->insert(key, raw, result); });
+
+		return decode_body_uncached(max_size).if_ok(
+		  [&](const data_ref_span_t &result)
+		  { cache->insert(key, raw, result); });
+	}
+
+	result_t<data_ref_span_t> basic_entry_t::decode_body_uncached(
+	  size_t max_size) const
+	{
+		FUNCTION_CHECKPOINT("basic_entry_t::");
+
+		const auto data = raw_body();
+
 		if (old)
 		{
 			switch (mode)
 			{
-				case encoding_t::mode0: return lak::ok_t{body.data};
+				case encoding_t::mode0: return lak::ok_t{data};
 
 				case encoding_t::mode1:
 				{
-					data_reader_t reader(body.data);
+					data_reader_t reader(data);
 					TRY_ASSIGN(const uint8_t magic =, reader.read_u8());
 					TRY_ASSIGN(const uint16_t len =, reader.read_u16());
 					if (magic == 0x0F && (size_t)len == body.expected_size)
@@ -1841,10 +2502,11 @@ namespace SourceExplorer
 					}
 					else
 					{
-						return Inflate(body.data,
+						return Inflate(data,
 						               true,
 						               true,
-						               std::min(body.expected_size, max_size))
+						               std::min(body.expected_size, max_size),
+						               body.expected_size)
 						  .MAP_SE_ERR("MODE1 Failed To Inflate")
 						  .if_ok([](const auto &ref_span)
 						         { DEBUG("Size: ", ref_span.size()); });
@@ -1866,7 +2528,7 @@ namespace SourceExplorer
 			{
 				case encoding_t::mode4:
 				{
-					return LZ4DecodeReadSize(body.data)
+					return LZ4DecodeReadSize(data)
 					  .MAP_SE_ERR("LZ4 Decode Failed")
 					  .if_ok([](const auto &ref_span)
 					         { DEBUG("Size: ", ref_span.size()); });
@@ -1875,7 +2537,9 @@ namespace SourceExplorer
 				case encoding_t::mode3: [[fallthrough]];
 				case encoding_t::mode2:
 				{
-					return Decrypt(body.data, ID, mode)
+					if (!decryption)
+						return lak::err_t{error(LINE_TRACE, error::decrypt_failed)};
+					return Decrypt(*decryption, data, ID, mode)
 					  .MAP_SE_ERR("MODE2/3 Failed To Decrypt")
 					  .if_ok([](const auto &ref_span)
 					         { DEBUG("Size: ", ref_span.size()); });
@@ -1883,7 +2547,7 @@ namespace SourceExplorer
 
 				case encoding_t::mode1:
 				{
-					return Inflate(body.data, false, false, max_size)
+					return Inflate(data, false, false, max_size, body.expected_size)
 					  .MAP_SE_ERR("MODE1 Failed To Inflate")
 					  .if_ok([](const auto &ref_span)
 					         { DEBUG("Size: ", ref_span.size()); });
@@ -1892,10 +2556,10 @@ namespace SourceExplorer
 				case encoding_t::mode0: [[fallthrough]];
 				default:
 				{
-					if (body.data.size() > 0 && uint8_t(body.data[0]) == 0x78)
+					if (data.size() > 0 && uint8_t(data[0]) == 0x78)
 					{
 						return lak::ok_t{lak::ok_or_err(
-						  Inflate(body.data, false, false, max_size)
+						  Inflate(data, false, false, max_size, body.expected_size)
 						    .if_ok(
 						      [](const auto &ref_span)
 						      {
@@ -1904,16 +2568,16 @@ namespace SourceExplorer
 							      DEBUG("Size: ", ref_span.size());
 						      })
 						    .map_err(
-						      [this](const auto &err)
+						      [&](const auto &err)
 						      {
 							      WARNING("Guess MODE1 Failed To Inflate: ", err);
-							      DEBUG("Size: ", body.data.size());
-							      return body.data;
+							      DEBUG("Size: ", data.size());
+							      return data;
 						      }))};
 					}
 					else
 					{
-						return lak::ok_t{body.data};
+						return lak::ok_t{data};
 					}
 				}
 			}
@@ -1924,6 +2588,24 @@ namespace SourceExplorer
 	{
 		FUNCTION_CHECKPOINT("basic_entry_t::");
 
+		if (!cache) return decode_head_uncached(max_size);
+
+		const auto raw = raw_head();
+		const auto key = decode_cache_t::make_key(raw, max_size, true);
+		if (auto cached = cache->find(key); cached) return lak::ok_t{*cached};
+
+		return decode_head_uncached(max_size).if_ok(
+		  [&](const data_ref_span_t &result)
+		  { cache->insert(key, raw, result); });
+	}
+
+	result_t<data_ref_span_t> basic_entry_t::decode_head_uncached(
+	  size_t max_size) const
+	{
+		FUNCTION_CHECKPOINT("basic_entry_t::");
+
+		const auto data = raw_head();
+
 		if (old)
 		{
 			switch (mode)
@@ -1948,7 +2630,9 @@ namespace SourceExplorer
 				{
 					// :TODO: this was originally body not head, check that this change
 					// is correct.
-					return Decrypt(head.data, ID, mode)
+					if (!decryption)
+						return lak::err_t{error(LINE_TRACE, error::decrypt_failed)};
+					return Decrypt(*decryption, data, ID, mode)
 					  .MAP_SE_ERR("MODE2/3 Failed To Decrypt")
 					  .if_ok([](const auto &ref_span)
 					         { DEBUG("Size: ", ref_span.size()); });
@@ -1956,7 +2640,7 @@ namespace SourceExplorer
 
 				case encoding_t::mode1:
 				{
-					return Inflate(head.data, false, false, max_size)
+					return Inflate(data, false, false, max_size, head.expected_size)
 					  .MAP_SE_ERR("MODE1 Failed To Inflate")
 					  .if_ok([](const auto &ref_span)
 					         { DEBUG("Size: ", ref_span.size()); });
@@ -1966,10 +2650,10 @@ namespace SourceExplorer
 				case encoding_t::mode0: [[fallthrough]];
 				default:
 				{
-					if (head.data.size() > 0 && uint8_t(head.data[0]) == 0x78)
+					if (data.size() > 0 && uint8_t(data[0]) == 0x78)
 					{
 						return lak::ok_t{lak::ok_or_err(
-						  Inflate(head.data, false, false, max_size)
+						  Inflate(data, false, false, max_size, head.expected_size)
 						    .if_ok(
 						      [](const auto &ref_span)
 						      {
@@ -1978,25 +2662,30 @@ namespace SourceExplorer
 							      DEBUG("Size: ", ref_span.size());
 						      })
 						    .map_err(
-						      [this](const auto &err)
+						      [&](const auto &err)
 						      {
 							      WARNING("Guess MODE1 Failed To Inflate: ", err);
-							      DEBUG("Size: ", head.data.size());
-							      return head.data;
+							      DEBUG("Size: ", data.size());
+							      return data;
 						      }))};
 					}
 					else
 					{
-						return lak::ok_t{head.data};
+						return lak::ok_t{data};
 					}
 				}
 			}
 		}
 	}
 
-	const data_ref_span_t &basic_entry_t::raw_body() const { return body.data; }
+	data_ref_span_t basic_entry_t::raw_body() const { return body.data.get(); }
 
-	const data_ref_span_t &basic_entry_t::raw_head() const { return head.data; }
+	data_ref_span_t basic_entry_t::raw_head() const { return head.data.get(); }
+
+	data_reader_t basic_entry_t::body_reader() const
+	{
+		return body.data.reader();
+	}
 
 	result_t<std::u16string> ReadStringEntry(game_t &game,
 	                                         const chunk_entry_t &entry)
@@ -2057,7 +2746,10 @@ namespace SourceExplorer
 	error_t basic_chunk_t::basic_view(source_explorer_t &srcexp,
 	                                  const char *name) const
 	{
-		LAK_TREE_NODE("0x%zX %s##%zX", (size_t)entry.ID, name, entry.position())
+		LAK_TREE_NODE("0x%zX %s##%" PRIX64,
+		              (size_t)entry.ID,
+		              name,
+		              entry.position())
 		{
 			entry.view(srcexp);
 		}
@@ -2075,7 +2767,10 @@ namespace SourceExplorer
 	error_t basic_item_t::basic_view(source_explorer_t &srcexp,
 	                                 const char *name) const
 	{
-		LAK_TREE_NODE("0x%zX %s##%zX", (size_t)entry.ID, name, entry.position())
+		LAK_TREE_NODE("0x%zX %s##%" PRIX64,
+		              (size_t)entry.ID,
+		              name,
+		              entry.position())
 		{
 			entry.view(srcexp);
 		}
@@ -2102,7 +2797,7 @@ namespace SourceExplorer
 	{
 		lak::astring str = "'" + astring() + "'";
 
-		LAK_TREE_NODE("0x%zX %s %s##%zX",
+		LAK_TREE_NODE("0x%zX %s %s##%" PRIX64,
 		              (size_t)entry.ID,
 		              name,
 		              preview ? str.c_str() : "",
@@ -2153,7 +2848,7 @@ namespace SourceExplorer
 	error_t strings_chunk_t::basic_view(source_explorer_t &srcexp,
 	                                    const char *name) const
 	{
-		LAK_TREE_NODE("0x%zX %s (%zu Items)##%zX",
+		LAK_TREE_NODE("0x%zX %s (%zu Items)##%" PRIX64,
 		              (size_t)entry.ID,
 		              name,
 		              values.size(),
@@ -2175,7 +2870,7 @@ namespace SourceExplorer
 	error_t compressed_chunk_t::view(source_explorer_t &srcexp) const
 	{
 		LAK_TREE_NODE(
-		  "0x%zX Unknown Compressed##%zX", (size_t)entry.ID, entry.position())
+		  "0x%zX Unknown Compressed##%" PRIX64, (size_t)entry.ID, entry.position())
 		{
 			entry.view(srcexp);
 
@@ -2322,7 +3017,7 @@ namespace SourceExplorer
 
 	error_t icon_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX Icon##%zX", (size_t)entry.ID, entry.position())
+		LAK_TREE_NODE("0x%zX Icon##%" PRIX64, (size_t)entry.ID, entry.position())
 		{
 			entry.view(srcexp);
 
@@ -2412,7 +3107,7 @@ namespace SourceExplorer
 	error_t binary_files_t::view(source_explorer_t &srcexp) const
 	{
 		LAK_TREE_NODE(
-		  "0x%zX Binary Files##%zX", (size_t)entry.ID, entry.position())
+		  "0x%zX Binary Files##%" PRIX64, (size_t)entry.ID, entry.position())
 		{
 			entry.view(srcexp);
 
@@ -2493,7 +3188,7 @@ namespace SourceExplorer
 	error_t extended_header_t::view(source_explorer_t &srcexp) const
 	{
 		LAK_TREE_NODE(
-		  "0x%zX Extended Header##%zX", (size_t)entry.ID, entry.position())
+		  "0x%zX Extended Header##%" PRIX64, (size_t)entry.ID, entry.position())
 		{
 			entry.view(srcexp);
 
@@ -2570,7 +3265,7 @@ namespace SourceExplorer
 
 	error_t chunk_2253_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX Chunk 2253 (%zu Items)##%zX",
+		LAK_TREE_NODE("0x%zX Chunk 2253 (%zu Items)##%" PRIX64,
 		              (size_t)entry.ID,
 		              items.size(),
 		              entry.position())
@@ -2610,7 +3305,7 @@ namespace SourceExplorer
 		RES_TRY(entry.read(game, strm)
 		          .MAP_SE_ERR("two_five_plus_object_properties_t::read"));
 
-		data_reader_t reader(entry.raw_body());
+		auto reader = entry.body_reader();
 
 		while (!reader.empty())
 		{
@@ -2626,7 +3321,7 @@ namespace SourceExplorer
 	error_t two_five_plus_object_properties_t::view(
 	  source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX Object Properties (2.5+) (%zu Items)##%zX",
+		LAK_TREE_NODE("0x%zX Object Properties (2.5+) (%zu Items)##%" PRIX64,
 		              (size_t)entry.ID,
 		              items.size(),
 		              entry.position())
@@ -2635,7 +3330,7 @@ namespace SourceExplorer
 
 			for (const auto &item : items)
 			{
-				LAK_TREE_NODE("Properties##%zX", item.position())
+				LAK_TREE_NODE("Properties##%" PRIX64, item.position())
 				{
 					item.view(srcexp);
 				}
@@ -2656,7 +3351,7 @@ namespace SourceExplorer
 
 		RES_TRY(entry.read(game, strm).MAP_SE_ERR("object_properties_t::read"));
 
-		data_reader_t reader(entry.raw_body());
+		auto reader = entry.body_reader();
 
 		while (!reader.empty())
 		{
@@ -2671,7 +3366,7 @@ namespace SourceExplorer
 
 	error_t object_properties_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX Object Properties (%zu Items)##%zX",
+		LAK_TREE_NODE("0x%zX Object Properties (%zu Items)##%" PRIX64,
 		              (size_t)entry.ID,
 		              items.size(),
 		              entry.position())
@@ -2681,7 +3376,7 @@ namespace SourceExplorer
 			for (const auto &item : items)
 			{
 				LAK_TREE_NODE(
-				  "0x%zX Properties##%zX", (size_t)item.ID, item.position())
+				  "0x%zX Properties##%" PRIX64, (size_t)item.ID, item.position())
 				{
 					item.view(srcexp);
 				}
@@ -2702,7 +3397,7 @@ namespace SourceExplorer
 
 		RES_TRY(entry.read(game, strm).MAP_SE_ERR("truetype_fonts_t::read"));
 
-		data_reader_t reader(entry.raw_body());
+		auto reader = entry.body_reader();
 
 		for (size_t i = 0; !reader.empty(); ++i)
 		{
@@ -2718,7 +3413,7 @@ namespace SourceExplorer
 
 	error_t truetype_fonts_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX TrueType Fonts (%zu Items)##%zX",
+		LAK_TREE_NODE("0x%zX TrueType Fonts (%zu Items)##%" PRIX64,
 		              (size_t)entry.ID,
 		              items.size(),
 		              entry.position())
@@ -2727,7 +3422,7 @@ namespace SourceExplorer
 
 			for (const auto &item : items)
 			{
-				LAK_TREE_NODE("0x%zX Font##%zX", (size_t)item.ID, item.position())
+				LAK_TREE_NODE("0x%zX Font##%" PRIX64, (size_t)item.ID, item.position())
 				{
 					item.view(srcexp);
 				}
@@ -2861,7 +3556,7 @@ namespace SourceExplorer
 
 		error_t quick_backdrop_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Properties (Quick Backdrop)##%zX",
+			LAK_TREE_NODE("0x%zX Properties (Quick Backdrop)##%" PRIX64,
 			              (size_t)entry.ID,
 			              entry.position())
 			{
@@ -2924,7 +3619,9 @@ namespace SourceExplorer
 		error_t backdrop_t::view(source_explorer_t &srcexp) const
 		{
 			LAK_TREE_NODE(
-			  "0x%zX Properties (Backdrop)##%zX", (size_t)entry.ID, entry.position())
+			  "0x%zX Properties (Backdrop)##%" PRIX64,
+			  (size_t)entry.ID,
+			  entry.position())
 			{
 				entry.view(srcexp);
 
@@ -3152,7 +3849,7 @@ namespace SourceExplorer
 			//     mode = game_mode_t::_284;
 			// else
 			//     mode = game_mode_t::_OLD;
-			mode = _mode;
+			mode = game.decryption->mode;
 
 			// used for offsets.
 			const size_t begin = cstrm.position();
@@ -3242,7 +3939,9 @@ namespace SourceExplorer
 		error_t common_t::view(source_explorer_t &srcexp) const
 		{
 			LAK_TREE_NODE(
-			  "0x%zX Properties (Common)##%zX", (size_t)entry.ID, entry.position())
+			  "0x%zX Properties (Common)##%" PRIX64,
+			  (size_t)entry.ID,
+			  entry.position())
 			{
 				entry.view(srcexp);
 
@@ -3380,7 +4079,7 @@ namespace SourceExplorer
 
 		error_t item_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX %s '%s'##%zX",
+			LAK_TREE_NODE("0x%zX %s '%s'##%" PRIX64,
 			              (size_t)entry.ID,
 			              GetObjectTypeString(type),
 			              (name ? lak::strconv<char>(name->value).c_str() : ""),
@@ -3471,7 +4170,7 @@ namespace SourceExplorer
 
 			RES_TRY(entry.read(game, strm).MAP_SE_ERR("object::bank_t::read"));
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			TRY_ASSIGN(const auto item_count =, reader.read_u32());
 
@@ -3509,7 +4208,7 @@ namespace SourceExplorer
 
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Object Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Object Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
@@ -3567,7 +4266,7 @@ namespace SourceExplorer
 		error_t palette_t::view(source_explorer_t &srcexp) const
 		{
 			LAK_TREE_NODE(
-			  "0x%zX Frame Palette##%zX", (size_t)entry.ID, entry.position())
+			  "0x%zX Frame Palette##%" PRIX64, (size_t)entry.ID, entry.position())
 			{
 				entry.view(srcexp);
 
@@ -3708,7 +4407,7 @@ namespace SourceExplorer
 		error_t object_instances_t::view(source_explorer_t &srcexp) const
 		{
 			LAK_TREE_NODE(
-			  "0x%zX Object Instances##%zX", (size_t)entry.ID, entry.position())
+			  "0x%zX Object Instances##%" PRIX64, (size_t)entry.ID, entry.position())
 			{
 				entry.view(srcexp);
 
@@ -3797,7 +4496,7 @@ namespace SourceExplorer
 		error_t random_seed_t::view(source_explorer_t &srcexp) const
 		{
 			LAK_TREE_NODE(
-			  "0x%zX Random Seed##%zX", (size_t)entry.ID, entry.position())
+			  "0x%zX Random Seed##%" PRIX64, (size_t)entry.ID, entry.position())
 			{
 				entry.view(srcexp);
 				ImGui::Text("Value: %i", (int)value);
@@ -3849,14 +4548,14 @@ namespace SourceExplorer
 
 			DEFER(game.bank_completed = 0.0f);
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			for (bool not_finished = true; not_finished;)
 			{
 				game.bank_completed =
 				  float(double(reader.position()) / double(reader.size()));
 
-				if (reader.remaining().size() < 2) break;
+				if (reader.size() - reader.position() < 2) break;
 
 				switch ((chunk_t)reader.peek_u16().UNWRAP())
 				{
@@ -4026,7 +4725,7 @@ namespace SourceExplorer
 
 		error_t item_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX '%s'##%zX",
+			LAK_TREE_NODE("0x%zX '%s'##%" PRIX64,
 			              (size_t)entry.ID,
 			              (name ? lak::strconv<char>(name->value).c_str() : ""),
 			              entry.position())
@@ -4196,7 +4895,7 @@ namespace SourceExplorer
 
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Frame Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Frame Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
@@ -4213,12 +4912,81 @@ namespace SourceExplorer
 		}
 	}
 
+	// Read a bank's items in two passes. The first walks the bank in order on
+	// this thread, scan(item, index) only has to read far enough to find
+	// where the next item starts. The second runs parse(item, index) for
+	// every scanned item across all cores. Failures are then handled in item
+	// order as if each item had been read in full before the next, the first
+	// max_tries are logged and skipped and the one after that is returned.
+	// Pass nullptr for parse if scan already reads the whole item.
+	template<typename ITEM, typename SCAN, typename PARSE>
+	static error_t ReadBankItems(game_t &game,
+	                             data_reader_t &reader,
+	                             lak::array<ITEM> &items,
+	                             size_t max_tries,
+	                             SCAN scan,
+	                             PARSE parse)
+	{
+		std::vector<std::optional<error>> errors(items.size());
+
+		size_t scanned  = 0;
+		size_t failures = 0;
+		while (scanned < items.size() && failures <= max_tries)
+		{
+			const size_t index = scanned++;
+			if (auto result = scan(items[index], index); result.is_err())
+			{
+				errors[index] = lak::move(result.unsafe_unwrap_err());
+				++failures;
+			}
+
+			game.bank_completed =
+			  float(double(reader.position()) / double(reader.size()) *
+			        (std::is_same_v<PARSE, std::nullptr_t> ? 1.0 : 0.5));
+		}
+
+		std::atomic<size_t> parsed = 0;
+		if constexpr (!std::is_same_v<PARSE, std::nullptr_t>)
+			parallel_for(scanned,
+			             [&](size_t index)
+			             {
+				             if (!errors[index])
+				             {
+					             if (auto result = parse(items[index], index);
+					                 result.is_err())
+						             errors[index] = lak::move(result.unsafe_unwrap_err());
+				             }
+
+				             game.bank_completed =
+				               float(0.5 + double(++parsed) / double(scanned) / 2.0);
+			             });
+
+		for (size_t index = 0; index < scanned; ++index)
+		{
+			if (!errors[index]) continue;
+			if (max_tries == 0) return lak::err_t{lak::move(*errors[index])};
+			ERROR(*errors[index]);
+			DEBUG("Continuing...");
+			--max_tries;
+		}
+
+		return lak::ok_t{};
+	}
+
 	namespace image
 	{
 		error_t item_t::read(game_t &game, data_reader_t &strm)
 		{
 			FUNCTION_CHECKPOINT("image::item_t::");
 
+			RES_TRY(scan(game, strm));
+			return parse(game);
+		}
+
+		error_t item_t::scan(game_t &game, data_reader_t &strm)
+		{
+			FUNCTION_CHECKPOINT("image::item_t::");
+
 			const auto strm_start = strm.position();
 			if (game.ccn)
 			{
@@ -4257,112 +5025,228 @@ namespace SourceExplorer
 				TRY_ASSIGN(size.y =, hstrm.read_u16());
 				TRY_ASSIGN([[maybe_unused]] const auto unk2 =, hstrm.read_u16());
 				TRY_ASSIGN([[maybe_unused]] const auto unk3 =, hstrm.read_u16());
+
+				header_loaded = true;
+			}
+			else if (game.two_five_plus_game)
+			{
+				const size_t header_size = 36;
+				RES_TRY(entry.read(game, strm, false, header_size)
+				          .MAP_SE_ERR("image::item_t::read"));
+
+				data_position = strm.position();
+
+				RES_TRY_ASSIGN(
+				  auto span =,
+				  entry.decode_head(header_size).MAP_SE_ERR("image::item_t::read"));
+
+				if (span.size() < header_size)
+					return lak::err_t{error(LINE_TRACE, error::out_of_data)};
+
+				// 2.5+ games store the data size in the header, so it has to be
+				// read up front to find the end of the item.
+				RES_TRY(read_header(span, game.old_game, true)
+				          .MAP_SE_ERR("image::item_t::read"));
+
+				ASSERT_EQUAL(strm.position(), data_position);
+				TRY_ASSIGN(entry.body.data =, strm.read_ref_span(data_size));
+				data_position = 0;
+
+				const auto strm_end = strm.position();
+				TRY(strm.seek(strm_start));
+				TRY_ASSIGN(entry.ref_span =,
+				           strm.read_ref_span(strm_end - strm_start));
+				DEBUG("Corrected Ref Span Size: ", entry.ref_span.size());
 			}
 			else
 			{
-				data_ref_span_t span;
-				if (game.two_five_plus_game)
-				{
-					const size_t header_size = 36;
-					RES_TRY(entry.read(game, strm, false, header_size)
-					          .MAP_SE_ERR("image::item_t::read"));
+				RES_TRY(
+				  entry.read(game, strm, true).MAP_SE_ERR("image::item_t::read"));
+			}
 
-					data_position = strm.position();
+			return lak::ok_t{};
+		}
 
-					RES_TRY_ASSIGN(
-					  span =,
-					  entry.decode_head(header_size).MAP_SE_ERR("image::item_t::read"));
+		error_t item_t::parse(const game_t &game)
+		{
+			FUNCTION_CHECKPOINT("image::item_t::");
 
-					if (span.size() < header_size)
-						return lak::err_t{error(LINE_TRACE, error::out_of_data)};
-				}
-				else
-				{
-					RES_TRY(
-					  entry.read(game, strm, true).MAP_SE_ERR("image::item_t::read"));
+			// CCN and 2.5+ items are read in full by scan().
+			if (game.ccn || game.two_five_plus_game) return lak::ok_t{};
 
-					if (!game.old_game && game.product_build >= 284) --entry.handle;
+			const item_record_t *cached =
+			  game.index_loaded
+			    ? game.index.find_item(entry.ref_span.index_key(), entry.handle)
+			    : nullptr;
 
-					RES_TRY_ASSIGN(span =,
-					               entry.decode_body(176 + (game.old_game ? 16 : 80))
-					                 .MAP_SE_ERR("image::item_t::read"));
-				}
-				auto istrm = data_reader_t(span);
+			if (!game.old_game && game.product_build >= 284) --entry.handle;
 
-				DEBUG("Handle: ", entry.handle);
+			if (cached && cached->has_image)
+			{
+				load_record(cached->image);
+				return lak::ok_t{};
+			}
 
-				if (game.old_game)
-				{
-					TRY_ASSIGN(checksum =, istrm.read_u16());
-				}
-				else
-				{
-					TRY_ASSIGN(checksum =, istrm.read_u32());
-				}
-				TRY_ASSIGN(reference =, istrm.read_u32());
-				if (game.two_five_plus_game) TRY(istrm.skip(4));
-				TRY_ASSIGN(data_size =, istrm.read_u32());
-				TRY_ASSIGN(size.x =, istrm.read_u16());
-				TRY_ASSIGN(size.y =, istrm.read_u16());
-				TRY_ASSIGN(const uint8_t gmode =, istrm.read_u8());
-				switch (gmode)
-				{
-					case 2: graphics_mode = graphics_mode_t::RGB8; break;
-					case 3: graphics_mode = graphics_mode_t::RGB8; break;
-					case 4: graphics_mode = graphics_mode_t::BGR24; break;
-					case 6: graphics_mode = graphics_mode_t::RGB15; break;
-					case 7: graphics_mode = graphics_mode_t::RGB16; break;
-					case 8: graphics_mode = graphics_mode_t::BGRA32; break;
-				}
-				TRY_ASSIGN(flags = (image_flag_t), istrm.read_u8());
+			// The item boundary is already known, the header is only needed
+			// once something actually looks at this image.
+			if (game.lazy_banks) return lak::ok_t{};
+
+			return load_header().MAP_SE_ERR("image::item_t::read");
+		}
+
+		error_t item_t::load_header() const
+		{
+			FUNCTION_CHECKPOINT("image::item_t::");
+
+			if (std::atomic_ref(header_loaded).load(std::memory_order_acquire))
+				return lak::ok_t{};
+
+			// Concurrent dumps (and the UI) can ask for the same header at once.
+			static std::mutex locks[64];
+			std::lock_guard lock(
+			  locks[(reinterpret_cast<uintptr_t>(this) / sizeof(*this)) % 64]);
+
+			if (header_loaded) return lak::ok_t{};
+
+			RES_TRY_ASSIGN(auto span =,
+			               entry.decode_body(176 + (entry.old ? 16 : 80))
+			                 .MAP_SE_ERR("image::item_t::load_header"));
+
+			return read_header(span, entry.old, false)
+			  .MAP_SE_ERR("image::item_t::load_header");
+		}
+
+		void item_t::load_record(const image_record_t &record) const
+		{
+			checksum      = record.checksum;
+			reference     = record.reference;
+			data_size     = record.data_size;
+			size.x        = record.width;
+			size.y        = record.height;
+			graphics_mode = record.graphics_mode;
+			flags         = record.flags;
+			unknown       = record.unknown;
+			hotspot.x     = record.hotspot_x;
+			hotspot.y     = record.hotspot_y;
+			action.x      = record.action_x;
+			action.y      = record.action_y;
+			transparent.r = record.transparent[0];
+			transparent.g = record.transparent[1];
+			transparent.b = record.transparent[2];
+			transparent.a = record.transparent[3];
+			data_position = record.data_position;
+			std::atomic_ref(header_loaded).store(true, std::memory_order_release);
+		}
+
+		image_record_t item_t::record() const
+		{
+			image_record_t result;
+			result.checksum       = checksum;
+			result.reference      = reference;
+			result.data_size      = data_size;
+			result.width          = size.x;
+			result.height         = size.y;
+			result.graphics_mode  = graphics_mode;
+			result.flags          = flags;
+			result.unknown        = unknown;
+			result.hotspot_x      = hotspot.x;
+			result.hotspot_y      = hotspot.y;
+			result.action_x       = action.x;
+			result.action_y       = action.y;
+			result.transparent[0] = transparent.r;
+			result.transparent[1] = transparent.g;
+			result.transparent[2] = transparent.b;
+			result.transparent[3] = transparent.a;
+			result.data_position  = static_cast<uint32_t>(data_position);
+			return result;
+		}
+
+		error_t item_t::read_header(data_ref_span_t span,
+		                            bool old_game,
+		                            bool two_five_plus_game) const
+		{
+			FUNCTION_CHECKPOINT("image::item_t::");
+
+			auto istrm = data_reader_t(span);
+
+			DEBUG("Handle: ", entry.handle);
+
+			if (old_game)
+			{
+				TRY_ASSIGN(checksum =, istrm.read_u16());
+			}
+			else
+			{
+				TRY_ASSIGN(checksum =, istrm.read_u32());
+			}
+			TRY_ASSIGN(reference =, istrm.read_u32());
+			if (two_five_plus_game) TRY(istrm.skip(4));
+			TRY_ASSIGN(data_size =, istrm.read_u32());
+			TRY_ASSIGN(size.x =, istrm.read_u16());
+			TRY_ASSIGN(size.y =, istrm.read_u16());
+			TRY_ASSIGN(const uint8_t gmode =, istrm.read_u8());
+			switch (gmode)
+			{
+				case 2: graphics_mode = graphics_mode_t::RGB8; break;
+				case 3: graphics_mode = graphics_mode_t::RGB8; break;
+				case 4: graphics_mode = graphics_mode_t::BGR24; break;
+				case 6: graphics_mode = graphics_mode_t::RGB15; break;
+				case 7: graphics_mode = graphics_mode_t::RGB16; break;
+				case 8: graphics_mode = graphics_mode_t::BGRA32; break;
+			}
+			TRY_ASSIGN(flags = (image_flag_t), istrm.read_u8());
 #if 0
-				if (graphics_mode == graphics_mode_t::RGB8)
-				{
-					TRY_ASSIGN(palette_entries =, istrm.read_u8());
-					for (size_t i = 0; i < palette.size();
-					     ++i) // where is this size coming from???
-						palette[i] = ColorFrom32bitRGBA(istrm); // not sure if RGBA or BGRA
-					TRY_ASSIGN(count =, strm.read_u32());
-				}
+			if (graphics_mode == graphics_mode_t::RGB8)
+			{
+				TRY_ASSIGN(palette_entries =, istrm.read_u8());
+				for (size_t i = 0; i < palette.size();
+				     ++i) // where is this size coming from???
+					palette[i] = ColorFrom32bitRGBA(istrm); // not sure if RGBA or BGRA
+				TRY_ASSIGN(count =, strm.read_u32());
+			}
 #endif
-				if (!game.old_game)
-				{
-					TRY_ASSIGN(unknown =, istrm.read_u16());
-				}
-				TRY_ASSIGN(hotspot.x =, istrm.read_u16());
-				TRY_ASSIGN(hotspot.y =, istrm.read_u16());
-				TRY_ASSIGN(action.x =, istrm.read_u16());
-				TRY_ASSIGN(action.y =, istrm.read_u16());
+			if (!old_game)
+			{
+				TRY_ASSIGN(unknown =, istrm.read_u16());
+			}
+			TRY_ASSIGN(hotspot.x =, istrm.read_u16());
+			TRY_ASSIGN(hotspot.y =, istrm.read_u16());
+			TRY_ASSIGN(action.x =, istrm.read_u16());
+			TRY_ASSIGN(action.y =, istrm.read_u16());
 
-				if (!game.old_game) transparent = ColorFrom32bitRGBA(istrm).UNWRAP();
+			if (!old_game) transparent = ColorFrom32bitRGBA(istrm).UNWRAP();
 
-				if (game.two_five_plus_game)
-				{
-					ASSERT_EQUAL(strm.position(), data_position);
-					TRY_ASSIGN(entry.body.data =, strm.read_ref_span(data_size));
-					data_position = 0;
-
-					const auto strm_end = strm.position();
-					TRY(strm.seek(strm_start));
-					TRY_ASSIGN(entry.ref_span =,
-					           strm.read_ref_span(strm_end - strm_start));
-					DEBUG("Corrected Ref Span Size: ", entry.ref_span.size());
-				}
-				else
-				{
-					data_position = istrm.position();
-				}
-			}
+			if (!two_five_plus_game) data_position = istrm.position();
+
+			std::atomic_ref(header_loaded).store(true, std::memory_order_release);
 
 			return lak::ok_t{};
 		}
 
 		error_t item_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Image##%zX", (size_t)entry.handle, entry.position())
+			LAK_TREE_NODE("0x%zX Image##%" PRIX64,
+			              (size_t)entry.handle,
+			              entry.position())
 			{
 				entry.view(srcexp);
 
+				if (!header_failed)
+				{
+					if (auto err = load_header().MAP_SE_ERR("image::item_t::view");
+					    err.is_err())
+					{
+						ERROR(err.unsafe_unwrap_err());
+						header_failed = true;
+					}
+				}
+
+				if (header_failed)
+				{
+					ImGui::Text("Header failed to load");
+					return lak::ok_t{};
+				}
+
 				ImGui::Text("Checksum: 0x%zX", (size_t)checksum);
 				ImGui::Text("Reference: 0x%zX", (size_t)reference);
 				ImGui::Text("Data Size: 0x%zX", (size_t)data_size);
@@ -4405,14 +5289,17 @@ namespace SourceExplorer
 				}
 				ImGui::Text("Data Position: 0x%zX", data_position);
 
-				if (ImGui::Button("View Image"))
+				// Large images take a while to decompress and convert, so decode
+				// on the pool and let ViewImage upload the result. A decode that
+				// is still running is left alone, it reads from this item.
+				const bool decoding = srcexp.pending_image.valid() &&
+				                      !srcexp.pending_image.ready();
+				if (ImGui::Button("View Image") && !decoding)
 				{
-					image(srcexp.dump_color_transparent)
-					  .if_ok(
-					    [&](lak::image4_t &&img)
-					    { srcexp.image = CreateTexture(img, srcexp.graphics_mode); })
-					  .IF_ERR("Failed To Read Image Data")
-					  .discard();
+					srcexp.pending_image =
+					  async([this, transparent = srcexp.dump_color_transparent]()
+					          -> result_t<lak::image4_t>
+					        { return image(transparent); });
 				}
 			}
 
@@ -4423,6 +5310,8 @@ namespace SourceExplorer
 		{
 			FUNCTION_CHECKPOINT("image::item_t::");
 
+			RES_TRY(load_header().MAP_SE_ERR("image::item_t::image_data"));
+
 			RES_TRY_ASSIGN(
 			  auto span =,
 			  entry.decode_body().MAP_SE_ERR("image::item_t::image_data"));
@@ -4439,8 +5328,7 @@ namespace SourceExplorer
 				}
 				else
 				{
-					TRY_ASSIGN([[maybe_unused]] const uint32_t decompressed_length =,
-					           strm.read_u32());
+					TRY_ASSIGN(const uint32_t decompressed_length =, strm.read_u32());
 
 					TRY_ASSIGN(const uint32_t compressed_length =, strm.read_u32());
 
@@ -4449,10 +5337,14 @@ namespace SourceExplorer
 					return strm.read_ref_span(compressed_length)
 					  .MAP_ERR("item_t::image_data: read filed")
 					  .map(
-					    [](const data_ref_span_t &ref_span) -> data_ref_span_t
+					    [&](const data_ref_span_t &ref_span) -> data_ref_span_t
 					    {
 						    return lak::ok_or_err(
-						      Inflate(ref_span, false, false)
+						      Inflate(ref_span,
+						              false,
+						              false,
+						              SIZE_MAX,
+						              decompressed_length)
 						        .map_err([&](auto &&) { return ref_span; }));
 					    });
 				}
@@ -4465,6 +5357,7 @@ namespace SourceExplorer
 
 		bool item_t::need_palette() const
 		{
+			if (load_header().is_err()) return false;
 			return graphics_mode == graphics_mode_t::RGB8;
 		}
 
@@ -4478,6 +5371,9 @@ namespace SourceExplorer
 			RES_TRY_ASSIGN(auto span =,
 			               image_data().MAP_SE_ERR("image::item_t::image"));
 
+			// Decompressing the data was already counted by inflate/lz4.
+			perf_timer_t perf(perf_stage_t::image_decode);
+
 			if (graphics_mode == graphics_mode_t::JPEG)
 			{
 				int x, y, n;
@@ -4550,6 +5446,7 @@ namespace SourceExplorer
 					WARNING(strm.remaining().size(), " Bytes Left Over In Image Data");
 			}
 
+			perf.add(img.contig_size() * 4);
 			return lak::ok_t{lak::move(img)};
 		}
 
@@ -4566,7 +5463,7 @@ namespace SourceExplorer
 
 			RES_TRY(entry.read(game, strm).MAP_SE_ERR("image::bank_t::read"));
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			uint32_t item_count = 0;
 			if (game.ccn)
@@ -4583,35 +5480,23 @@ namespace SourceExplorer
 
 			DEBUG("Image Bank Size: ", items.size());
 
-			size_t max_tries = 3;
-
-			for (auto &item : items)
-			{
-				// clang-format off
-				RES_TRY(
-				  [&, this]() -> error_t
-				  {
-					  return item.read(game, reader)
-					    .IF_ERR("Failed To Read Item ",
-					            (&item - items.data()),
-					            " Of ",
-					            items.size())
-					    .MAP_SE_ERR("image::bank_t::read");
-				  }()
-					  .or_else(
-					    [&](const auto &err) -> error_t
-					    {
-						    if (max_tries == 0) return lak::err_t{err};
-						    ERROR(err);
-						    DEBUG("Continuing...");
-						    --max_tries;
-						    return lak::ok_t{};
-					    }));
-				// clang-format on
-
-				game.bank_completed =
-				  float(double(reader.position()) / double(reader.size()));
-			}
+			RES_TRY(ReadBankItems(
+			  game,
+			  reader,
+			  items,
+			  3,
+			  [&](item_t &item, size_t index)
+			  {
+				  return item.scan(game, reader)
+				    .IF_ERR("Failed To Read Item ", index, " Of ", items.size())
+				    .MAP_SE_ERR("image::bank_t::read");
+			  },
+			  [&](item_t &item, size_t index)
+			  {
+				  return item.parse(game)
+				    .IF_ERR("Failed To Read Item ", index, " Of ", items.size())
+				    .MAP_SE_ERR("image::bank_t::read");
+			  }));
 
 			if (!reader.empty())
 			{
@@ -4630,15 +5515,39 @@ namespace SourceExplorer
 			return lak::ok_t{};
 		}
 
+		error_t bank_t::load_headers() const
+		{
+			FUNCTION_CHECKPOINT("image::bank_t::");
+
+			for (const auto &item : items)
+			{
+				RES_TRY(item.load_header()
+				          .IF_ERR("Failed To Load Header Of Item ",
+				                  (&item - items.data()),
+				                  " Of ",
+				                  items.size())
+				          .MAP_SE_ERR("image::bank_t::load_headers"));
+			}
+
+			return lak::ok_t{};
+		}
+
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Image Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Image Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
 			{
 				entry.view(srcexp);
 
+				if (srcexp.state.lazy_banks && ImGui::Button("Load All Headers"))
+				{
+					load_headers()
+					  .IF_ERR("Failed To Load Image Headers")
+					  .discard();
+				}
+
 				for (const item_t &item : items)
 				{
 					RES_TRY(item.view(srcexp).MAP_SE_ERR("image::bank_t::view"));
@@ -4674,24 +5583,24 @@ namespace SourceExplorer
 
 			RES_TRY(entry.read(game, strm).MAP_SE_ERR("font::bank_t::read"));
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			TRY_ASSIGN(const auto item_count =, reader.read_u32());
 
 			items.resize(item_count);
 
-			for (auto &item : items)
-			{
-				RES_TRY(item.read(game, reader)
-				          .IF_ERR("Failed To Read Item ",
-				                  (&item - items.data()),
-				                  " Of ",
-				                  items.size())
-				          .MAP_SE_ERR("font::bank_t::read"));
-
-				game.bank_completed =
-				  (float)((double)reader.position() / (double)reader.size());
-			}
+			RES_TRY(ReadBankItems(
+			  game,
+			  reader,
+			  items,
+			  0,
+			  [&](item_t &item, size_t index)
+			  {
+				  return item.read(game, reader)
+				    .IF_ERR("Failed To Read Item ", index, " Of ", items.size())
+				    .MAP_SE_ERR("font::bank_t::read");
+			  },
+			  nullptr));
 
 			if (!reader.empty())
 			{
@@ -4712,7 +5621,7 @@ namespace SourceExplorer
 
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Font Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Font Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
@@ -4760,24 +5669,24 @@ namespace SourceExplorer
 
 			RES_TRY(entry.read(game, strm).MAP_SE_ERR("sound::bank_t::read"));
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			TRY_ASSIGN(const auto item_count =, reader.read_u32());
 
 			items.resize(item_count);
 
-			for (auto &item : items)
-			{
-				RES_TRY(item.read(game, reader)
-				          .IF_ERR("Failed To Read Item ",
-				                  (&item - items.data()),
-				                  " Of ",
-				                  items.size())
-				          .MAP_SE_ERR("sound::bank_t::read"));
-
-				game.bank_completed =
-				  (float)((double)reader.position() / (double)reader.size());
-			}
+			RES_TRY(ReadBankItems(
+			  game,
+			  reader,
+			  items,
+			  0,
+			  [&](item_t &item, size_t index)
+			  {
+				  return item.read(game, reader)
+				    .IF_ERR("Failed To Read Item ", index, " Of ", items.size())
+				    .MAP_SE_ERR("sound::bank_t::read");
+			  },
+			  nullptr));
 
 			if (!reader.empty())
 			{
@@ -4798,7 +5707,7 @@ namespace SourceExplorer
 
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Sound Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Sound Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
@@ -4840,24 +5749,24 @@ namespace SourceExplorer
 
 			RES_TRY(entry.read(game, strm).MAP_SE_ERR("music::bank_t::read"));
 
-			data_reader_t reader(entry.raw_body());
+			auto reader = entry.body_reader();
 
 			TRY_ASSIGN(const auto item_count =, reader.read_u32());
 
 			items.resize(item_count);
 
-			for (auto &item : items)
-			{
-				RES_TRY(item.read(game, reader)
-				          .IF_ERR("Failed To Read Item ",
-				                  (&item - items.data()),
-				                  " Of ",
-				                  items.size())
-				          .MAP_SE_ERR("music::bank_t::read"));
-
-				game.bank_completed =
-				  (float)((double)reader.position() / (double)reader.size());
-			}
+			RES_TRY(ReadBankItems(
+			  game,
+			  reader,
+			  items,
+			  0,
+			  [&](item_t &item, size_t index)
+			  {
+				  return item.read(game, reader)
+				    .IF_ERR("Failed To Read Item ", index, " Of ", items.size())
+				    .MAP_SE_ERR("music::bank_t::read");
+			  },
+			  nullptr));
 
 			if (!reader.empty())
 			{
@@ -4878,7 +5787,7 @@ namespace SourceExplorer
 
 		error_t bank_t::view(source_explorer_t &srcexp) const
 		{
-			LAK_TREE_NODE("0x%zX Music Bank (%zu Items)##%zX",
+			LAK_TREE_NODE("0x%zX Music Bank (%zu Items)##%" PRIX64,
 			              (size_t)entry.ID,
 			              items.size(),
 			              entry.position())
@@ -4926,6 +5835,9 @@ namespace SourceExplorer
 				game.completed =
 				  (float)((double)strm.position() / (double)strm.size());
 
+			if (game.arena->over_budget())
+				return lak::err_t{error(LINE_TRACE, error::over_budget)};
+
 			if (strm.position() == start_pos)
 				return lak::err_t{error(LINE_TRACE,
 				                        error::str_err,
@@ -4934,6 +5846,7 @@ namespace SourceExplorer
 				                        ") didn't move stream head")};
 
 			start_pos = strm.position();
+			TRY(strm.ensure(2));
 			TRY_ASSIGN(childID = (chunk_t), strm.peek_u16());
 
 			// the MAP_SE_ERRs are here so we get line information
@@ -5180,7 +6093,9 @@ namespace SourceExplorer
 
 	error_t header_t::view(source_explorer_t &srcexp) const
 	{
-		LAK_TREE_NODE("0x%zX Game Header##%zX", (size_t)entry.ID, entry.position())
+		LAK_TREE_NODE("0x%zX Game Header##%" PRIX64,
+		              (size_t)entry.ID,
+		              entry.position())
 		{
 			entry.view(srcexp);
 
@@ -25,7 +25,13 @@
 #include <imgui_stdlib.h>
 
 #include "defines.h"
+#include "arena.h"
+#include "chunk_index.h"
 #include "encryption.h"
+#include "image_encoder.h"
+#include "inflate.h"
+#include "mapped_file.h"
+#include "parallel.h"
 #include "stb_image.h"
 
 #include <lak/binary_reader.hpp>
@@ -44,11 +50,14 @@
 
 #include <assert.h>
 #include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <istream>
 #include <iterator>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stack>
 #include <stdint.h>
@@ -93,6 +102,8 @@ namespace SourceExplorer
 			no_mode1_decoder,
 			no_mode2_decoder,
 			no_mode3_decoder,
+
+			over_budget,
 		};
 
 		std::vector<lak::pair<lak::trace, lak::u8string>> _trace;
@@ -171,6 +182,8 @@ namespace SourceExplorer
 					return lak::as_u8string("No MODE2 Decoder").to_string();
 				case no_mode3_decoder:
 					return lak::as_u8string("No MODE3 Decoder").to_string();
+				case over_budget:
+					return lak::as_u8string("Over Memory Budget").to_string();
 				default: return lak::as_u8string("Invalid Error Code").to_string();
 			}
 		}
@@ -303,10 +316,6 @@ namespace SourceExplorer
 	using result_t = lak::result<T, error>;
 	using error_t  = result_t<lak::monostate>;
 
-	extern bool force_compat;
-	extern std::vector<uint8_t> _magic_key;
-	extern uint8_t _magic_char;
-
 	enum class game_mode_t : uint8_t
 	{
 		_OLD,
@@ -314,7 +323,22 @@ namespace SourceExplorer
 		_288,
 		_290 // might be 292?
 	};
-	extern game_mode_t _mode;
+
+	// Everything needed to decrypt one game's MODE2/3 chunks. Each game_t owns
+	// its own, so several games (or worker threads) can decrypt at once.
+	struct decryption_t
+	{
+		game_mode_t mode   = game_mode_t::_OLD;
+		uint8_t magic_char = 99; // 'c'
+		// Generated from the header strings by GetEncryptionKey, the first time
+		// an encrypted chunk is read.
+		std::vector<uint8_t> magic_key;
+		// Built from magic_key by GetEncryptionKey, only read after that.
+		encryption_table table;
+
+		// Start decrypting a chunk, nullopt if no table could be generated.
+		std::optional<encryption_stream> stream() const;
+	};
 
 	struct game_t;
 	struct source_explorer_t;
@@ -322,62 +346,176 @@ namespace SourceExplorer
 	using texture_t =
 	  std::variant<std::monostate, lak::opengl::texture, texture_color32_t>;
 
-	struct pack_file_t
-	{
-		std::u16string filename;
-		lak::array<byte_t> data;
-		bool wide;
-		uint32_t bingo;
-	};
-
 	struct _data_ref
 	{
-		std::shared_ptr<_data_ref> _parent = {};
-		lak::span<byte_t> _parent_span     = {};
-		lak::array<byte_t> _data           = {};
+		std::shared_ptr<_data_ref> _parent      = {};
+		lak::span<byte_t> _parent_span          = {};
+		lak::array<byte_t> _data                = {};
+		std::shared_ptr<mapped_file_t> _mapping = {};
+		// Shared by every reference decoded from the same root, _owned is this
+		// reference's own data if it was allocated from the arena.
+		std::shared_ptr<decode_arena_t> _arena = {};
+		lak::span<byte_t> _owned               = {};
+		size_t _owned_capacity                 = 0;
+		// The reference at the top of the _parent chain and the span of it
+		// this reference was (eventually) decoded from, both empty if this is
+		// the root. Recorded up front so root queries don't walk the chain.
+		std::shared_ptr<_data_ref> _root = {};
+		lak::span<byte_t> _root_span     = {};
 
 		_data_ref()                  = default;
-		_data_ref(const _data_ref &) = default;
-		_data_ref(_data_ref &&)      = default;
-		_data_ref &operator=(const _data_ref &) = default;
-		_data_ref &operator=(_data_ref &&) = default;
+		_data_ref(const _data_ref &) = delete;
+		_data_ref &operator=(const _data_ref &) = delete;
+
+		_data_ref(lak::array<byte_t> data, std::shared_ptr<decode_arena_t> arena)
+		: _parent(),
+		  _parent_span(),
+		  _data(lak::move(data)),
+		  _arena(lak::move(arena))
+		{
+		}
+
+		_data_ref(std::shared_ptr<mapped_file_t> mapping,
+		          std::shared_ptr<decode_arena_t> arena)
+		: _parent(),
+		  _parent_span(),
+		  _data(),
+		  _mapping(lak::move(mapping)),
+		  _arena(lak::move(arena))
+		{
+		}
 
-		_data_ref(lak::array<byte_t> data)
-		: _parent(), _parent_span(), _data(lak::move(data))
+		_data_ref(arena_buffer_t data)
+		: _parent(),
+		  _parent_span(),
+		  _arena(data.arena()),
+		  _owned(data.span()),
+		  _owned_capacity(data.capacity())
 		{
+			data.release();
 		}
 
 		_data_ref(const std::shared_ptr<_data_ref> &parent,
 		          size_t offset,
 		          size_t count,
 		          lak::array<byte_t> data)
-		: _parent(parent), _data(lak::move(data))
+		: _parent(parent), _data(lak::move(data)), _arena(parent->_arena)
+		{
+			ASSERT(_parent);
+			_parent_span = _parent->get().subspan(offset, count);
+			init_root();
+		}
+
+		_data_ref(const std::shared_ptr<_data_ref> &parent,
+		          size_t offset,
+		          size_t count,
+		          arena_buffer_t data)
+		: _parent(parent),
+		  _arena(data.arena()),
+		  _owned(data.span()),
+		  _owned_capacity(data.capacity())
 		{
 			ASSERT(_parent);
-			_parent_span = lak::span(_parent->_data).subspan(offset, count);
+			data.release();
+			_parent_span = _parent->get().subspan(offset, count);
+			init_root();
+		}
+
+		~_data_ref()
+		{
+			if (_owned.data()) _arena->deallocate(_owned.data(), _owned_capacity);
+		}
+
+		void init_root()
+		{
+			// Data decoded from a window of a windowed file must not keep the
+			// window mapped, so it becomes a root of its own instead.
+			if (_parent->_mapping && _parent->_mapping->windowed())
+			{
+				_parent.reset();
+				_parent_span = {};
+				return;
+			}
+
+			if (_parent->_parent)
+			{
+				_root      = _parent->_root;
+				_root_span = _parent->_root_span;
+			}
+			else
+			{
+				_root      = _parent;
+				_root_span = _parent_span;
+			}
 		}
 
 		inline std::shared_ptr<_data_ref> parent() const { return _parent; }
 		inline lak::span<byte_t> parent_span() const { return _parent_span; }
-		inline size_t size() const { return _data.size(); }
-		inline const byte_t *data() const { return _data.data(); }
-		inline byte_t *data() { return _data.data(); }
-		inline const lak::array<byte_t> &get() const { return _data; }
-		inline lak::array<byte_t> &get() { return _data; }
-
-		inline operator lak::span<const byte_t>() const
+		// Offset of this reference from the start of the file, only non-zero
+		// for windows of a windowed_file_t.
+		inline uint64_t file_offset() const
+		{
+			return _mapping ? _mapping->offset() : 0;
+		}
+		inline size_t size() const { return get().size(); }
+		inline const byte_t *data() const { return get().data(); }
+		inline byte_t *data() { return get().data(); }
+		inline lak::span<const byte_t> get() const
 		{
+			if (_mapping) return _mapping->span();
+			if (_owned.data()) return _owned;
 			return lak::span(_data);
 		}
-		inline operator lak::span<byte_t>() { return lak::span(_data); }
+		inline lak::span<byte_t> get()
+		{
+			if (_mapping) return _mapping->span();
+			if (_owned.data()) return _owned;
+			return lak::span(_data);
+		}
+
+		// Forwards the access hint to the file mapping at the root of this
+		// reference, if there is one.
+		void advise(access_hint_t hint) const
+		{
+			if (_mapping)
+				_mapping->advise(hint);
+			else if (_parent)
+				_parent->advise(hint);
+		}
+
+		inline operator lak::span<const byte_t>() const { return get(); }
+		inline operator lak::span<byte_t>() { return get(); }
 	};
 
 	using data_ref_ptr_t = std::shared_ptr<_data_ref>;
 
-	static data_ref_ptr_t make_data_ref_ptr(lak::array<byte_t> data)
+	// References (and their shared_ptr control blocks) are allocated from the
+	// arena of the game they belong to, so a whole game can be torn down
+	// without a trip through the system allocator for each one.
+	template<typename... ARGS>
+	static data_ref_ptr_t allocate_data_ref_ptr(
+	  const std::shared_ptr<decode_arena_t> &arena, ARGS &&...args)
+	{
+		ASSERT(arena);
+		return std::allocate_shared<_data_ref>(
+		  arena_allocator_t<_data_ref>(arena), lak::forward<ARGS>(args)...);
+	}
+
+	static data_ref_ptr_t make_data_ref_ptr(
+	  lak::array<byte_t> data, std::shared_ptr<decode_arena_t> arena = {})
+	{
+		FUNCTION_CHECKPOINT();
+		if (!arena) arena = std::make_shared<decode_arena_t>();
+		return allocate_data_ref_ptr(arena, lak::move(data), arena);
+	}
+
+	static data_ref_ptr_t make_data_ref_ptr(
+	  std::shared_ptr<mapped_file_t> mapping,
+	  std::shared_ptr<decode_arena_t> arena = {})
 	{
 		FUNCTION_CHECKPOINT();
-		return std::make_shared<_data_ref>(lak::move(data));
+		if (!arena) arena = std::make_shared<decode_arena_t>();
+		return allocate_data_ref_ptr(arena, lak::move(mapping), arena);
 	}
 
 	static data_ref_ptr_t make_data_ref_ptr(data_ref_ptr_t parent,
@@ -386,7 +524,19 @@ namespace SourceExplorer
 	                                        lak::array<byte_t> data)
 	{
 		FUNCTION_CHECKPOINT();
-		return std::make_shared<_data_ref>(parent, offset, count, lak::move(data));
+		return allocate_data_ref_ptr(
+		  parent->_arena, parent, offset, count, lak::move(data));
+	}
+
+	static data_ref_ptr_t make_data_ref_ptr(data_ref_ptr_t parent,
+	                                        size_t offset,
+	                                        size_t count,
+	                                        arena_buffer_t data)
+	{
+		FUNCTION_CHECKPOINT();
+		auto arena = data.arena();
+		return allocate_data_ref_ptr(
+		  arena, parent, offset, count, lak::move(data));
 	}
 
 	struct data_ref_span_t : lak::span<byte_t>
@@ -412,23 +562,52 @@ namespace SourceExplorer
 			FUNCTION_CHECKPOINT("data_ref_span_t::");
 			if (!_source || !_source->_parent) return {};
 			return data_ref_span_t(_source->_parent,
-			                       _source->_parent_span.begin() -
-			                         _source->_parent->_data.begin(),
+			                       _source->_parent_span.data() -
+			                         _source->_parent->data(),
 			                       _source->_parent_span.size());
 		}
 
-		lak::result<size_t> position() const
+		// Offset of this span into its source. Windows of a windowed file are
+		// offset by their position in the file so positions stay unique.
+		lak::result<uint64_t> position() const
 		{
 			if (!_source) return lak::err_t{};
-			return lak::ok_t{size_t(data() - _source->data())};
+			return lak::ok_t{uint64_t(data() - _source->data()) +
+			                 _source->file_offset()};
+		}
+
+		// Whether this span points straight into a window of a windowed file.
+		bool in_window() const
+		{
+			return _source && _source->_mapping &&
+			       _source->_mapping->windowed();
 		}
 
-		lak::result<size_t> root_position() const
+		lak::result<uint64_t> root_position() const
 		{
 			if (!_source) return lak::err_t{};
-			if (!_source->_parent)
-				return lak::ok_t{size_t(data() - _source->data())};
-			return parent_span().root_position();
+			if (!_source->_parent) return position();
+			return root_span().position();
+		}
+
+		// The span of the root buffer (usually the game file) that this span
+		// was decoded from, or this span itself if it is already in the root.
+		data_ref_span_t root_span() const
+		{
+			if (!_source || !_source->_parent) return *this;
+			return data_ref_span_t(_source->_root,
+			                       _source->_root_span.data() -
+			                         _source->_root->data(),
+			                       _source->_root_span.size());
+		}
+
+		// Identifies this span across loads of the same file.
+		index_key_t index_key() const
+		{
+			if (!_source) return {UINT64_MAX, UINT64_MAX};
+			if (!_source->_parent) return {0, position().UNWRAP()};
+			return {data_ref_span_t(_source).root_position().UNWRAP(),
+			        position().UNWRAP()};
 		}
 
 		void reset()
@@ -439,6 +618,35 @@ namespace SourceExplorer
 		}
 	};
 
+	// Start a buffer for data decoded from span, allocated from the same arena
+	// as span's source.
+	static arena_buffer_t make_decode_buffer(const data_ref_span_t &span)
+	{
+		if (span._source && span._source->_arena)
+			return arena_buffer_t(span._source->_arena);
+		return arena_buffer_t(std::make_shared<decode_arena_t>());
+	}
+
+	static data_ref_ptr_t make_data_ref_ptr(data_ref_span_t parent,
+	                                        arena_buffer_t data)
+	{
+		FUNCTION_CHECKPOINT();
+		if (!parent._source)
+		{
+			auto arena = data.arena();
+			return allocate_data_ref_ptr(arena, lak::move(data));
+		}
+		else
+		{
+			auto arena = data.arena();
+			return allocate_data_ref_ptr(arena,
+			                             parent._source,
+			                             parent.data() - parent._source->data(),
+			                             parent.size(),
+			                             lak::move(data));
+		}
+	}
+
 	static data_ref_ptr_t make_data_ref_ptr(data_ref_span_t parent,
 	                                        lak::array<byte_t> data)
 	{
@@ -446,26 +654,210 @@ namespace SourceExplorer
 		if (!parent._source)
 			return make_data_ref_ptr(lak::move(data));
 		else
-			return std::make_shared<_data_ref>(parent._source,
-			                                   parent.position().unwrap(),
-			                                   parent.size(),
-			                                   lak::move(data));
+			return allocate_data_ref_ptr(parent._source->_arena,
+			                             parent._source,
+			                             parent.data() - parent._source->data(),
+			                             parent.size(),
+			                             lak::move(data));
 	}
 
 	static data_ref_ptr_t copy_data_ref_ptr(data_ref_span_t parent)
 	{
 		FUNCTION_CHECKPOINT();
-		if (!parent._source)
-			return {};
-		else
-			return make_data_ref_ptr(
-			  parent, lak::array<byte_t>(parent.begin(), parent.end()));
+		if (!parent._source) return {};
+		auto buffer = make_decode_buffer(parent);
+		buffer.append(parent);
+		return make_data_ref_ptr(parent, lak::move(buffer));
 	}
 
+	struct data_reader_t;
+
+	// Holds on to a span without keeping a window of a windowed file mapped.
+	// Spans into any other buffer are kept as they are. Spans into a window
+	// are reduced to their file position and size, and get() maps them again
+	// (sharing any window that is still mapped).
+	struct lazy_span_t
+	{
+		lazy_span_t() = default;
+		lazy_span_t(const data_ref_span_t &span);
+		// [offset, offset + size) of file, without mapping it.
+		lazy_span_t(std::shared_ptr<windowed_file_t> file,
+		            std::shared_ptr<decode_arena_t> arena,
+		            uint64_t offset,
+		            size_t size);
+
+		// Empty if the span is empty or its window could not be mapped.
+		data_ref_span_t get() const;
+
+		// A reader over the span. For a span into a window this reads the file
+		// a window at a time instead of mapping the whole span at once.
+		data_reader_t reader() const;
+
+		inline size_t size() const { return _size; }
+		inline bool empty() const { return _size == 0; }
+		// UINT64_MAX if there is no span.
+		uint64_t position() const;
+		index_key_t index_key() const;
+		void reset();
+
+	private:
+		data_ref_span_t _span;
+		std::shared_ptr<windowed_file_t> _file;
+		std::shared_ptr<decode_arena_t> _arena;
+		uint64_t _offset = 0;
+		size_t _size     = 0;
+	};
+
+	struct pack_file_t
+	{
+		std::u16string filename;
+		// Points straight into the game file, use copy_data() if a separate
+		// copy is actually needed.
+		lazy_span_t data;
+		bool wide;
+		uint32_t bingo;
+
+		lak::array<byte_t> copy_data() const
+		{
+			const auto span = data.get();
+			return lak::array<byte_t>(span.begin(), span.end());
+		}
+	};
+
+	// Game wide cache of decoded entry data, so viewing or dumping the same
+	// entry again doesn't inflate/decrypt it again. Least recently used
+	// results are dropped once the decoded bytes held exceed the budget.
+	struct decode_cache_t
+	{
+		static constexpr size_t default_budget = 0x10000000; // 256MiB
+
+		struct key_t
+		{
+			// The raw (encoded) data the result was decoded from: its address,
+			// or its file position if it was read from a windowed file (where
+			// the same data can be mapped at a different address each time).
+			uint64_t data;
+			size_t size;
+			size_t max_size;
+			bool head;
+			// A paused decode rather than a result.
+			bool partial = false;
+			bool in_file = false;
+
+			bool operator==(const key_t &) const = default;
+		};
+
+		struct key_hash_t
+		{
+			size_t operator()(const key_t &key) const
+			{
+				return std::hash<uint64_t>{}(key.data) ^
+				       (key.size * 0x9E3779B97F4A7C15ULL) ^ (key.max_size << 3) ^
+				       (size_t(key.in_file) << 2) ^ (size_t(key.partial) << 1) ^
+				       size_t(key.head);
+			}
+		};
+
+		struct stats_t
+		{
+			size_t hits      = 0;
+			size_t misses    = 0;
+			size_t evictions = 0;
+			size_t entries   = 0;
+			size_t bytes     = 0;
+			size_t budget    = 0;
+		};
+
+		static key_t make_key(const data_ref_span_t &raw,
+		                      size_t max_size,
+		                      bool head,
+		                      bool partial = false)
+		{
+			if (raw.in_window())
+				return {
+				  raw.position().UNWRAP(), raw.size(), max_size, head, partial, true};
+			return {uint64_t(reinterpret_cast<uintptr_t>(raw.data())),
+			        raw.size(),
+			        max_size,
+			        head,
+			        partial};
+		}
+
+		static key_t make_partial_key(const data_ref_span_t &raw, bool head)
+		{
+			return make_key(raw, SIZE_MAX, head, true);
+		}
+
+		decode_cache_t(size_t budget = default_budget) : _budget(budget) {}
+		decode_cache_t(const decode_cache_t &) = delete;
+		decode_cache_t &operator=(const decode_cache_t &) = delete;
+
+		// Returns the cached result and marks it most recently used.
+		std::optional<data_ref_span_t> find(const key_t &key);
+
+		// raw is kept alongside the result so the memory key.data points to
+		// can't be freed (and reused) while the entry is cached. Windows are
+		// never kept, their keys are file positions which can't be reused.
+		void insert(const key_t &key,
+		            const data_ref_span_t &raw,
+		            const data_ref_span_t &result);
+
+		// Park a stream that was only inflated part way, so decoding the rest
+		// later can carry on from where it stopped. Counts against the budget
+		// like any other entry.
+		void insert_partial(const key_t &key,
+		                    const data_ref_span_t &raw,
+		                    std::shared_ptr<partial_inflate_t> partial);
+
+		// Remove and return the paused stream for key, if it is still cached.
+		std::shared_ptr<partial_inflate_t> take_partial(const key_t &key);
+
+		void set_budget(size_t budget);
+		void clear();
+		stats_t stats() const;
+
+	private:
+		struct entry_t
+		{
+			key_t key;
+			data_ref_span_t raw;
+			data_ref_span_t result;
+			std::shared_ptr<partial_inflate_t> partial;
+			size_t bytes;
+		};
+
+		void insert_entry(entry_t entry);
+
+		void evict();
+
+		mutable std::mutex _mutex;
+		std::list<entry_t> _lru; // Most recently used first.
+		std::unordered_map<key_t, std::list<entry_t>::iterator, key_hash_t>
+		  _entries;
+		size_t _budget    = default_budget;
+		size_t _bytes     = 0;
+		size_t _hits      = 0;
+		size_t _misses    = 0;
+		size_t _evictions = 0;
+	};
+
 	struct data_reader_t : lak::binary_reader
 	{
+		// Minimum number of bytes kept paged in ahead of the read head when
+		// reading a windowed file, so small reads never straddle two windows.
+		static constexpr size_t window_margin = 0x10000;
+
 		data_ref_ptr_t _source;
 
+		// Only set when reading straight from a windowed file, _source is then
+		// the current window. The reader only sees [_start, _end) of the file
+		// and _base is the file offset the current (clipped) window starts at.
+		std::shared_ptr<windowed_file_t> _file = {};
+		std::shared_ptr<decode_arena_t> _arena = {};
+		uint64_t _base                         = 0;
+		uint64_t _start                        = 0;
+		uint64_t _end                          = 0;
+
 		data_reader_t(data_ref_ptr_t src)
 		: lak::binary_reader(src ? lak::span<const byte_t>(src->get())
 		                         : lak::span<const byte_t>()),
@@ -478,11 +870,64 @@ namespace SourceExplorer
 		{
 		}
 
+		// Reads [start, start + size) of file, nothing is mapped until the
+		// first seek() or ensure().
+		data_reader_t(std::shared_ptr<windowed_file_t> file,
+		              std::shared_ptr<decode_arena_t> arena,
+		              uint64_t start = 0,
+		              uint64_t size  = UINT64_MAX)
+		: lak::binary_reader(lak::span<const byte_t>()),
+		  _file(lak::move(file)),
+		  _arena(lak::move(arena))
+		{
+			ASSERT(_file);
+			_start = std::min(start, _file->size());
+			_end   = _start + std::min(size, _file->size() - _start);
+			_base  = _start;
+		}
+
+		inline bool windowed() const { return bool(_file); }
+
+		// position, size, seek, skip and empty are relative to the whole range
+		// when windowed, remaining() is always relative to the current window.
+		inline uint64_t position() const
+		{
+			return _base - _start + lak::binary_reader::position();
+		}
+
+		inline uint64_t size() const
+		{
+			return _file ? _end - _start : lak::binary_reader::size();
+		}
+
+		inline bool empty() const
+		{
+			return _file ? position() >= size() : lak::binary_reader::empty();
+		}
+
+		lak::result<> seek(uint64_t pos);
+
+		inline lak::result<> skip(uint64_t count)
+		{
+			return seek(position() + count);
+		}
+
+		// Make sure at least count bytes past the read head are paged in,
+		// mapping a new window at the read head if they are not. Spans taken
+		// from the reader never cross windows, read_ref_span() calls this
+		// itself but anything else that will be kept as a span must call it
+		// first. Does nothing if the reader is not windowed.
+		lak::result<> ensure(size_t count);
+
+		// Replace the current window with one covering at least
+		// [pos, pos + count) and move the read head to pos.
+		lak::result<> map_window(uint64_t pos, size_t count);
+
 		data_ref_span_t peek_remaining_ref_span(size_t max_size = SIZE_MAX)
 		{
 			FUNCTION_CHECKPOINT("data_reader_t::");
 			ASSERT(_source);
-			const size_t offset = remaining().begin() - _source->_data.data();
+			const size_t offset = remaining().data() - _source->data();
 			const size_t size   = std::min(remaining().size(), max_size);
 			DEBUG("Offset: ", offset);
 			DEBUG("Size: ", size);
@@ -492,9 +937,10 @@ namespace SourceExplorer
 		lak::result<data_ref_span_t> read_ref_span(size_t size)
 		{
 			FUNCTION_CHECKPOINT("data_reader_t::");
+			if (_file && ensure(size).is_err()) return lak::err_t{};
 			if (!_source) return lak::err_t{};
 			if (size > remaining().size()) return lak::err_t{};
-			const size_t offset = remaining().begin() - _source->_data.data();
+			const size_t offset = remaining().data() - _source->data();
 			skip(size).UNWRAP();
 			return lak::ok_t{data_ref_span_t(_source, offset, size)};
 		}
@@ -503,7 +949,7 @@ namespace SourceExplorer
 		{
 			FUNCTION_CHECKPOINT("data_reader_t::");
 			ASSERT(_source);
-			const size_t offset = remaining().begin() - _source->_data.data();
+			const size_t offset = remaining().data() - _source->data();
 			const size_t size   = std::min(remaining().size(), max_size);
 			DEBUG("Offset: ", offset);
 			DEBUG("Size: ", size);
@@ -511,6 +957,20 @@ namespace SourceExplorer
 			return data_ref_span_t(_source, offset, size);
 		}
 
+		// Like read_ref_span, but a windowed reader skips over the span without
+		// mapping it.
+		lak::result<lazy_span_t> read_lazy_span(size_t size)
+		{
+			FUNCTION_CHECKPOINT("data_reader_t::");
+			if (!_file)
+				return read_ref_span(size).map([](const data_ref_span_t &span)
+				                               { return lazy_span_t(span); });
+			if (size > this->size() - position()) return lak::err_t{};
+			lazy_span_t result(_file, _arena, _start + position(), size);
+			if (skip(size).is_err()) return lak::err_t{};
+			return lak::ok_t{lak::move(result)};
+		}
+
 		lak::result<data_ref_ptr_t> read_ref_ptr(size_t size)
 		{
 			FUNCTION_CHECKPOINT("data_reader_t::");
@@ -528,7 +988,7 @@ namespace SourceExplorer
 		{
 			FUNCTION_CHECKPOINT("data_reader_t::");
 			ASSERT(_source);
-			const size_t offset = remaining().begin() - _source->_data.data();
+			const size_t offset = remaining().data() - _source->data();
 			const size_t size   = std::min(remaining().size(), max_size);
 			skip(size).UNWRAP();
 			return make_data_ref_ptr(_source, offset, size, lak::move(data));
@@ -537,14 +997,11 @@ namespace SourceExplorer
 
 	struct data_point_t
 	{
-		data_ref_span_t data;
+		lazy_span_t data;
 		size_t expected_size;
-		size_t position() const
-		{
-			return lak::ok_or_err(
-			  data.position().map_err([](auto &&) -> size_t { return SIZE_MAX; }));
-		}
-		result_t<data_ref_span_t> decode(const chunk_t ID,
+		uint64_t position() const { return data.position(); }
+		result_t<data_ref_span_t> decode(const decryption_t &decryption,
+		                                 const chunk_t ID,
 		                                 const encoding_t mode) const;
 	};
 
@@ -558,20 +1015,26 @@ namespace SourceExplorer
 		encoding_t mode;
 		bool old;
 
-		data_ref_span_t ref_span;
+		lazy_span_t ref_span;
 		data_point_t head;
 		data_point_t body;
+		// Shared with every other entry in the game, set by read().
+		std::shared_ptr<decode_cache_t> cache;
+		std::shared_ptr<const decryption_t> decryption;
 
-		size_t position() const
-		{
-			return lak::ok_or_err(ref_span.position().map_err([](auto &&) -> size_t
-			                                                  { return SIZE_MAX; }));
-		}
+		uint64_t position() const { return ref_span.position(); }
 
-		const data_ref_span_t &raw_head() const;
-		const data_ref_span_t &raw_body() const;
+		data_ref_span_t raw_head() const;
+		data_ref_span_t raw_body() const;
+		// Reads the raw body without mapping all of it at once (see
+		// lazy_span_t::reader), banks should be read through this.
+		data_reader_t body_reader() const;
 		result_t<data_ref_span_t> decode_head(size_t max_size = SIZE_MAX) const;
 		result_t<data_ref_span_t> decode_body(size_t max_size = SIZE_MAX) const;
+
+	private:
+		result_t<data_ref_span_t> decode_head_uncached(size_t max_size) const;
+		result_t<data_ref_span_t> decode_body_uncached(size_t max_size) const;
 	};
 
 	struct chunk_entry_t : public basic_entry_t
@@ -715,7 +1178,7 @@ namespace SourceExplorer
 	struct binary_file_t
 	{
 		lak::u8string name;
-		data_ref_span_t data;
+		lazy_span_t data;
 
 		error_t read(game_t &game, data_reader_t &strm);
 		error_t view(source_explorer_t &srcexp) const;
@@ -1198,19 +1661,36 @@ namespace SourceExplorer
 	{
 		struct item_t : public basic_item_t
 		{
-			uint32_t checksum; // uint16_t for old
-			uint32_t reference;
-			uint32_t data_size;
-			lak::vec2u16_t size;
-			graphics_mode_t graphics_mode; // uint8_t
-			image_flag_t flags;            // uint8_t
-			uint16_t unknown;              // not for old
-			lak::vec2u16_t hotspot;
-			lak::vec2u16_t action;
-			lak::color4_t transparent; // not for old
-			size_t data_position;
+			// The header is read lazily when the bank is lazy loaded, see
+			// load_header.
+			mutable uint32_t checksum; // uint16_t for old
+			mutable uint32_t reference;
+			mutable uint32_t data_size;
+			mutable lak::vec2u16_t size;
+			mutable graphics_mode_t graphics_mode; // uint8_t
+			mutable image_flag_t flags;            // uint8_t
+			mutable uint16_t unknown;              // not for old
+			mutable lak::vec2u16_t hotspot;
+			mutable lak::vec2u16_t action;
+			mutable lak::color4_t transparent; // not for old
+			mutable size_t data_position;
+			mutable bool header_loaded = false;
+			// Set by view() so a header that can't be decoded isn't retried
+			// (and logged) every frame.
+			mutable bool header_failed = false;
 
 			error_t read(game_t &game, data_reader_t &strm);
+			// read() in two steps, scan() finds where the item ends so the
+			// next one can be scanned, parse() reads the rest (i.e. the
+			// header) and can run on any thread once scan() has.
+			error_t scan(game_t &game, data_reader_t &strm);
+			error_t parse(const game_t &game);
+			error_t load_header() const;
+			error_t read_header(data_ref_span_t span,
+			                    bool old_game,
+			                    bool two_five_plus_game) const;
+			void load_record(const image_record_t &record) const;
+			image_record_t record() const;
 			error_t view(source_explorer_t &srcexp) const;
 
 			result_t<data_ref_span_t> image_data() const;
@@ -1231,6 +1711,7 @@ namespace SourceExplorer
 			std::unique_ptr<end_t> end;
 
 			error_t read(game_t &game, data_reader_t &strm);
+			error_t load_headers() const;
 			error_t view(source_explorer_t &srcexp) const;
 		};
 	}
@@ -1404,15 +1885,56 @@ namespace SourceExplorer
 		error_t view(source_explorer_t &srcexp) const;
 	};
 
+	// A fraction that one thread updates while others watch it. Copying just
+	// takes the current value, so game_t can still be reassigned.
+	struct progress_t
+	{
+		std::atomic<float> value = 0.0f;
+
+		progress_t() = default;
+		progress_t(const progress_t &other) : value(other.load()) {}
+
+		progress_t &operator=(const progress_t &other)
+		{
+			value = other.load();
+			return *this;
+		}
+
+		progress_t &operator=(float v)
+		{
+			value = v;
+			return *this;
+		}
+
+		inline float load() const { return value; }
+		inline operator float() const { return value; }
+	};
+
 	struct game_t
 	{
-		static std::atomic<float> completed;
-		static std::atomic<float> bank_completed;
+		// How far through loading this game, and its current bank, is.
+		progress_t completed;
+		progress_t bank_completed;
 
 		lak::astring game_path;
 		lak::astring game_dir;
 
+		// Every buffer loaded or decoded from this game is allocated from here.
+		std::shared_ptr<decode_arena_t> arena =
+		  std::make_shared<decode_arena_t>();
+
+		// Decoded entry data, shared by every entry read from this game.
+		std::shared_ptr<decode_cache_t> decode_cache =
+		  std::make_shared<decode_cache_t>();
+
+		// Shared by every entry read from this game, the key and table are
+		// generated once (by GetEncryptionKey) and only read after that.
+		std::shared_ptr<decryption_t> decryption =
+		  std::make_shared<decryption_t>();
+
 		data_ref_ptr_t file;
+		// Set instead of file when the game is too large to map in one piece.
+		std::shared_ptr<windowed_file_t> windowed_file;
 
 		lak::array<pack_file_t> pack_files;
 		uint64_t data_pos;
@@ -1433,8 +1955,16 @@ namespace SourceExplorer
 		bool recompiled         = false;
 		bool two_five_plus_game = false;
 		bool ccn                = false;
+		bool lazy_banks         = false;
 		lak::array<uint8_t> protection;
 
+		// Loaded from the sidecar index if it matched the file, otherwise
+		// built up while parsing (if build_index is set) and saved once the
+		// game has loaded.
+		chunk_index_t index;
+		bool index_loaded = false;
+		bool build_index  = false;
+
 		header_t game;
 
 		lak::u16string project;
@@ -1445,11 +1975,46 @@ namespace SourceExplorer
 		std::unordered_map<uint16_t, size_t> object_handles;
 	};
 
+	// A load or dump running on the thread pool.
+	struct job_t
+	{
+		using clock_t = std::chrono::steady_clock;
+
+		std::string name;
+		std::atomic<float> completed = 0.0f;
+		// Files written so far and their total size, and the number of files
+		// that failed to be written.
+		std::atomic<size_t> items  = 0;
+		std::atomic<size_t> bytes  = 0;
+		std::atomic<size_t> failed = 0;
+		clock_t::time_point start = clock_t::now();
+		std::atomic<double> seconds = -1.0; // Set by finish().
+		future_t<error_t> result;
+
+		inline bool running() const { return !result.ready(); }
+
+		inline void finish()
+		{
+			seconds = std::chrono::duration<double>(clock_t::now() - start).count();
+		}
+
+		// Seconds the job has been running for, or ran for once finished.
+		inline double elapsed() const
+		{
+			if (const double result = seconds; result >= 0.0) return result;
+			return std::chrono::duration<double>(clock_t::now() - start).count();
+		}
+	};
+
 	struct file_state_t
 	{
 		fs::path path;
 		bool valid;
 		bool attempt;
+		// The job currently using path, if any.
+		std::shared_ptr<job_t> job;
+
+		inline bool busy() const { return job && job->running(); }
 	};
 
 	struct source_explorer_t
@@ -1461,6 +2026,15 @@ namespace SourceExplorer
 		bool loaded                 = false;
 		bool baby_mode              = true;
 		bool dump_color_transparent = true;
+		bool lazy_load              = false;
+		bool cache_index            = false;
+		bool windowed_load          = false;
+		bool force_compat           = false;
+		size_t decode_cache_budget  = decode_cache_t::default_budget;
+		// Bytes the game may decode into its arena, 0 for no limit. Loading
+		// and decoding fail with error::over_budget once it's exceeded.
+		size_t memory_budget        = 0;
+		image_encoding_t image_encoding;
 		file_state_t exe;
 		file_state_t images;
 		file_state_t sorted_images;
@@ -1468,6 +2042,7 @@ namespace SourceExplorer
 		file_state_t music;
 		file_state_t shaders;
 		file_state_t binary_files;
+		file_state_t pack_files;
 		file_state_t appicon;
 		file_state_t error_log;
 		file_state_t binary_block;
@@ -1476,13 +2051,40 @@ namespace SourceExplorer
 
 		const basic_entry_t *view = nullptr;
 		texture_t image;
+		// Image still being decoded on the pool, ViewImage uploads it to
+		// image once it is ready.
+		future_t<result_t<lak::image4_t>> pending_image;
 		data_ref_span_t buffer;
+
+		// Dumps started this session, shown in the jobs window.
+		std::vector<std::shared_ptr<job_t>> jobs;
+
+		// Whether any dump is still running, a new game can't be loaded until
+		// they have all finished.
+		bool jobs_running() const;
 	};
 
+	// Map path into memory, falling back to reading the whole file if it
+	// cannot be mapped.
+	result_t<data_ref_ptr_t> OpenFile(
+	  const fs::path &path, std::shared_ptr<decode_arena_t> arena = {});
+
 	error_t LoadGame(source_explorer_t &srcexp);
 
+	// Drop the loaded game (if any) without freeing each of its buffers one
+	// at a time, see decode_arena_t::abandon.
+	void UnloadGame(source_explorer_t &srcexp);
+
+	// Pick the decryption mode (and magic char) for game_state's product
+	// build, must be done before GetEncryptionKey.
+	void SetDecryptionMode(game_t &game_state);
+
 	void GetEncryptionKey(game_t &game_state);
 
+	// The extra obfuscation XOR-ed over the first byte of an encrypted chunk,
+	// 0 if ID doesn't have any.
+	uint8_t ChunkIDXor(const decryption_t &decryption, chunk_t ID);
+
 	error_t ParsePEHeader(data_reader_t &strm);
 
 	error_t ParseGameHeader(data_reader_t &strm, game_t &game_state);
@@ -1500,14 +2102,19 @@ namespace SourceExplorer
 
 	const char *GetObjectParentTypeString(object_parent_type_t type);
 
-	result_t<data_ref_span_t> Decode(data_ref_span_t encoded,
+	result_t<data_ref_span_t> Decode(const decryption_t &decryption,
+	                                 data_ref_span_t encoded,
 	                                 chunk_t ID,
-	                                 encoding_t mode);
+	                                 encoding_t mode,
+	                                 size_t size_hint = 0);
 
+	// size_hint is the expected inflated size (0 if unknown), the output is
+	// allocated up front from it instead of growing as the stream is read.
 	result_t<data_ref_span_t> Inflate(data_ref_span_t compressed,
 	                                  bool skip_header,
 	                                  bool anaconda,
-	                                  size_t max_size = SIZE_MAX);
+	                                  size_t max_size  = SIZE_MAX,
+	                                  size_t size_hint = 0);
 
 	result_t<data_ref_span_t> LZ4Decode(data_ref_span_t compressed,
 	                                    unsigned int out_size);
@@ -1517,7 +2124,8 @@ namespace SourceExplorer
 	result_t<data_ref_span_t> StreamDecompress(data_reader_t &strm,
 	                                           unsigned int out_size);
 
-	result_t<data_ref_span_t> Decrypt(data_ref_span_t encrypted,
+	result_t<data_ref_span_t> Decrypt(const decryption_t &decryption,
+	                                  data_ref_span_t encrypted,
 	                                  chunk_t ID,
 	                                  encoding_t mode);
 
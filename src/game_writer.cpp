@@ -0,0 +1,1270 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "game_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace SourceExplorer
+{
+	const char *game_layout_name(game_layout_t layout)
+	{
+		switch (layout)
+		{
+			case game_layout_t::old: return "old";
+			case game_layout_t::ascii: return "ascii";
+			case game_layout_t::unicode: return "unicode";
+			case game_layout_t::two_five_plus: return "2.5+";
+			default: return "invalid";
+		}
+	}
+
+	namespace
+	{
+		using rng_t = std::mt19937_64;
+
+		template<typename CONTAINER>
+		lak::span<const byte_t> AsBytes(const CONTAINER &container)
+		{
+			return lak::span<const byte_t>(container.data(), container.size());
+		}
+
+		struct pixel_t
+		{
+			uint8_t r, g, b, a;
+		};
+
+		enum struct item_kind_t : uint64_t
+		{
+			image,
+			pack_file,
+			binary_file,
+			object,
+			frame,
+			sound,
+		};
+
+		// Independent generator for item index of a kind in the game seeded
+		// with seed, so items can be generated in any order (or in parallel).
+		rng_t ItemRNG(uint64_t seed, item_kind_t kind, size_t index)
+		{
+			return rng_t(seed ^ (0x9E3779B97F4A7C15ULL * (index + 1)) ^
+			             (uint64_t(kind) << 56));
+		}
+
+		std::u16string Numbered(std::u16string prefix, size_t number)
+		{
+			for (const char c : std::to_string(number)) prefix += char16_t(c);
+			return prefix;
+		}
+
+		// A transparent background with a few solid and gradient filled
+		// rectangles on it, speckled with noise so it doesn't compress to
+		// nothing.
+		std::vector<pixel_t> SyntheticPixels(size_t width,
+		                                     size_t height,
+		                                     rng_t &rng)
+		{
+			std::vector<pixel_t> pixels(width * height, pixel_t{0, 0, 0, 0});
+
+			for (size_t shapes = 1 + rng() % 4; shapes-- > 0;)
+			{
+				const size_t x0       = rng() % width;
+				const size_t y0       = rng() % height;
+				const size_t x1       = x0 + 1 + rng() % (width - x0);
+				const size_t y1       = y0 + 1 + rng() % (height - y0);
+				const uint64_t colour = rng();
+				const bool gradient   = ((colour >> 32) & 1) != 0;
+				for (size_t y = y0; y < y1; ++y)
+				{
+					for (size_t x = x0; x < x1; ++x)
+					{
+						pixel_t &pixel = pixels[(y * width) + x];
+						pixel.r        = uint8_t(colour);
+						pixel.g        = uint8_t(colour >> 8);
+						pixel.b        = uint8_t(colour >> 16);
+						pixel.a        = uint8_t((colour >> 24) | 0x80);
+						if (gradient)
+						{
+							pixel.r = uint8_t(pixel.r + (x * 4));
+							pixel.g = uint8_t(pixel.g + (y * 4));
+						}
+					}
+				}
+			}
+
+			for (size_t speckles = pixels.size() / 16; speckles-- > 0;)
+			{
+				const uint64_t colour = rng();
+				pixels[rng() % pixels.size()] = {uint8_t(colour),
+				                                 uint8_t(colour >> 8),
+				                                 uint8_t(colour >> 16),
+				                                 uint8_t(colour >> 24)};
+			}
+
+			return pixels;
+		}
+
+		// Lines of random bytes, most of them repeats of a recent line, which
+		// compresses a few times over like real game data does.
+		void FillerBytes(lak::span<byte_t> out, rng_t &rng)
+		{
+			const size_t line = 64;
+			for (size_t i = 0; i < out.size(); i += line)
+			{
+				const size_t size = std::min(line, out.size() - i);
+				if (i >= line * 16 && rng() % 4 != 0)
+				{
+					const size_t from = i - (line * (1 + rng() % 16));
+					std::memmove(out.data() + i, out.data() + from, size);
+				}
+				else
+				{
+					for (size_t j = 0; j < size; ++j) out[i + j] = byte_t(rng());
+				}
+			}
+		}
+
+		// size bytes of filler, generated a block at a time so huge files are
+		// never held in memory. func is called with each block in order.
+		template<typename FUNC>
+		void ForEachFillerBlock(size_t size, rng_t &rng, FUNC &&func)
+		{
+			std::vector<byte_t> block(std::min<size_t>(size, 0x10000));
+			for (size_t done = 0; done < size;)
+			{
+				const size_t count = std::min(block.size(), size - done);
+				FillerBytes(lak::span<byte_t>(block.data(), count), rng);
+				func(lak::span<const byte_t>(block.data(), count));
+				done += count;
+			}
+		}
+
+		std::vector<byte_t> Deflate(lak::span<const byte_t> data)
+		{
+			vector_sink_t sink;
+			deflate_encoder_t encoder(deflate_level_t::fast, sink);
+			encoder.write(data);
+			encoder.finish();
+			return lak::move(sink.data);
+		}
+
+		void Encrypt(const decryption_t &decryption,
+		             chunk_t ID,
+		             std::vector<byte_t> &data)
+		{
+			if (data.empty()) return;
+			auto stream = decryption.stream();
+			ASSERT(stream);
+			// The keystream is just XOR-ed over the data, so encrypting is
+			// decrypting and then undoing the ID obfuscation.
+			stream->decode(AsBytes(data),
+			               lak::span<byte_t>(data.data(), data.size()));
+			data[0] = byte_t(uint8_t(data[0]) ^ ChunkIDXor(decryption, ID));
+		}
+
+		graphics_mode_t WritableMode(graphics_mode_t mode)
+		{
+			switch (mode)
+			{
+				case graphics_mode_t::RGB8:
+				case graphics_mode_t::BGR24:
+				case graphics_mode_t::RGB15:
+				case graphics_mode_t::RGB16:
+				case graphics_mode_t::BGRA32: return mode;
+				default: return graphics_mode_t::BGR24;
+			}
+		}
+
+		// The graphics mode as it is stored in image headers.
+		uint8_t GraphicsModeID(graphics_mode_t mode)
+		{
+			switch (mode)
+			{
+				case graphics_mode_t::RGB8: return 3;
+				case graphics_mode_t::RGB15: return 6;
+				case graphics_mode_t::RGB16: return 7;
+				case graphics_mode_t::BGRA32: return 8;
+				case graphics_mode_t::BGR24: [[fallthrough]];
+				default: return 4;
+			}
+		}
+
+		size_t PointSize(graphics_mode_t mode)
+		{
+			switch (mode)
+			{
+				case graphics_mode_t::RGB8: return 1;
+				case graphics_mode_t::RGB15:
+				case graphics_mode_t::RGB16: return 2;
+				case graphics_mode_t::BGRA32: return 4;
+				case graphics_mode_t::BGR24: [[fallthrough]];
+				default: return 3;
+			}
+		}
+
+		void WritePoint(lak::binary_array_writer &strm,
+		                const pixel_t &pixel,
+		                graphics_mode_t mode)
+		{
+			switch (mode)
+			{
+				case graphics_mode_t::RGB8:
+					strm.write_u8(uint8_t((pixel.r & 0xE0) | ((pixel.g & 0xE0) >> 3) |
+					                      (pixel.b >> 6)));
+					break;
+
+				case graphics_mode_t::RGB15:
+					strm.write_u16(uint16_t(((pixel.r >> 3) << 10) |
+					                        ((pixel.g >> 3) << 5) | (pixel.b >> 3)));
+					break;
+
+				case graphics_mode_t::RGB16:
+					strm.write_u16(uint16_t(((pixel.r >> 3) << 11) |
+					                        ((pixel.g >> 2) << 5) | (pixel.b >> 3)));
+					break;
+
+				case graphics_mode_t::BGRA32:
+					strm.write_u8(pixel.b);
+					strm.write_u8(pixel.g);
+					strm.write_u8(pixel.r);
+					strm.write_u8(pixel.a);
+					break;
+
+				case graphics_mode_t::BGR24: [[fallthrough]];
+				default:
+					strm.write_u8(pixel.b);
+					strm.write_u8(pixel.g);
+					strm.write_u8(pixel.r);
+					break;
+			}
+		}
+
+		bool HasFlag(image_flag_t flags, image_flag_t flag)
+		{
+			return (flags & flag) != image_flag_t::none;
+		}
+
+		// Pixel data laid out the way item_t::image reads it back: colour data
+		// (RLE or raw, rows padded), then the alpha plane, all wrapped in a
+		// zlib stream if the image is LZX flagged.
+		lak::array<byte_t> ImagePixelData(const synthetic_image_t &image,
+		                                  const std::vector<pixel_t> &pixels)
+		{
+			const size_t width      = image.width;
+			const size_t height     = image.height;
+			const auto mode         = image.graphics_mode;
+			const size_t point_size = PointSize(mode);
+
+			lak::binary_array_writer strm;
+			strm.reserve(height * ((width + 4) * (point_size + 1)) + 16);
+
+			if (HasFlag(image.flags,
+			            image_flag_t::RLE | image_flag_t::RLEW | image_flag_t::RLET))
+			{
+				// ReadRLE counts the row padding in points rather than bytes.
+				const size_t pad = lak::slack<size_t>(width * point_size, 4);
+				const size_t row = width + pad;
+				auto point       = [&](size_t i) -> const pixel_t &
+				{
+					const size_t x = std::min(i % row, width - 1);
+					return pixels[((i / row) * width) + x];
+				};
+				auto same = [&](size_t a, size_t b)
+				{
+					const pixel_t &l = point(a), &r = point(b);
+					return l.r == r.r && l.g == r.g && l.b == r.b && l.a == r.a;
+				};
+				auto run_length = [&](size_t i, size_t count)
+				{
+					size_t run = 1;
+					while (i + run < count && run < 128 && same(i, i + run)) ++run;
+					return run;
+				};
+
+				const size_t count = height * row;
+				for (size_t i = 0; i < count;)
+				{
+					if (const size_t run = run_length(i, count); run >= 3)
+					{
+						strm.write_u8(uint8_t(run));
+						WritePoint(strm, point(i), mode);
+						i += run;
+						continue;
+					}
+
+					size_t literals = 0;
+					while (i + literals < count && literals < 127 &&
+					       run_length(i + literals, count) < 3)
+						++literals;
+					strm.write_u8(uint8_t(128 + literals));
+					for (; literals-- > 0; ++i) WritePoint(strm, point(i), mode);
+				}
+				strm.write_u8(0);
+			}
+			else
+			{
+				const size_t pad = lak::slack<size_t>(width * point_size, 4);
+				for (size_t y = 0; y < height; ++y)
+				{
+					for (size_t x = 0; x < width; ++x)
+						WritePoint(strm, pixels[(y * width) + x], mode);
+					for (size_t p = 0; p < pad; ++p) strm.write_u8(0);
+				}
+			}
+
+			if (!HasFlag(image.flags, image_flag_t::RGBA) &&
+			    HasFlag(image.flags, image_flag_t::alpha))
+			{
+				const size_t pad = lak::slack<size_t>(width, 4);
+				for (size_t y = 0; y < height; ++y)
+				{
+					for (size_t x = 0; x < width; ++x)
+						strm.write_u8(pixels[(y * width) + x].a);
+					for (size_t p = 0; p < pad; ++p) strm.write_u8(0);
+				}
+			}
+
+			if (!HasFlag(image.flags, image_flag_t::LZX)) return strm.release();
+
+			const auto data       = strm.release();
+			const auto compressed = Deflate(AsBytes(data));
+			lak::binary_array_writer lzx;
+			lzx.reserve(compressed.size() + 8);
+			lzx.write_u32(uint32_t(data.size()));
+			lzx.write_u32(uint32_t(compressed.size()));
+			lzx.write(AsBytes(compressed));
+			return lzx.release();
+		}
+
+		// One image bank item, including its handle.
+		lak::array<byte_t> ImageItem(const game_spec_t &spec,
+		                             synthetic_image_t image,
+		                             size_t index)
+		{
+			const bool two_five_plus =
+			  spec.layout == game_layout_t::two_five_plus;
+
+			auto clear_flag = [&](image_flag_t flag)
+			{ image.flags = image.flags & image_flag_t(uint8_t(~uint8_t(flag))); };
+
+			image.width         = std::max<uint16_t>(image.width, 1);
+			image.height        = std::max<uint16_t>(image.height, 1);
+			image.graphics_mode = WritableMode(image.graphics_mode);
+			if (image.graphics_mode != graphics_mode_t::BGRA32)
+				clear_flag(image_flag_t::RGBA);
+			// 2.5+ images are LZ4 compressed as a whole, which is never
+			// combined with LZX.
+			if (two_five_plus) clear_flag(image_flag_t::LZX);
+
+			rng_t rng         = ItemRNG(spec.seed, item_kind_t::image, index);
+			const auto pixels = SyntheticPixels(image.width, image.height, rng);
+
+			const auto data        = ImagePixelData(image, pixels);
+			const auto pixels_span = AsBytes(data);
+
+			// New games (other than 2.5+) store every handle one higher.
+			const uint32_t handle =
+			  uint32_t(index) + (!two_five_plus && spec.product_build >= 284);
+
+			auto write_header = [&](lak::binary_array_writer &strm,
+			                        uint32_t data_size)
+			{
+				if (two_five_plus)
+				{
+					// Marks a 2.5+ (LZ4) item.
+					strm.write_u32(0xFF'FF'FF'FFU);
+					strm.write_u32(1); // reference
+					strm.write_u32(0);
+				}
+				else
+				{
+					strm.write_u32(uint32_t(rng())); // checksum
+					strm.write_u32(1);               // reference
+				}
+				strm.write_u32(data_size);
+				strm.write_u16(image.width);
+				strm.write_u16(image.height);
+				strm.write_u8(GraphicsModeID(image.graphics_mode));
+				strm.write_u8(uint8_t(image.flags));
+				strm.write_u16(0); // unknown
+				strm.write_u16(image.width / 2);
+				strm.write_u16(image.height / 2);
+				strm.write_u16(image.width);
+				strm.write_u16(image.height / 2);
+				// Transparent colour.
+				for (size_t i = 0; i < 4; ++i) strm.write_u8(0);
+			};
+
+			lak::binary_array_writer strm;
+			strm.write_u32(handle);
+
+			if (two_five_plus)
+			{
+				const auto compressed = LZ4EncodeBlock(pixels_span);
+				write_header(strm, uint32_t(compressed.size() + 4));
+				strm.write_u32(uint32_t(data.size()));
+				strm.write(AsBytes(compressed));
+			}
+			else
+			{
+				lak::binary_array_writer body;
+				body.reserve(data.size() + 32);
+				write_header(body, uint32_t(data.size()));
+				body.write(pixels_span);
+				const auto decompressed = body.release();
+				const auto compressed =
+				  Deflate(AsBytes(decompressed));
+				strm.write_u32(uint32_t(decompressed.size()));
+				strm.write_u32(uint32_t(compressed.size()));
+				strm.write(AsBytes(compressed));
+			}
+
+			return strm.release();
+		}
+
+		struct game_writer_t
+		{
+			const game_spec_t &spec;
+			byte_sink_t &sink;
+			size_t written = 0;
+			bool old_game;
+			bool unicode;
+			// Only the parts of a game GetEncryptionKey looks at are filled in.
+			game_t key_game;
+			bool can_encrypt = false;
+
+			game_writer_t(const game_spec_t &s, byte_sink_t &k)
+			: spec(s),
+			  sink(k),
+			  old_game(s.layout == game_layout_t::old),
+			  unicode(s.layout == game_layout_t::unicode ||
+			          s.layout == game_layout_t::two_five_plus)
+			{
+				key_game.old_game      = old_game;
+				key_game.unicode       = unicode;
+				key_game.product_build = spec.product_build;
+				SetDecryptionMode(key_game);
+				if (old_game) return;
+
+				// The key is made from the strings as the loader will read them
+				// back, which isn't quite what was asked for in ASCII games.
+				auto key_string = [&](auto &chunk, const std::u16string &str)
+				{
+					chunk        = std::make_unique<string_chunk_t>();
+					chunk->value = stored_string(str);
+				};
+				key_string(key_game.game.title, spec.title);
+				key_string(key_game.game.copyright, spec.copyright);
+				key_string(key_game.game.project_path, spec.project_path);
+				GetEncryptionKey(key_game);
+				can_encrypt = key_game.decryption->table.valid;
+				if (!can_encrypt)
+					WARNING("No Encryption Table For This Key, MODE2/3 Chunks Will "
+					        "Be Written As MODE0/1");
+			}
+
+			std::u16string stored_string(const std::u16string &str) const
+			{
+				if (unicode) return str;
+				std::u16string result = str;
+				for (auto &c : result)
+					if (c >= 0x80) c = u'?';
+				return result;
+			}
+
+			// The characters of str without a terminator, 16 bit in unicode
+			// games.
+			void write_chars(lak::binary_array_writer &strm,
+			                 const std::u16string &str) const
+			{
+				for (const char16_t c : stored_string(str))
+				{
+					if (unicode)
+						strm.write_u16(uint16_t(c));
+					else
+						strm.write_u8(uint8_t(c));
+				}
+			}
+
+			size_t chars_size(const std::u16string &str) const
+			{
+				return str.size() * (unicode ? 2 : 1);
+			}
+
+			lak::array<byte_t> string_data(const std::u16string &str) const
+			{
+				lak::binary_array_writer strm;
+				write_chars(strm, str);
+				if (unicode)
+					strm.write_u16(0);
+				else
+					strm.write_u8(0);
+				return strm.release();
+			}
+
+			void put(lak::span<const byte_t> bytes)
+			{
+				sink.write(bytes);
+				written += bytes.size();
+			}
+
+			encoding_t usable_mode(encoding_t mode, size_t size) const
+			{
+				mode = UsableMode(spec.layout, mode, size);
+				if (!can_encrypt && mode == encoding_t::mode2)
+					return encoding_t::mode0;
+				if (!can_encrypt && mode == encoding_t::mode3)
+					return encoding_t::mode1;
+				return mode;
+			}
+
+			static lak::array<byte_t> chunk_head(chunk_t ID,
+			                                     encoding_t mode,
+			                                     size_t body_size)
+			{
+				ASSERT(body_size <= UINT32_MAX);
+				lak::binary_array_writer strm;
+				strm.write_u16(uint16_t(ID));
+				strm.write_u16(uint16_t(mode));
+				strm.write_u32(uint32_t(body_size));
+				return strm.release();
+			}
+
+			// A whole chunk, header and all, as it is nested in the body of
+			// another chunk.
+			lak::array<byte_t> encode(chunk_t ID,
+			                          encoding_t mode,
+			                          lak::span<const byte_t> data) const
+			{
+				mode = usable_mode(mode, data.size());
+				const auto body =
+				  EncodeChunk(*key_game.decryption, ID, mode, old_game, data);
+				lak::binary_array_writer strm;
+				strm.reserve(body.size() + 8);
+				strm.write(AsBytes(chunk_head(ID, mode, body.size())));
+				strm.write(AsBytes(body));
+				return strm.release();
+			}
+
+			void chunk(chunk_t ID, encoding_t mode, lak::span<const byte_t> data)
+			{
+				put(AsBytes(encode(ID, mode, data)));
+			}
+
+			void string(chunk_t ID, encoding_t mode, const std::u16string &str)
+			{
+				chunk(ID, mode, AsBytes(string_data(str)));
+			}
+
+			// func(index) for every index in parallel.
+			template<typename FUNC>
+			std::vector<lak::array<byte_t>> build_items(size_t count,
+			                                            FUNC &&func) const
+			{
+				std::vector<lak::array<byte_t>> items(count);
+				parallel_for(count, [&](size_t index) { items[index] = func(index); });
+				return items;
+			}
+
+			// Banks themselves are never compressed or encrypted, their items
+			// are. Streamed straight out rather than copied into one body.
+			void bank(chunk_t ID, const std::vector<lak::array<byte_t>> &items)
+			{
+				size_t size = 4;
+				for (const auto &item : items) size += item.size();
+
+				put(AsBytes(chunk_head(ID, encoding_t::mode0, size)));
+				lak::binary_array_writer strm;
+				strm.write_u32(uint32_t(items.size()));
+				put(AsBytes(strm.release()));
+				for (const auto &item : items) put(AsBytes(item));
+			}
+
+			void pe_stub()
+			{
+				// The DOS header, PE headers and section table all fit in the
+				// first 0x200 bytes, .text fills the next 0x200 and .extra (the
+				// game) starts after that.
+				const uint32_t pe_offset    = 0x80;
+				const uint32_t text_offset  = 0x200;
+				const uint32_t extra_offset = 0x400;
+
+				lak::binary_array_writer strm;
+				strm.reserve(extra_offset);
+				auto zeros = [&](size_t count)
+				{
+					for (; count-- > 0;) strm.write_u8(0);
+				};
+
+				strm.write_u16(WIN_EXE_SIG);
+				zeros(WIN_EXE_PNT - 2);
+				strm.write_u32(pe_offset);
+				zeros(pe_offset - WIN_EXE_PNT - 4);
+
+				strm.write_u32(WIN_PE_SIG);
+				strm.write_u16(0x014C); // i386
+				strm.write_u16(2);      // section count
+				strm.write_u32(0);      // timestamp
+				strm.write_u32(0);      // symbol table
+				strm.write_u32(0);      // symbol count
+				strm.write_u16(0xE0);   // optional header size
+				strm.write_u16(0x0103); // 32 bit executable, no relocations
+				strm.write_u16(0x010B); // PE32
+				zeros(0xE0 - 2);
+
+				auto section = [&](const char(&name)[8],
+				                   uint32_t address,
+				                   uint32_t offset,
+				                   uint32_t size)
+				{
+					for (const char c : name) strm.write_u8(uint8_t(c));
+					strm.write_u32(size);    // virtual size
+					strm.write_u32(address); // virtual address
+					strm.write_u32(size);    // size of raw data
+					strm.write_u32(offset);  // pointer to raw data
+					zeros(0x0C);
+					strm.write_u32(0x60000020); // code, execute, read
+				};
+				section(".text\0\0", 0x1000, text_offset, 0x200);
+				section(".extra\0", 0x2000, extra_offset, 0);
+
+				zeros(text_offset - (pe_offset + 0x18 + 0xE0 + (2 * 0x28)));
+				for (size_t i = text_offset; i < extra_offset; ++i)
+					strm.write_u8(0xCC); // int3
+
+				put(AsBytes(strm.release()));
+			}
+
+			void pack_data()
+			{
+				// Unicode games always get a bingo: the loader's check for one
+				// skips names as if they were 8 bit, so can't find the PAMU
+				// after wide names without one.
+				const bool bingo           = unicode;
+				const uint32_t header_size = 0x20;
+
+				auto name = [&](size_t index)
+				{ return Numbered(u"synthetic_", index) + u".mfx"; };
+
+				size_t files_size = 0;
+				for (size_t i = 0; i < spec.pack_file_count; ++i)
+					files_size += 2 + chars_size(name(i)) + (bingo ? 4 : 0) + 4 +
+					              spec.pack_file_size;
+
+				lak::binary_array_writer strm;
+				strm.write_u64(HEADER_PACK);
+				strm.write_u32(header_size);
+				// Points the loader at the PAME/PAMU header after the files.
+				strm.write_u32(uint32_t(header_size + files_size + header_size));
+				strm.write_u32(1); // format version
+				strm.write_u32(0);
+				strm.write_u32(0);
+				strm.write_s32(int32_t(spec.pack_file_count));
+				put(AsBytes(strm.release()));
+
+				for (size_t i = 0; i < spec.pack_file_count; ++i)
+				{
+					rng_t rng           = ItemRNG(spec.seed, item_kind_t::pack_file, i);
+					const auto filename = name(i);
+					lak::binary_array_writer head;
+					head.write_u16(uint16_t(filename.size()));
+					write_chars(head, filename);
+					if (bingo) head.write_u32(uint32_t(rng()));
+					head.write_u32(uint32_t(spec.pack_file_size));
+					put(AsBytes(head.release()));
+					ForEachFillerBlock(spec.pack_file_size,
+					                   rng,
+					                   [&](lak::span<const byte_t> block)
+					                   { put(block); });
+				}
+			}
+
+			void game_header()
+			{
+				if (!old_game) pack_data();
+
+				lak::binary_array_writer strm;
+				strm.write_u32(unicode ? HEADER_UNIC : HEADER_GAME);
+				strm.write_u16(uint16_t(old_game ? product_code_t::MMF15
+				                                 : product_code_t::MMF2));
+				strm.write_u16(0); // runtime sub version
+				strm.write_u32(old_game ? 0 : 1);
+				strm.write_u32(spec.product_build);
+				const auto header = strm.release();
+				put(AsBytes(header));
+
+				// The application header, nothing reads its contents yet.
+				const byte_t app_header[0x70] = {};
+				chunk(chunk_t::header,
+				      encoding_t::mode0,
+				      lak::span<const byte_t>(app_header, sizeof(app_header)));
+			}
+
+			void strings()
+			{
+				string(chunk_t::title, encoding_t::mode0, spec.title);
+				string(chunk_t::copyright, encoding_t::mode0, spec.copyright);
+				string(
+				  chunk_t::project_path, encoding_t::mode0, spec.project_path);
+				string(chunk_t::author, spec.string_mode, u"Synthetic Author");
+				string(chunk_t::output_path,
+				       spec.string_mode,
+				       u"C:\\Synthetic\\Synthetic Game.exe");
+				string(chunk_t::about,
+				       spec.string_mode,
+				       u"Generated by Source Explorer for benchmarking.");
+			}
+
+			void binary_files()
+			{
+				const size_t count = std::max<size_t>(spec.binary_file_count, 1);
+				auto file_size     = [&](size_t index)
+				{
+					return (spec.binary_size / count) +
+					       (index < spec.binary_size % count ? 1 : 0);
+				};
+				auto file_head = [&](size_t index)
+				{
+					const auto name = Numbered(u"synthetic_", index) + u".bin";
+					lak::binary_array_writer strm;
+					strm.write_u16(uint16_t(name.size()));
+					write_chars(strm, name);
+					strm.write_u32(uint32_t(file_size(index)));
+					return strm.release();
+				};
+
+				lak::binary_array_writer count_data;
+				count_data.write_u32(uint32_t(count));
+				const auto count_head = count_data.release();
+
+				size_t size = count_head.size();
+				for (size_t i = 0; i < count; ++i)
+					size += file_head(i).size() + file_size(i);
+
+				const encoding_t mode = usable_mode(spec.binary_mode, size);
+
+				if (mode == encoding_t::mode0)
+				{
+					// Nothing to encode, so the files never need to be in memory.
+					put(AsBytes(chunk_head(chunk_t::binary_files, mode, size)));
+					put(AsBytes(count_head));
+					for (size_t i = 0; i < count; ++i)
+					{
+						put(AsBytes(file_head(i)));
+						rng_t rng = ItemRNG(spec.seed, item_kind_t::binary_file, i);
+						ForEachFillerBlock(file_size(i),
+						                   rng,
+						                   [&](lak::span<const byte_t> block)
+						                   { put(block); });
+					}
+					return;
+				}
+
+				lak::binary_array_writer strm;
+				strm.reserve(size);
+				strm.write(AsBytes(count_head));
+				for (size_t i = 0; i < count; ++i)
+				{
+					strm.write(AsBytes(file_head(i)));
+					rng_t rng = ItemRNG(spec.seed, item_kind_t::binary_file, i);
+					ForEachFillerBlock(file_size(i),
+					                   rng,
+					                   [&](lak::span<const byte_t> block)
+					                   { strm.write(block); });
+				}
+				const auto data = strm.release();
+				chunk(chunk_t::binary_files, mode, AsBytes(data));
+			}
+
+			void image_bank()
+			{
+				bank(chunk_t::image_bank,
+				     build_items(spec.images.size(),
+				                 [&](size_t index) {
+					                 return ImageItem(
+					                   spec, spec.images[index], index);
+				                 }));
+			}
+
+			// A backdrop object showing image index % image count.
+			lak::array<byte_t> object_item(size_t index) const
+			{
+				const size_t image =
+				  spec.images.empty() ? 0 : index % spec.images.size();
+				const synthetic_image_t shown =
+				  spec.images.empty() ? synthetic_image_t{} : spec.images[image];
+
+				lak::binary_array_writer header;
+				header.write_u16(uint16_t(index)); // handle
+				header.write_u16(uint16_t(object_type_t::backdrop));
+				header.write_u16(0); // flags
+				header.write_u16(0); // no longer used
+				header.write_u32(0); // ink effect
+				header.write_u32(0); // ink effect parameter
+
+				lak::binary_array_writer properties;
+				properties.write_u32(old_game ? 14 : 18); // size
+				properties.write_u16(0);                  // obstacle
+				properties.write_u16(0);                  // collision
+				if (old_game)
+				{
+					properties.write_u16(shown.width);
+					properties.write_u16(shown.height);
+				}
+				else
+				{
+					properties.write_u32(shown.width);
+					properties.write_u32(shown.height);
+				}
+				properties.write_u16(uint16_t(image));
+
+				lak::binary_array_writer strm;
+				strm.write(AsBytes(encode(chunk_t::object_header,
+				                          spec.item_mode,
+				                          AsBytes(header.release()))));
+				strm.write(AsBytes(
+				  encode(chunk_t::object_name,
+				         spec.item_mode,
+				         AsBytes(string_data(Numbered(u"Backdrop ", index))))));
+				strm.write(AsBytes(encode(chunk_t::object_properties,
+				                          spec.item_mode,
+				                          AsBytes(properties.release()))));
+				strm.write(AsBytes(encode(chunk_t::last, encoding_t::mode0, {})));
+				return strm.release();
+			}
+
+			void object_bank()
+			{
+				bank(chunk_t::object_bank,
+				     build_items(spec.object_count,
+				                 [&](size_t index) { return object_item(index); }));
+			}
+
+			// A whole frame chunk, its children are read straight out of its
+			// body so it is always MODE0.
+			lak::array<byte_t> frame_item(size_t index) const
+			{
+				const int32_t width  = 640;
+				const int32_t height = 480;
+				rng_t rng            = ItemRNG(spec.seed, item_kind_t::frame, index);
+
+				lak::binary_array_writer header;
+				header.write_s32(width);
+				header.write_s32(height);
+				header.write_u32(uint32_t(rng()) | 0xFF000000U); // background
+				header.write_u32(0);                             // flags
+
+				lak::binary_array_writer palette;
+				palette.write_u32(0); // unknown
+				for (size_t i = 0; i < 256; ++i)
+					palette.write_u32(uint32_t(rng()) & 0x00FFFFFFU);
+
+				lak::binary_array_writer instances;
+				instances.reserve(4 + (spec.instances_per_frame * 20));
+				instances.write_u32(uint32_t(spec.instances_per_frame));
+				for (size_t i = 0; i < spec.instances_per_frame; ++i)
+				{
+					const uint64_t random = rng();
+					instances.write_u16(uint16_t(i)); // info
+					instances.write_u16(
+					  uint16_t(spec.object_count ? random % spec.object_count : 0));
+					const auto x = int32_t((random >> 16) % width);
+					const auto y = int32_t((random >> 32) % height);
+					if (old_game)
+					{
+						instances.write_u16(uint16_t(x));
+						instances.write_u16(uint16_t(y));
+					}
+					else
+					{
+						instances.write_s32(x);
+						instances.write_s32(y);
+					}
+					instances.write_u16(uint16_t(object_parent_type_t::none));
+					instances.write_u16(0); // parent handle
+					if (!old_game)
+					{
+						instances.write_u16(0); // layer
+						instances.write_u16(0); // unknown
+					}
+				}
+
+				lak::binary_array_writer strm;
+				strm.write(AsBytes(
+				  encode(chunk_t::frame_name,
+				         spec.item_mode,
+				         AsBytes(string_data(Numbered(u"Frame ", index + 1))))));
+				strm.write(AsBytes(encode(
+				  chunk_t::frame_header, spec.item_mode, AsBytes(header.release()))));
+				strm.write(AsBytes(encode(chunk_t::frame_palette,
+				                          spec.item_mode,
+				                          AsBytes(palette.release()))));
+				strm.write(AsBytes(encode(chunk_t::frame_object_instances,
+				                          spec.item_mode,
+				                          AsBytes(instances.release()))));
+				strm.write(AsBytes(encode(chunk_t::last, encoding_t::mode0, {})));
+				const auto body = strm.release();
+				return encode(chunk_t::frame, encoding_t::mode0, AsBytes(body));
+			}
+
+			void frame_bank()
+			{
+				lak::binary_array_writer handles;
+				for (size_t i = 0; i < spec.frame_count; ++i)
+					handles.write_u16(uint16_t(i));
+				chunk(chunk_t::frame_handles,
+				      spec.item_mode,
+				      AsBytes(handles.release()));
+
+				// The frames follow the (empty) bank chunk rather than being
+				// inside it.
+				chunk(chunk_t::frame_bank, encoding_t::mode0, {});
+				for (const auto &frame :
+				     build_items(spec.frame_count,
+				                 [&](size_t index) { return frame_item(index); }))
+					put(AsBytes(frame));
+			}
+
+			// A sound item, the name then a mono 8 bit WAVE file.
+			lak::array<byte_t> sound_item(size_t index) const
+			{
+				const uint32_t sample_rate = 22050;
+				const auto name            = Numbered(u"Sound ", index + 1);
+
+				rng_t rng = ItemRNG(spec.seed, item_kind_t::sound, index);
+
+				lak::binary_array_writer body;
+				body.reserve(chars_size(name) + spec.sound_size + 0x40);
+				auto fourcc = [&](const char(&code)[5])
+				{
+					for (size_t i = 0; i < 4; ++i) body.write_u8(uint8_t(code[i]));
+				};
+				body.write(AsBytes(string_data(name)));
+				fourcc("RIFF");
+				body.write_u32(uint32_t(36 + spec.sound_size));
+				fourcc("WAVE");
+				fourcc("fmt ");
+				body.write_u32(16);
+				body.write_u16(1); // PCM
+				body.write_u16(1); // channels
+				body.write_u32(sample_rate);
+				body.write_u32(sample_rate); // byte rate
+				body.write_u16(1);           // block align
+				body.write_u16(8);           // bits per sample
+				fourcc("data");
+				body.write_u32(uint32_t(spec.sound_size));
+				ForEachFillerBlock(spec.sound_size,
+				                   rng,
+				                   [&](lak::span<const byte_t> block)
+				                   { body.write(block); });
+				const auto data = body.release();
+
+				lak::binary_array_writer strm;
+				strm.reserve(data.size() + 0x20);
+				strm.write_u32(uint32_t(index)); // handle
+				// Never 0xFFFFFFFF, which would mark a 2.5+ item.
+				strm.write_u32(uint32_t(rng()) & 0x7FFFFFFFU); // checksum
+				strm.write_u32(1);                              // references
+				strm.write_u32(uint32_t(data.size()));          // decompressed
+				strm.write_u32(uint32_t(sound_mode_t::wave));
+				strm.write_u32(0); // reserved
+				strm.write_u32(uint32_t(name.size() + 1));
+				strm.write_u32(uint32_t(data.size()));
+				strm.write(AsBytes(data));
+				return strm.release();
+			}
+
+			void sound_bank()
+			{
+				bank(chunk_t::sound_bank,
+				     build_items(spec.sound_count,
+				                 [&](size_t index) { return sound_item(index); }));
+			}
+		};
+	}
+
+	std::vector<synthetic_image_t> SyntheticImages(size_t count,
+	                                               uint16_t max_size,
+	                                               uint64_t seed)
+	{
+		static const synthetic_image_t variants[] = {
+		  {0, 0, graphics_mode_t::BGR24, image_flag_t::none},
+		  {0, 0, graphics_mode_t::BGR24, image_flag_t::alpha},
+		  {0, 0, graphics_mode_t::BGR24, image_flag_t::RLE},
+		  {0, 0, graphics_mode_t::BGR24, image_flag_t::RLE | image_flag_t::alpha},
+		  {0, 0, graphics_mode_t::RGB8, image_flag_t::none},
+		  {0, 0, graphics_mode_t::RGB8, image_flag_t::RLE},
+		  {0, 0, graphics_mode_t::RGB15, image_flag_t::none},
+		  {0, 0, graphics_mode_t::RGB16, image_flag_t::RLE},
+		  {0, 0, graphics_mode_t::BGRA32, image_flag_t::RGBA},
+		  {0, 0, graphics_mode_t::BGR24, image_flag_t::LZX | image_flag_t::alpha},
+		};
+
+		max_size = std::max<uint16_t>(max_size, 1);
+		rng_t rng(seed);
+		std::vector<synthetic_image_t> result(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			result[i]        = variants[i % std::size(variants)];
+			result[i].width  = uint16_t(1 + rng() % max_size);
+			result[i].height = uint16_t(1 + rng() % max_size);
+		}
+		return result;
+	}
+
+	lak::array<byte_t> EncodeChunk(const decryption_t &decryption,
+	                               chunk_t ID,
+	                               encoding_t mode,
+	                               bool old_game,
+	                               lak::span<const byte_t> data)
+	{
+		lak::binary_array_writer strm;
+		strm.reserve(data.size() + 16);
+
+		switch (mode)
+		{
+			case encoding_t::mode1:
+				strm.write_u32(uint32_t(data.size()));
+				if (old_game)
+				{
+					// The uncompressed form of old games' MODE1, which is all
+					// that can be written of it.
+					ASSERT(data.size() <= 0xFFFF);
+					strm.write_u8(0x0F);
+					strm.write_u16(uint16_t(data.size()));
+					strm.write(data);
+				}
+				else
+				{
+					const auto compressed = Deflate(data);
+					strm.write_u32(uint32_t(compressed.size()));
+					strm.write(AsBytes(compressed));
+				}
+				break;
+
+			case encoding_t::mode2:
+			{
+				std::vector<byte_t> encrypted(data.data(), data.data() + data.size());
+				Encrypt(decryption, ID, encrypted);
+				strm.write(AsBytes(encrypted));
+			}
+			break;
+
+			case encoding_t::mode3:
+			{
+				const auto compressed = Deflate(data);
+				std::vector<byte_t> encrypted(compressed.size() + 4);
+				const uint32_t compressed_size = uint32_t(compressed.size());
+				for (size_t i = 0; i < 4; ++i)
+					encrypted[i] = byte_t(compressed_size >> (i * 8));
+				std::copy(
+				  compressed.begin(), compressed.end(), encrypted.begin() + 4);
+				Encrypt(decryption, ID, encrypted);
+				strm.write_u32(uint32_t(data.size()));
+				strm.write(AsBytes(encrypted));
+			}
+			break;
+
+			case encoding_t::mode4:
+			{
+				const auto compressed = LZ4EncodeBlock(data);
+				strm.write_u32(uint32_t(data.size()));
+				strm.write(AsBytes(compressed));
+			}
+			break;
+
+			case encoding_t::mode0: [[fallthrough]];
+			default: strm.write(data); break;
+		}
+
+		return strm.release();
+	}
+
+	std::vector<byte_t> LZ4EncodeBlock(lak::span<const byte_t> data)
+	{
+		// The last match has to start at least 12 bytes from the end, and the
+		// last 5 bytes are always literals.
+		const size_t size        = data.size();
+		const size_t match_start = size > 12 ? size - 12 : 0;
+		const size_t match_end   = size > 5 ? size - 5 : 0;
+
+		std::vector<byte_t> result;
+		result.reserve(size + (size / 255) + 16);
+
+		auto load = [&](size_t pos)
+		{
+			uint32_t value;
+			std::memcpy(&value, data.data() + pos, sizeof(value));
+			return value;
+		};
+		auto put_length = [&](size_t length)
+		{
+			for (; length >= 255; length -= 255) result.push_back(byte_t(255));
+			result.push_back(byte_t(length));
+		};
+		auto put_literals = [&](size_t from, size_t to, size_t match_length)
+		{
+			const size_t literals = to - from;
+			result.push_back(
+			  byte_t((std::min<size_t>(literals, 15) << 4) |
+			         std::min<size_t>(match_length, 15)));
+			if (literals >= 15) put_length(literals - 15);
+			result.insert(result.end(), data.data() + from, data.data() + to);
+		};
+
+		static constexpr size_t hash_bits = 16;
+		std::vector<uint32_t> table(size_t(1) << hash_bits, UINT32_MAX);
+
+		size_t anchor = 0;
+		for (size_t pos = 0; pos < match_start;)
+		{
+			const uint32_t sequence = load(pos);
+			const uint32_t hash =
+			  (sequence * 2654435761U) >> (32 - hash_bits);
+			const size_t candidate = table[hash];
+			table[hash]            = uint32_t(pos);
+
+			if (candidate == UINT32_MAX || pos - candidate > 0xFFFF ||
+			    load(candidate) != sequence)
+			{
+				++pos;
+				continue;
+			}
+
+			size_t length = 4;
+			while (pos + length < match_end &&
+			       data[candidate + length] == data[pos + length])
+				++length;
+
+			put_literals(anchor, pos, length - 4);
+			const size_t offset = pos - candidate;
+			result.push_back(byte_t(offset));
+			result.push_back(byte_t(offset >> 8));
+			if (length - 4 >= 15) put_length(length - 4 - 15);
+
+			pos += length;
+			anchor = pos;
+		}
+
+		put_literals(anchor, size, 0);
+
+		return result;
+	}
+
+	encoding_t UsableMode(game_layout_t layout, encoding_t mode, size_t size)
+	{
+		if (layout != game_layout_t::old) return mode;
+		if (mode == encoding_t::mode1 && size <= 0xFFFF) return mode;
+		return encoding_t::mode0;
+	}
+
+	error_t CheckGameSpec(const game_spec_t &spec)
+	{
+		auto too_large = [](const char *what)
+		{
+			return lak::err_t{error(
+			  LINE_TRACE, error::str_err, what, " Too Large For 32 Bit Sizes")};
+		};
+
+		// Leaves room for the names, sizes and headers around the data.
+		const size_t limit    = UINT32_MAX - 0x10000;
+		const size_t binaries = std::max<size_t>(spec.binary_file_count, 1);
+
+		if (spec.binary_size > limit - (binaries * 0x40))
+			return too_large("Binary Files");
+
+		if (spec.pack_file_count > 0 &&
+		    spec.pack_file_size > (limit / spec.pack_file_count) - 0x40)
+			return too_large("Pack Data");
+
+		if (spec.sound_count > 0 &&
+		    spec.sound_size > (limit / spec.sound_count) - 0x80)
+			return too_large("Sound Bank");
+
+		if (spec.instances_per_frame > limit / 20) return too_large("Frame");
+
+		// Object and frame handles are only 16 bits.
+		if (spec.object_count > 0x10000) return too_large("Object Bank");
+		if (spec.frame_count > 0x10000) return too_large("Frame Bank");
+
+		return lak::ok_t{};
+	}
+
+	size_t WriteGame(const game_spec_t &spec, byte_sink_t &sink)
+	{
+		ASSERT(CheckGameSpec(spec).is_ok());
+
+		game_writer_t writer(spec, sink);
+
+		if (spec.pe_stub) writer.pe_stub();
+
+		writer.game_header();
+		writer.strings();
+
+		// Its presence is what marks a 2.5+ game, it has to come before the
+		// image bank.
+		if (spec.layout == game_layout_t::two_five_plus)
+			writer.chunk(
+			  chunk_t::two_five_plus_object_properties, encoding_t::mode0, {});
+
+		if (spec.binary_size > 0) writer.binary_files();
+
+		if (spec.object_count > 0) writer.object_bank();
+
+		if (spec.frame_count > 0) writer.frame_bank();
+
+		if (spec.layout != game_layout_t::old && !spec.images.empty())
+			writer.image_bank();
+
+		if (spec.layout != game_layout_t::old && spec.sound_count > 0)
+			writer.sound_bank();
+
+		writer.chunk(chunk_t::last, encoding_t::mode0, {});
+
+		return writer.written;
+	}
+
+	error_t SaveGame(const game_spec_t &spec, const fs::path &path)
+	{
+		TRY_SE(CheckGameSpec(spec));
+
+		std::ofstream file(path, std::ios::binary | std::ios::out);
+		ostream_sink_t sink(file);
+		if (!file.is_open())
+			return lak::err_t{
+			  error(LINE_TRACE, error::str_err, "Failed to open '", path, "'")};
+
+		WriteGame(spec, sink);
+
+		if (!file.flush())
+			return lak::err_t{
+			  error(LINE_TRACE, error::str_err, "Failed to write '", path, "'")};
+
+		return lak::ok_t{};
+	}
+}
@@ -0,0 +1,157 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_GAME_WRITER_H
+#define SOURCE_EXPLORER_GAME_WRITER_H
+
+#include "deflate.h"
+#include "explorer.h"
+
+#include <lak/binary_writer.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <string>
+#include <vector>
+
+namespace SourceExplorer
+{
+	// Synthetic games, for benchmarks and tests that can't ship real ones.
+	// Everything generated is derived from the spec's seed, the same spec
+	// always writes byte for byte the same file.
+
+	enum struct game_layout_t : uint8_t
+	{
+		// MMF1.5 style, PAME straight after the runtime header and 8 bit
+		// strings. Old items are compressed with a DEFLATE variant that
+		// can't be written here, so old games don't get an image bank.
+		old,
+		// Pack data then PAME, 8 bit strings.
+		ascii,
+		// Pack data then PAMU, UTF-16 strings.
+		unicode,
+		// Unicode, plus the 2.5+ object properties chunk and 2.5+ (LZ4)
+		// images.
+		two_five_plus,
+	};
+
+	const char *game_layout_name(game_layout_t layout);
+
+	struct synthetic_image_t
+	{
+		uint16_t width  = 32;
+		uint16_t height = 32;
+		// RGB8 (palette), BGR24, RGB15, RGB16 or BGRA32, anything else is
+		// written as BGR24.
+		graphics_mode_t graphics_mode = graphics_mode_t::BGR24;
+		// RLE, alpha, RGBA (BGRA32 only) and LZX are honoured.
+		image_flag_t flags = image_flag_t::none;
+	};
+
+	// count images of up to max_size by max_size pixels, cycling through
+	// every graphics mode and flag combination the writer supports.
+	std::vector<synthetic_image_t> SyntheticImages(size_t count,
+	                                               uint16_t max_size,
+	                                               uint64_t seed);
+
+	struct game_spec_t
+	{
+		game_layout_t layout = game_layout_t::unicode;
+		// Picks the decryption mode, 284 uses the older key order.
+		uint32_t product_build = 292;
+		uint64_t seed          = 132;
+
+		// Put the game behind a minimal PE image whose .extra section points
+		// at it, the way built .exe files are laid out.
+		bool pe_stub = false;
+
+		// Files in the pack data (extensions, runtime DLLs and such), each of
+		// pack_file_size bytes. Old games have no pack data.
+		size_t pack_file_count = 0;
+		size_t pack_file_size  = 0;
+
+		// These make up the encryption key, so are always written as MODE0.
+		std::u16string title        = u"Synthetic Game";
+		std::u16string copyright    = u"Source Explorer";
+		std::u16string project_path = u"C:\\Synthetic\\Synthetic Game.mfa";
+
+		// The author, output path and about strings are written as this.
+		encoding_t string_mode = encoding_t::mode0;
+
+		// binary_size bytes of fairly compressible filler, split between
+		// binary_file_count files. Nothing is written if it is 0. MODE0
+		// files are streamed straight to the sink, so can be as large as the
+		// chunk's 32 bit size allows.
+		encoding_t binary_mode   = encoding_t::mode0;
+		size_t binary_size       = 0;
+		size_t binary_file_count = 1;
+
+		// Every chunk inside the object and frame banks (object headers,
+		// names, properties, frame headers, palettes, instances) is written
+		// as this.
+		encoding_t item_mode = encoding_t::mode0;
+
+		std::vector<synthetic_image_t> images;
+
+		// Backdrop objects, each showing the next image in turn.
+		size_t object_count = 0;
+
+		// Frames, each with instances_per_frame instances of the objects
+		// scattered over it.
+		size_t frame_count         = 0;
+		size_t instances_per_frame = 0;
+
+		// WAVE sounds with sound_size bytes of samples each. Not written for
+		// old games, for the same reason as images.
+		size_t sound_count = 0;
+		size_t sound_size  = 0;
+	};
+
+	// Whether spec can be written at all: the sizes of chunks, items and
+	// files are all stored as 32 bits.
+	[[nodiscard]] error_t CheckGameSpec(const game_spec_t &spec);
+
+	// Encode one chunk's body as it would appear in a game file (after the
+	// ID, mode and size). MODE2/3 need decryption to hold a valid key.
+	lak::array<byte_t> EncodeChunk(const decryption_t &decryption,
+	                               chunk_t ID,
+	                               encoding_t mode,
+	                               bool old_game,
+	                               lak::span<const byte_t> data);
+
+	// LZ4 block format, greedy matching with a single entry hash table.
+	std::vector<byte_t> LZ4EncodeBlock(lak::span<const byte_t> data);
+
+	// The modes a layout can actually store: old games have no MODE2-4 and
+	// can only store small MODE1 chunks. Returns mode if it is usable.
+	encoding_t UsableMode(game_layout_t layout, encoding_t mode, size_t size);
+
+	// Write the game described by spec to sink, returns the number of bytes
+	// written. spec must pass CheckGameSpec.
+	size_t WriteGame(const game_spec_t &spec, byte_sink_t &sink);
+
+	[[nodiscard]] error_t SaveGame(const game_spec_t &spec,
+	                               const fs::path &path);
+}
+
+#endif
@@ -0,0 +1,437 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "image_encoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace SourceExplorer
+{
+	const char *image_format_name(image_format_t format)
+	{
+		switch (format)
+		{
+			case image_format_t::png: return "PNG";
+			case image_format_t::qoi: return "QOI";
+			case image_format_t::rgba: return "Raw RGBA";
+			default: return "Invalid";
+		}
+	}
+
+	const char *image_extension(image_format_t format)
+	{
+		switch (format)
+		{
+			case image_format_t::png: return ".png";
+			case image_format_t::qoi: return ".qoi";
+			case image_format_t::rgba: return ".rgba";
+			default: return "";
+		}
+	}
+
+	// The encoders do their arithmetic on uint8_t, these convert at the
+	// byte_t boundaries.
+	static inline lak::span<const byte_t> AsBytes(const uint8_t *data,
+	                                              size_t size)
+	{
+		return {reinterpret_cast<const byte_t *>(data), size};
+	}
+
+	static inline const uint8_t *AsU8(lak::span<const byte_t> bytes)
+	{
+		return reinterpret_cast<const uint8_t *>(bytes.data());
+	}
+
+	// Collects small writes into larger ones before passing them on.
+	struct buffered_sink_t
+	{
+		byte_sink_t &sink;
+		std::vector<uint8_t> buffer;
+
+		buffered_sink_t(byte_sink_t &s) : sink(s) { buffer.reserve(0x10000); }
+
+		~buffered_sink_t() { flush(); }
+
+		void put(const uint8_t *data, size_t size)
+		{
+			if (buffer.size() + size > buffer.capacity()) flush();
+			if (size >= buffer.capacity())
+				sink.write(AsBytes(data, size));
+			else
+				buffer.insert(buffer.end(), data, data + size);
+		}
+
+		void put(uint8_t value) { put(&value, 1); }
+
+		void put_u32_be(uint32_t value)
+		{
+			const uint8_t bytes[4] = {uint8_t(value >> 24),
+			                         uint8_t(value >> 16),
+			                         uint8_t(value >> 8),
+			                         uint8_t(value)};
+			put(bytes, 4);
+		}
+
+		void put_u32_le(uint32_t value)
+		{
+			const uint8_t bytes[4] = {uint8_t(value),
+			                         uint8_t(value >> 8),
+			                         uint8_t(value >> 16),
+			                         uint8_t(value >> 24)};
+			put(bytes, 4);
+		}
+
+		void flush()
+		{
+			if (buffer.empty()) return;
+			sink.write(AsBytes(buffer.data(), buffer.size()));
+			buffer.clear();
+		}
+	};
+
+	struct crc32_table_t
+	{
+		uint32_t table[256] = {};
+
+		constexpr crc32_table_t()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+		}
+	};
+
+	static constexpr crc32_table_t crc32_table;
+
+	static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+			crc = crc32_table.table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+
+	// Splits the zlib stream into IDAT chunks.
+	struct png_idat_sink_t final : byte_sink_t
+	{
+		buffered_sink_t &out;
+		std::vector<uint8_t> chunk;
+
+		png_idat_sink_t(buffered_sink_t &o) : out(o) { chunk.reserve(0x10000); }
+
+		void write(lak::span<const byte_t> bytes) override
+		{
+			const uint8_t *data = AsU8(bytes);
+			size_t size         = bytes.size();
+			while (size > 0)
+			{
+				const size_t n = std::min(size, chunk.capacity() - chunk.size());
+				chunk.insert(chunk.end(), data, data + n);
+				data += n;
+				size -= n;
+				if (chunk.size() == chunk.capacity()) flush();
+			}
+		}
+
+		void flush()
+		{
+			if (chunk.empty()) return;
+			static constexpr uint8_t tag[4] = {'I', 'D', 'A', 'T'};
+			out.put_u32_be(uint32_t(chunk.size()));
+			out.put(tag, 4);
+			out.put(chunk.data(), chunk.size());
+			out.put_u32_be(
+			  ~crc32_update(crc32_update(~0U, tag, 4), chunk.data(), chunk.size()));
+			chunk.clear();
+		}
+	};
+
+	static void png_chunk(buffered_sink_t &out,
+	                      const char (&tag)[5],
+	                      const uint8_t *data,
+	                      size_t size)
+	{
+		out.put_u32_be(uint32_t(size));
+		out.put(reinterpret_cast<const uint8_t *>(tag), 4);
+		out.put(data, size);
+		out.put_u32_be(~crc32_update(
+		  crc32_update(~0U, reinterpret_cast<const uint8_t *>(tag), 4),
+		  data,
+		  size));
+	}
+
+	static inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+	{
+		const int p  = int(a) + int(b) - int(c);
+		const int pa = std::abs(p - int(a));
+		const int pb = std::abs(p - int(b));
+		const int pc = std::abs(p - int(c));
+		if (pa <= pb && pa <= pc) return a;
+		if (pb <= pc) return b;
+		return c;
+	}
+
+	// Filter row with filter type into out, returns the sum of the absolute
+	// (signed) values of the result. The filter giving the smallest sum
+	// usually compresses best.
+	static size_t png_filter(uint8_t type,
+	                         const uint8_t *row,
+	                         const uint8_t *above,
+	                         size_t size,
+	                         uint8_t *out)
+	{
+		constexpr size_t bpp = 4;
+		size_t sum           = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const uint8_t a = i >= bpp ? row[i - bpp] : 0;
+			const uint8_t b = above ? above[i] : 0;
+			const uint8_t c = above && i >= bpp ? above[i - bpp] : 0;
+			uint8_t value   = row[i];
+			switch (type)
+			{
+				case 1: value -= a; break;
+				case 2: value -= b; break;
+				case 3: value -= uint8_t((unsigned(a) + unsigned(b)) / 2); break;
+				case 4: value -= paeth(a, b, c); break;
+				default: break;
+			}
+			out[i] = value;
+			sum += size_t(std::abs(int(int8_t(value))));
+		}
+		return sum;
+	}
+
+	static void EncodePNG(lak::span<const byte_t> rgba,
+	                      size_t width,
+	                      size_t height,
+	                      deflate_level_t level,
+	                      byte_sink_t &sink)
+	{
+		buffered_sink_t out(sink);
+
+		static constexpr uint8_t signature[8] = {
+		  0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		out.put(signature, 8);
+
+		const uint8_t header[13] = {uint8_t(width >> 24),
+		                           uint8_t(width >> 16),
+		                           uint8_t(width >> 8),
+		                           uint8_t(width),
+		                           uint8_t(height >> 24),
+		                           uint8_t(height >> 16),
+		                           uint8_t(height >> 8),
+		                           uint8_t(height),
+		                           8, // Bit depth
+		                           6, // RGBA
+		                           0,
+		                           0,
+		                           0};
+		png_chunk(out, "IHDR", header, sizeof(header));
+
+		{
+			png_idat_sink_t idat(out);
+			deflate_encoder_t encoder(level, idat);
+
+			const size_t stride = width * 4;
+			const uint8_t filter_count =
+			  level == deflate_level_t::stored ? 1
+			  : level == deflate_level_t::fast ? 3
+			                                   : 5;
+			std::vector<uint8_t> best(stride + 1);
+			std::vector<uint8_t> candidate(stride);
+			for (size_t y = 0; y < height; ++y)
+			{
+				const uint8_t *row   = AsU8(rgba) + y * stride;
+				const uint8_t *above = y > 0 ? row - stride : nullptr;
+
+				size_t best_sum = SIZE_MAX;
+				for (uint8_t type = 0; type < filter_count; ++type)
+				{
+					const size_t sum =
+					  png_filter(type, row, above, stride, candidate.data());
+					if (sum < best_sum)
+					{
+						best_sum = sum;
+						best[0]  = type;
+						std::memcpy(best.data() + 1, candidate.data(), stride);
+					}
+				}
+
+				encoder.write(AsBytes(best.data(), best.size()));
+			}
+
+			encoder.finish();
+			idat.flush();
+		}
+
+		png_chunk(out, "IEND", nullptr, 0);
+	}
+
+	static void EncodeQOI(lak::span<const byte_t> rgba,
+	                      size_t width,
+	                      size_t height,
+	                      byte_sink_t &sink)
+	{
+		buffered_sink_t out(sink);
+
+		static constexpr uint8_t magic[4] = {'q', 'o', 'i', 'f'};
+		out.put(magic, 4);
+		out.put_u32_be(uint32_t(width));
+		out.put_u32_be(uint32_t(height));
+		out.put(4); // RGBA
+		out.put(0); // sRGB with linear alpha
+
+		struct pixel_t
+		{
+			uint8_t r, g, b, a;
+
+			bool operator==(const pixel_t &other) const
+			{
+				return r == other.r && g == other.g && b == other.b &&
+				       a == other.a;
+			}
+		};
+
+		pixel_t index[64] = {};
+		pixel_t previous  = {0, 0, 0, 255};
+		size_t run        = 0;
+
+		const size_t count = width * height;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint8_t *p     = AsU8(rgba) + i * 4;
+			const pixel_t pixel = {p[0], p[1], p[2], p[3]};
+
+			if (pixel == previous)
+			{
+				if (++run == 62 || i + 1 == count)
+				{
+					out.put(uint8_t(0xC0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				out.put(uint8_t(0xC0 | (run - 1)));
+				run = 0;
+			}
+
+			const size_t hash =
+			  (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+			if (index[hash] == pixel)
+			{
+				out.put(uint8_t(hash));
+			}
+			else
+			{
+				index[hash] = pixel;
+				if (pixel.a == previous.a)
+				{
+					const int8_t dr  = int8_t(pixel.r - previous.r);
+					const int8_t dg  = int8_t(pixel.g - previous.g);
+					const int8_t db  = int8_t(pixel.b - previous.b);
+					const int8_t drg = int8_t(dr - dg);
+					const int8_t dbg = int8_t(db - dg);
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+					    db <= 1)
+					{
+						out.put(uint8_t(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) |
+						               (db + 2)));
+					}
+					else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+					         dbg >= -8 && dbg <= 7)
+					{
+						out.put(uint8_t(0x80 | (dg + 32)));
+						out.put(uint8_t(((drg + 8) << 4) | (dbg + 8)));
+					}
+					else
+					{
+						const uint8_t op[4] = {0xFE, pixel.r, pixel.g, pixel.b};
+						out.put(op, 4);
+					}
+				}
+				else
+				{
+					const uint8_t op[5] = {0xFF, pixel.r, pixel.g, pixel.b, pixel.a};
+					out.put(op, 5);
+				}
+			}
+
+			previous = pixel;
+		}
+
+		static constexpr uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+		out.put(end, 8);
+	}
+
+	static void EncodeRGBA(lak::span<const byte_t> rgba,
+	                       size_t width,
+	                       size_t height,
+	                       byte_sink_t &sink)
+	{
+		buffered_sink_t out(sink);
+
+		static constexpr uint8_t magic[4] = {'R', 'G', 'B', 'A'};
+		out.put(magic, 4);
+		out.put_u32_le(uint32_t(width));
+		out.put_u32_le(uint32_t(height));
+		out.put(AsU8(rgba), width * height * 4);
+	}
+
+	bool EncodeImage(lak::span<const byte_t> rgba,
+	                 size_t width,
+	                 size_t height,
+	                 const image_encoding_t &encoding,
+	                 byte_sink_t &sink)
+	{
+		if (width == 0 || height == 0 || width > 0x7FFFFFFF ||
+		    height > 0x7FFFFFFF || rgba.size() < width * height * 4)
+			return false;
+
+		switch (encoding.format)
+		{
+			case image_format_t::png:
+				EncodePNG(rgba, width, height, encoding.png_level, sink);
+				return true;
+
+			case image_format_t::qoi:
+				EncodeQOI(rgba, width, height, sink);
+				return true;
+
+			case image_format_t::rgba:
+				EncodeRGBA(rgba, width, height, sink);
+				return true;
+
+			default: return false;
+		}
+	}
+}
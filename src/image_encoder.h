@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_IMAGE_ENCODER_H
+#define SOURCE_EXPLORER_IMAGE_ENCODER_H
+
+#include "deflate.h"
+
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+namespace SourceExplorer
+{
+	enum struct image_format_t : uint8_t
+	{
+		png,
+		// https://qoiformat.org, lossless and much cheaper to encode than PNG.
+		qoi,
+		// "RGBA", width and height as little endian uint32_t, then the pixels.
+		rgba,
+	};
+
+	struct image_encoding_t
+	{
+		image_format_t format = image_format_t::png;
+		// stored skips filtering as well as compression, fast only tries the
+		// None, Sub and Up filters, best tries all five.
+		deflate_level_t png_level = deflate_level_t::best;
+	};
+
+	const char *image_format_name(image_format_t format);
+
+	// File extension including the '.'.
+	const char *image_extension(image_format_t format);
+
+	// Encode a width by height image of row major, 8 bit RGBA pixels, writing
+	// the file to sink as it is encoded. Returns false if the image can't be
+	// stored in the format (e.g. it is empty).
+	bool EncodeImage(lak::span<const byte_t> rgba,
+	                 size_t width,
+	                 size_t height,
+	                 const image_encoding_t &encoding,
+	                 byte_sink_t &sink);
+}
+
+#endif
@@ -5,8 +5,6 @@
 
 #include <imgui/imgui.h>
 
-#include "await.hpp"
-
 #include <lak/macro_utils.hpp>
 #include <lak/span.hpp>
 #include <lak/window.hpp>
@@ -65,34 +63,6 @@ namespace ImGui
 
 namespace lak
 {
-	template<typename R, typename... T, typename... D>
-	bool AwaitPopup(const char *str_id,
-	                bool &open,
-	                std::thread *&staticThread,
-	                std::atomic<bool> &staticFinished,
-	                R (*callback)(T...),
-	                const std::tuple<D...> &callbackData)
-	{
-		if (ImGui::BeginPopup(str_id, ImGuiWindowFlags_AlwaysAutoResize))
-		{
-			if (lak::await(staticThread, &staticFinished, callback, callbackData))
-			{
-				ImGui::CloseCurrentPopup();
-				ImGui::EndPopup();
-				open = false;
-				return false;
-			}
-			open = true;
-		}
-		else
-		{
-			open = false;
-			ImGui::OpenPopup(str_id);
-		}
-
-		return true;
-	}
-
 	bool VertSplitter(float &left,
 	                  float &right,
 	                  float width,
@@ -31,8 +31,7 @@ SOFTWARE.
 #include <imgui.h>
 #include <imgui_internal.h>
 
-#include "await.hpp"
-
+#include <lak/result.hpp>
 #include <lak/string.hpp>
 
 #include <atomic>
@@ -81,34 +80,6 @@ namespace lak
   lak::result<file_open_error, std::error_code> open_folder_modal(
     fs::path &path);
 
-  template<typename R, typename... T, typename... D>
-  bool await_popup(const char *str_id,
-                   bool &open,
-                   std::unique_ptr<std::thread> &staticThread,
-                   std::atomic<bool> &staticFinished,
-                   R (*callback)(T...),
-                   const std::tuple<D...> &callbackData)
-  {
-    if (ImGui::BeginPopup(str_id, ImGuiWindowFlags_AlwaysAutoResize))
-    {
-      if (lak::await(staticThread, staticFinished, callback, callbackData))
-      {
-        ImGui::CloseCurrentPopup();
-        ImGui::EndPopup();
-        open = false;
-        return false;
-      }
-      open = true;
-    }
-    else
-    {
-      open = false;
-      ImGui::OpenPopup(str_id);
-    }
-
-    return true;
-  }
-
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,912 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "inflate.h"
+
+#include <lak/compression/deflate.hpp>
+#include <lak/debug.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+
+namespace SourceExplorer
+{
+#ifdef SE_INFLATE_BACKEND_REFERENCE
+	std::atomic<inflate_backend_t> inflate_backend =
+	  inflate_backend_t::reference;
+#else
+	std::atomic<inflate_backend_t> inflate_backend = inflate_backend_t::fast;
+#endif
+
+	const char *inflate_error_name(inflate_error_t err)
+	{
+		switch (err)
+		{
+			case inflate_error_t::out_of_data: return "Out Of Data";
+			case inflate_error_t::invalid_header: return "Invalid Header";
+			case inflate_error_t::invalid_block_type: return "Invalid Block Type";
+			case inflate_error_t::invalid_stored_length:
+				return "Invalid Stored Block Length";
+			case inflate_error_t::invalid_code_lengths:
+				return "Invalid Code Lengths";
+			case inflate_error_t::invalid_symbol: return "Invalid Symbol";
+			case inflate_error_t::invalid_distance: return "Invalid Distance";
+			case inflate_error_t::corrupt_stream: return "Corrupt Stream";
+			default: return "Invalid Error Code";
+		}
+	}
+
+	// Decode table entries are packed into 32 bits:
+	// [0, 8)   number of bits the entry consumes
+	// [8, 12)  extra bits to read after it (or subtable index bits)
+	// [12, 16) entry kind
+	// [16, 32) value (literal(s), length/distance base or subtable offset)
+	enum entry_kind_t : uint32_t
+	{
+		kind_literal,
+		// Two literals decoded by a single lookup, first in the low byte.
+		kind_literal2,
+		kind_base,
+		kind_end,
+		kind_subtable,
+		kind_invalid,
+	};
+
+	static constexpr uint32_t make_entry(uint32_t kind,
+	                                     uint32_t bits,
+	                                     uint32_t extra,
+	                                     uint32_t value)
+	{
+		return bits | (extra << 8) | (kind << 12) | (value << 16);
+	}
+
+	static constexpr uint32_t entry_bits(uint32_t entry)
+	{
+		return entry & 0xFF;
+	}
+	static constexpr uint32_t entry_extra(uint32_t entry)
+	{
+		return (entry >> 8) & 0xF;
+	}
+	static constexpr uint32_t entry_kind(uint32_t entry)
+	{
+		return (entry >> 12) & 0xF;
+	}
+	static constexpr uint32_t entry_value(uint32_t entry)
+	{
+		return entry >> 16;
+	}
+
+	static constexpr uint32_t invalid_entry =
+	  make_entry(kind_invalid, 0, 0, 0);
+
+	static constexpr unsigned max_code_bits      = 15;
+	static constexpr unsigned litlen_table_bits  = 11;
+	static constexpr unsigned dist_table_bits    = 8;
+	static constexpr unsigned codelen_table_bits = 7;
+
+	// Enough for every code to need its own subtable.
+	static constexpr size_t litlen_table_size =
+	  (size_t(1) << litlen_table_bits) +
+	  288 * (size_t(1) << (max_code_bits - litlen_table_bits));
+	static constexpr size_t dist_table_size =
+	  (size_t(1) << dist_table_bits) +
+	  32 * (size_t(1) << (max_code_bits - dist_table_bits));
+	static constexpr size_t codelen_table_size = size_t(1)
+	                                             << codelen_table_bits;
+
+	static constexpr uint16_t length_base[29] = {
+	  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+	  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	static constexpr uint8_t length_extra[29] = {
+	  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+	  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	static constexpr uint16_t dist_base[30] = {
+	  1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+	  33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+	  1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+	static constexpr uint8_t dist_extra[30] = {
+	  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+	  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+	static constexpr uint8_t codelen_order[19] = {
+	  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	enum struct table_type_t
+	{
+		litlen,
+		dist,
+		codelen,
+	};
+
+	static uint32_t symbol_entry(table_type_t type, uint16_t symbol)
+	{
+		switch (type)
+		{
+			case table_type_t::litlen:
+				if (symbol < 256) return make_entry(kind_literal, 0, 0, symbol);
+				if (symbol == 256) return make_entry(kind_end, 0, 0, 0);
+				if (symbol < 286)
+					return make_entry(kind_base,
+					                  0,
+					                  length_extra[symbol - 257],
+					                  length_base[symbol - 257]);
+				return invalid_entry;
+
+			case table_type_t::dist:
+				if (symbol < 30)
+					return make_entry(
+					  kind_base, 0, dist_extra[symbol], dist_base[symbol]);
+				return invalid_entry;
+
+			case table_type_t::codelen:
+			default: return make_entry(kind_literal, 0, 0, symbol);
+		}
+	}
+
+	static uint32_t reverse_bits(uint32_t code, unsigned bits)
+	{
+		uint32_t result = 0;
+		for (unsigned i = 0; i < bits; ++i, code >>= 1)
+			result = (result << 1) | (code & 1);
+		return result;
+	}
+
+	// Build a canonical Huffman decode table from a list of code lengths. The
+	// primary table is indexed by the next table_bits bits of input, codes
+	// longer than that continue into a subtable. Unused entries are invalid
+	// rather than the set being required to be complete, matching zlib.
+	static bool build_table(const uint8_t *lengths,
+	                        size_t count,
+	                        table_type_t type,
+	                        unsigned table_bits,
+	                        uint32_t *table,
+	                        size_t table_size)
+	{
+		uint16_t length_count[max_code_bits + 1] = {};
+		for (size_t i = 0; i < count; ++i) ++length_count[lengths[i]];
+		length_count[0] = 0;
+
+		int left = 1;
+		for (unsigned len = 1; len <= max_code_bits; ++len)
+		{
+			left <<= 1;
+			left -= length_count[len];
+			if (left < 0) return false; // Over-subscribed.
+		}
+
+		uint16_t offsets[max_code_bits + 2] = {};
+		for (unsigned len = 1; len <= max_code_bits; ++len)
+			offsets[len + 1] = offsets[len] + length_count[len];
+
+		uint16_t sorted[288];
+		for (size_t i = 0; i < count; ++i)
+			if (lengths[i] != 0) sorted[offsets[lengths[i]]++] = uint16_t(i);
+
+		unsigned max_len = 0;
+		for (unsigned len = 1; len <= max_code_bits; ++len)
+			if (length_count[len] != 0) max_len = len;
+
+		const size_t primary_size = size_t(1) << table_bits;
+		std::fill_n(table, primary_size, invalid_entry);
+
+		const unsigned sub_bits = max_len > table_bits ? max_len - table_bits : 0;
+		size_t next_sub         = primary_size;
+
+		uint32_t code = 0;
+		size_t index  = 0;
+		for (unsigned len = 1; len <= max_len; ++len, code <<= 1)
+		{
+			for (uint16_t i = 0; i < length_count[len]; ++i, ++code)
+			{
+				const uint16_t symbol = sorted[index++];
+				const uint32_t rev    = reverse_bits(code, len);
+				const uint32_t entry  = symbol_entry(type, symbol);
+
+				if (len <= table_bits)
+				{
+					for (size_t r = rev; r < primary_size; r += size_t(1) << len)
+						table[r] = entry | len;
+					continue;
+				}
+
+				const size_t prefix = rev & (primary_size - 1);
+				if (entry_kind(table[prefix]) != kind_subtable)
+				{
+					if (next_sub + (size_t(1) << sub_bits) > table_size)
+						return false;
+					table[prefix] =
+					  make_entry(kind_subtable, table_bits, sub_bits, next_sub);
+					std::fill_n(table + next_sub, size_t(1) << sub_bits, invalid_entry);
+					next_sub += size_t(1) << sub_bits;
+				}
+
+				const size_t sub      = entry_value(table[prefix]);
+				const unsigned sublen = len - table_bits;
+				for (size_t r = rev >> table_bits; r < (size_t(1) << sub_bits);
+				     r += size_t(1) << sublen)
+					table[sub + r] = entry | sublen;
+			}
+		}
+
+		return true;
+	}
+
+	// Merge pairs of short literal codes into single entries, so runs of
+	// literals decode two bytes per lookup.
+	static void pair_literals(uint32_t *table)
+	{
+		constexpr size_t primary_size = size_t(1) << litlen_table_bits;
+
+		uint32_t single[primary_size];
+		std::memcpy(single, table, sizeof(single));
+
+		for (size_t i = 0; i < primary_size; ++i)
+		{
+			const uint32_t first = single[i];
+			if (entry_kind(first) != kind_literal) continue;
+			const uint32_t bits = entry_bits(first);
+			if (bits >= litlen_table_bits) continue;
+
+			// The remaining bits of the index are the start of the next code,
+			// the table repeats over the bits past them so this lookup is valid
+			// for any code that fits.
+			const uint32_t second = single[i >> bits];
+			if (entry_kind(second) != kind_literal ||
+			    entry_bits(second) > litlen_table_bits - bits)
+				continue;
+
+			table[i] = make_entry(kind_literal2,
+			                      bits + entry_bits(second),
+			                      0,
+			                      entry_value(first) |
+			                        (entry_value(second) << 8));
+		}
+	}
+
+	struct fixed_tables_t
+	{
+		uint32_t litlen[litlen_table_size];
+		uint32_t dist[dist_table_size];
+
+		fixed_tables_t()
+		{
+			uint8_t lengths[288];
+			std::fill_n(lengths + 0, 144, uint8_t(8));
+			std::fill_n(lengths + 144, 112, uint8_t(9));
+			std::fill_n(lengths + 256, 24, uint8_t(7));
+			std::fill_n(lengths + 280, 8, uint8_t(8));
+			build_table(lengths,
+			            288,
+			            table_type_t::litlen,
+			            litlen_table_bits,
+			            litlen,
+			            litlen_table_size);
+			pair_literals(litlen);
+
+			std::fill_n(lengths, 32, uint8_t(5));
+			build_table(lengths,
+			            32,
+			            table_type_t::dist,
+			            dist_table_bits,
+			            dist,
+			            dist_table_size);
+		}
+	};
+
+	static const fixed_tables_t &fixed_tables()
+	{
+		static const fixed_tables_t tables;
+		return tables;
+	}
+
+	struct bit_reader_t
+	{
+		const byte_t *begin;
+		const byte_t *in;
+		const byte_t *end;
+		uint64_t bits  = 0;
+		unsigned count = 0;
+
+		// Only set when the input is pulled from a source a block at a time,
+		// begin..end is then a window into block.
+		inflate_source_t *source = nullptr;
+		byte_t *block            = nullptr;
+		size_t block_size        = 0;
+		// Input bytes dropped off the front of the window so far.
+		size_t offset = 0;
+
+		static uint64_t load64(const byte_t *ptr)
+		{
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				uint64_t result;
+				std::memcpy(&result, ptr, sizeof(result));
+				return result;
+			}
+			else
+			{
+				uint64_t result = 0;
+				for (size_t i = 8; i-- > 0;)
+					result = (result << 8) | uint8_t(ptr[i]);
+				return result;
+			}
+		}
+
+		// Read the next block of input from source, keeping the unread bytes
+		// and the 8 before them (which align() may hand back). Returns false
+		// once there is nothing more to read.
+		bool pull()
+		{
+			if (!source) return false;
+			const byte_t *keep = in - std::min<size_t>(size_t(in - begin), 8);
+			const size_t kept  = size_t(end - keep);
+			std::memmove(block, keep, kept);
+			offset += size_t(keep - begin);
+			in    = block + (in - keep);
+			begin = block;
+			const size_t read =
+			  source->read(lak::span<byte_t>(block + kept, block_size - kept));
+			end = block + kept + read;
+			if (read == 0) source = nullptr;
+			return read != 0;
+		}
+
+		// Top the buffer up to at least 56 bits (if there is that much input
+		// left). Bits above count may hold the start of the next input byte,
+		// OR-ing that same byte back in later leaves them unchanged.
+		inline void refill()
+		{
+			if (end - in >= 8)
+			{
+				bits |= load64(in) << count;
+				in += (63 - count) >> 3;
+				count |= 56;
+			}
+			else
+			{
+				// Near the end of the input (or the current block of it).
+				do
+				{
+					while (count <= 56 && in < end)
+					{
+						bits |= uint64_t(uint8_t(*in++)) << count;
+						count += 8;
+					}
+				} while (count <= 56 && pull());
+			}
+		}
+
+		inline uint32_t peek(unsigned n) const
+		{
+			return uint32_t(bits & ((uint64_t(1) << n) - 1));
+		}
+
+		inline void consume(unsigned n)
+		{
+			bits >>= n;
+			count -= n;
+		}
+
+		// Drop any partial byte and hand the whole bytes still buffered back
+		// to the input, for stored blocks.
+		inline void align()
+		{
+			consume(count & 7);
+			in -= count >> 3;
+			bits  = 0;
+			count = 0;
+		}
+
+		// Copy the next n whole bytes of input to dst, only valid after
+		// align().
+		bool read_bytes(byte_t *dst, size_t n)
+		{
+			while (n > 0)
+			{
+				if (in == end && !pull()) return false;
+				const size_t step = std::min(n, size_t(end - in));
+				std::memcpy(dst, in, step);
+				in += step;
+				dst += step;
+				n -= step;
+			}
+			return true;
+		}
+
+		inline size_t consumed() const
+		{
+			return offset + size_t(in - begin) - (count >> 3);
+		}
+	};
+
+	// Resolve a (possibly subtable) entry for the bits at the front of reader.
+	static inline uint32_t lookup(const uint32_t *table,
+	                              unsigned table_bits,
+	                              const bit_reader_t &reader)
+	{
+		uint32_t entry = table[reader.peek(table_bits)];
+		if (entry_kind(entry) == kind_subtable)
+		{
+			const uint32_t sub = uint32_t(reader.bits >> table_bits) &
+			                     ((uint32_t(1) << entry_extra(entry)) - 1);
+			entry              = table[entry_value(entry) + sub];
+			// Account for the primary bits too.
+			entry += table_bits;
+		}
+		return entry;
+	}
+
+	static bool build_dynamic_tables(const inflate_state_t &state,
+	                                 uint32_t *litlen,
+	                                 uint32_t *dist)
+	{
+		if (!build_table(state.lengths,
+		                 state.hlit,
+		                 table_type_t::litlen,
+		                 litlen_table_bits,
+		                 litlen,
+		                 litlen_table_size) ||
+		    !build_table(state.lengths + state.hlit,
+		                 state.hdist,
+		                 table_type_t::dist,
+		                 dist_table_bits,
+		                 dist,
+		                 dist_table_size))
+			return false;
+		pair_literals(litlen);
+		return true;
+	}
+
+	// Read the code lengths of a dynamic block into state.
+	static lak::result<lak::monostate, inflate_error_t> read_code_lengths(
+	  inflate_state_t &state, bit_reader_t &reader)
+	{
+		reader.refill();
+		if (reader.count < 14) return lak::err_t{inflate_error_t::out_of_data};
+		const size_t hlit = reader.peek(5) + 257;
+		reader.consume(5);
+		const size_t hdist = reader.peek(5) + 1;
+		reader.consume(5);
+		const size_t hclen = reader.peek(4) + 4;
+		reader.consume(4);
+		if (hlit > 286 || hdist > 30)
+			return lak::err_t{inflate_error_t::invalid_code_lengths};
+
+		uint8_t codelen_lengths[19] = {};
+		for (size_t i = 0; i < hclen; ++i)
+		{
+			reader.refill();
+			if (reader.count < 3) return lak::err_t{inflate_error_t::out_of_data};
+			codelen_lengths[codelen_order[i]] = uint8_t(reader.peek(3));
+			reader.consume(3);
+		}
+
+		uint32_t codelen_table[codelen_table_size];
+		if (!build_table(codelen_lengths,
+		                 19,
+		                 table_type_t::codelen,
+		                 codelen_table_bits,
+		                 codelen_table,
+		                 codelen_table_size))
+			return lak::err_t{inflate_error_t::invalid_code_lengths};
+
+		uint8_t *lengths = state.lengths;
+		for (size_t i = 0; i < hlit + hdist;)
+		{
+			reader.refill();
+			const uint32_t entry = codelen_table[reader.peek(codelen_table_bits)];
+			if (entry_kind(entry) == kind_invalid)
+				return lak::err_t{inflate_error_t::invalid_code_lengths};
+			if (entry_bits(entry) > reader.count)
+				return lak::err_t{inflate_error_t::out_of_data};
+			reader.consume(entry_bits(entry));
+
+			const uint32_t symbol = entry_value(entry);
+			if (symbol < 16)
+			{
+				lengths[i++] = uint8_t(symbol);
+				continue;
+			}
+
+			uint8_t value = 0;
+			size_t repeat;
+			if (symbol == 16)
+			{
+				if (i == 0) return lak::err_t{inflate_error_t::invalid_code_lengths};
+				if (reader.count < 2) return lak::err_t{inflate_error_t::out_of_data};
+				value  = lengths[i - 1];
+				repeat = 3 + reader.peek(2);
+				reader.consume(2);
+			}
+			else if (symbol == 17)
+			{
+				if (reader.count < 3) return lak::err_t{inflate_error_t::out_of_data};
+				repeat = 3 + reader.peek(3);
+				reader.consume(3);
+			}
+			else
+			{
+				if (reader.count < 7) return lak::err_t{inflate_error_t::out_of_data};
+				repeat = 11 + reader.peek(7);
+				reader.consume(7);
+			}
+
+			if (i + repeat > hlit + hdist)
+				return lak::err_t{inflate_error_t::invalid_code_lengths};
+			std::fill_n(lengths + i, repeat, value);
+			i += repeat;
+		}
+
+		if (lengths[256] == 0)
+			return lak::err_t{inflate_error_t::invalid_code_lengths};
+
+		state.hlit  = uint16_t(hlit);
+		state.hdist = uint16_t(hdist);
+
+		return lak::ok_t{};
+	}
+
+	// Inflate from reader into output until the stream ends or max_size is
+	// reached, the reader is left where decoding stopped.
+	static lak::result<lak::monostate, inflate_error_t> InflateStream(
+	  inflate_state_t &state,
+	  bit_reader_t &reader,
+	  arena_buffer_t &output,
+	  size_t max_size)
+	{
+		using phase_t = inflate_state_t::phase_t;
+
+		// Longest match plus slack for the word sized match copy overrun.
+		constexpr size_t symbol_space = 258 + 16;
+
+		const size_t start = state.start;
+		size_t pos         = output.size();
+		output.reserve(pos + symbol_space);
+		byte_t *base = output.data();
+
+		// Make sure at least n bytes can be written at pos.
+		auto ensure = [&](size_t n)
+		{
+			if (output.capacity() - pos >= n) return;
+			output.resize(pos);
+			output.reserve(pos + n);
+			base = output.data();
+		};
+
+		auto hit_max = [&] { return pos - start >= max_size; };
+
+		if (state.phase == phase_t::header)
+		{
+			reader.refill();
+			if (reader.count < 16) return lak::err_t{inflate_error_t::out_of_data};
+			const uint32_t cmf = reader.peek(8);
+			reader.consume(8);
+			const uint32_t flg = reader.peek(8);
+			reader.consume(8);
+			if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 ||
+			    ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20) != 0)
+				return lak::err_t{inflate_error_t::invalid_header};
+			state.phase = phase_t::block;
+		}
+
+		// Too big for the stack of a worker thread, allocated once per thread
+		// the first time a dynamic block turns up.
+		thread_local std::unique_ptr<uint32_t[]> dynamic_tables;
+		auto dynamic_litlen = [&]
+		{
+			if (!dynamic_tables)
+				dynamic_tables.reset(
+				  new uint32_t[litlen_table_size + dist_table_size]);
+			return dynamic_tables.get();
+		};
+
+		const uint32_t *litlen = nullptr;
+		const uint32_t *dist   = nullptr;
+		auto select_tables     = [&]() -> bool
+		{
+			if (state.fixed)
+			{
+				litlen = fixed_tables().litlen;
+				dist   = fixed_tables().dist;
+				return true;
+			}
+			uint32_t *dyn_litlen = dynamic_litlen();
+			uint32_t *dyn_dist   = dyn_litlen + litlen_table_size;
+			litlen               = dyn_litlen;
+			dist                 = dyn_dist;
+			return build_dynamic_tables(state, dyn_litlen, dyn_dist);
+		};
+
+		// Resuming part way through a block, the tables are rebuilt from the
+		// code lengths rather than kept around with every paused stream.
+		if (state.phase == phase_t::huffman && !select_tables())
+			return lak::err_t{inflate_error_t::invalid_code_lengths};
+
+		while (state.phase != phase_t::done && !hit_max())
+		{
+			if (state.phase == phase_t::block)
+			{
+				reader.refill();
+				if (reader.count < 3) return lak::err_t{inflate_error_t::out_of_data};
+				state.final_block    = reader.peek(1) != 0;
+				const uint32_t btype = reader.peek(3) >> 1;
+				reader.consume(3);
+
+				if (btype == 0)
+				{
+					reader.align();
+					byte_t header[4];
+					if (!reader.read_bytes(header, 4))
+						return lak::err_t{inflate_error_t::out_of_data};
+					const size_t len =
+					  uint8_t(header[0]) | (uint8_t(header[1]) << 8);
+					const size_t nlen =
+					  uint8_t(header[2]) | (uint8_t(header[3]) << 8);
+					if (len != (~nlen & 0xFFFF))
+						return lak::err_t{inflate_error_t::invalid_stored_length};
+					// Check before growing output for a bogus length, a source
+					// can't say how much is left so that just runs out below.
+					if (!reader.source && size_t(reader.end - reader.in) < len)
+						return lak::err_t{inflate_error_t::out_of_data};
+					ensure(len + symbol_space);
+					if (!reader.read_bytes(base + pos, len))
+						return lak::err_t{inflate_error_t::out_of_data};
+					pos += len;
+					if (state.final_block) state.phase = phase_t::done;
+					continue;
+				}
+				else if (btype == 1)
+				{
+					state.fixed = true;
+				}
+				else if (btype == 2)
+				{
+					state.fixed = false;
+					if (auto err = read_code_lengths(state, reader); err.is_err())
+						return lak::err_t{err.unsafe_unwrap_err()};
+				}
+				else
+				{
+					return lak::err_t{inflate_error_t::invalid_block_type};
+				}
+
+				if (!select_tables())
+					return lak::err_t{inflate_error_t::invalid_code_lengths};
+				state.phase = phase_t::huffman;
+			}
+
+			while (state.phase == phase_t::huffman && !hit_max())
+			{
+				ensure(symbol_space);
+				// A full refill always leaves enough bits for a whole
+				// length/distance pair, the checks below only fail at the very
+				// end of the input.
+				reader.refill();
+
+				uint32_t entry = lookup(litlen, litlen_table_bits, reader);
+				if (entry_bits(entry) > reader.count)
+					return lak::err_t{inflate_error_t::out_of_data};
+				reader.consume(entry_bits(entry));
+
+				switch (entry_kind(entry))
+				{
+					case kind_literal:
+						base[pos++] = byte_t(entry_value(entry));
+						break;
+
+					case kind_literal2:
+						base[pos++] = byte_t(entry_value(entry) & 0xFF);
+						base[pos++] = byte_t(entry_value(entry) >> 8);
+						break;
+
+					case kind_base:
+					{
+						unsigned extra = entry_extra(entry);
+						if (extra > reader.count)
+							return lak::err_t{inflate_error_t::out_of_data};
+						const size_t length = entry_value(entry) + reader.peek(extra);
+						reader.consume(extra);
+
+						entry = lookup(dist, dist_table_bits, reader);
+						if (entry_kind(entry) != kind_base)
+							return lak::err_t{inflate_error_t::invalid_symbol};
+						if (entry_bits(entry) > reader.count)
+							return lak::err_t{inflate_error_t::out_of_data};
+						reader.consume(entry_bits(entry));
+
+						extra = entry_extra(entry);
+						if (extra > reader.count)
+							return lak::err_t{inflate_error_t::out_of_data};
+						const size_t distance = entry_value(entry) + reader.peek(extra);
+						reader.consume(extra);
+
+						if (distance > pos - start)
+							return lak::err_t{inflate_error_t::invalid_distance};
+
+						byte_t *out       = base + pos;
+						const byte_t *src = out - distance;
+						if (distance >= 8)
+						{
+							// Whole words at a time, this can write up to 7 bytes past
+							// the end of the match which ensure() left room for.
+							for (size_t i = 0; i < length; i += 8)
+								std::memcpy(out + i, src + i, 8);
+						}
+						else if (distance == 1)
+						{
+							std::memset(out, uint8_t(*src), length);
+						}
+						else
+						{
+							for (size_t i = 0; i < length; ++i) out[i] = src[i];
+						}
+						pos += length;
+					}
+					break;
+
+					case kind_end:
+						state.phase =
+						  state.final_block ? phase_t::done : phase_t::block;
+						break;
+
+					default: return lak::err_t{inflate_error_t::invalid_symbol};
+				}
+			}
+		}
+
+		output.resize(pos);
+
+		return lak::ok_t{};
+	}
+
+	lak::result<size_t, inflate_error_t> FastInflate(
+	  inflate_state_t &state,
+	  lak::span<const byte_t> compressed,
+	  arena_buffer_t &output,
+	  size_t max_size)
+	{
+		bit_reader_t reader{compressed.data(),
+		                    compressed.data() + state.in,
+		                    compressed.data() + compressed.size(),
+		                    state.bits,
+		                    state.count};
+
+		RES_TRY(InflateStream(state, reader, output, max_size));
+
+		state.in    = size_t(reader.in - reader.begin);
+		state.bits  = reader.bits;
+		state.count = reader.count;
+
+		return lak::ok_t{state.consumed()};
+	}
+
+	lak::result<size_t, inflate_error_t> FastInflate(
+	  lak::span<const byte_t> compressed,
+	  arena_buffer_t &output,
+	  bool parse_header,
+	  size_t max_size)
+	{
+		inflate_state_t state(parse_header, output.size());
+		RES_TRY_ASSIGN(const size_t consumed =,
+		               FastInflate(state, compressed, output, max_size));
+		// The last symbol may have run past max_size.
+		output.resize(state.start +
+		              std::min(output.size() - state.start, max_size));
+		return lak::ok_t{consumed};
+	}
+
+	lak::result<size_t, inflate_error_t> FastInflate(inflate_source_t &source,
+	                                                 arena_buffer_t &output,
+	                                                 bool parse_header,
+	                                                 size_t max_size)
+	{
+		constexpr size_t block_size = 0x10000;
+		std::unique_ptr<byte_t[]> block(new byte_t[block_size]);
+
+		bit_reader_t reader{block.get(), block.get(), block.get()};
+		reader.source     = &source;
+		reader.block      = block.get();
+		reader.block_size = block_size;
+
+		inflate_state_t state(parse_header, output.size());
+		RES_TRY(InflateStream(state, reader, output, max_size));
+		output.resize(state.start +
+		              std::min(output.size() - state.start, max_size));
+		return lak::ok_t{reader.consumed()};
+	}
+
+	struct reference_inflater_t final : inflater_t
+	{
+		bool supports_anaconda() const override { return true; }
+
+		lak::result<size_t, inflate_error_t> inflate(
+		  lak::span<const byte_t> compressed,
+		  arena_buffer_t &output,
+		  bool parse_header,
+		  bool anaconda,
+		  size_t max_size) const override
+		{
+			const size_t start = output.size();
+
+			lak::array<byte_t, 0x8000> buffer;
+			auto inflater =
+			  lak::deflate_iterator(compressed, buffer, parse_header, anaconda);
+
+			if (output.capacity() == start) output.reserve(start + buffer.size());
+			auto err = inflater.read(
+			  [&](lak::span<byte_t> v)
+			  {
+				  const size_t inflated = output.size() - start;
+				  const bool hit_max    = inflated + v.size() > max_size;
+				  if (hit_max) v = v.first(max_size - inflated);
+				  output.append(v);
+				  return !hit_max;
+			  });
+
+			// ok as an error means read stopped early at max_size.
+			if (err.is_err() &&
+			    err.unsafe_unwrap_err() != lak::deflate_iterator::error_t::ok)
+			{
+				DEBUG("Reference Inflate Failed: ",
+				      lak::deflate_iterator::error_name(err.unsafe_unwrap_err()));
+				DEBUG("Final? ", (inflater.is_final_block() ? "True" : "False"));
+				return lak::err_t{inflate_error_t::corrupt_stream};
+			}
+
+			return lak::ok_t{
+			  size_t(inflater.compressed().begin() - compressed.begin())};
+		}
+	};
+
+	struct fast_inflater_t final : inflater_t
+	{
+		bool supports_anaconda() const override { return false; }
+
+		lak::result<size_t, inflate_error_t> inflate(
+		  lak::span<const byte_t> compressed,
+		  arena_buffer_t &output,
+		  bool parse_header,
+		  bool anaconda,
+		  size_t max_size) const override
+		{
+			ASSERT(!anaconda);
+			return FastInflate(compressed, output, parse_header, max_size);
+		}
+	};
+
+	const inflater_t &GetInflater(inflate_backend_t backend, bool anaconda)
+	{
+		static const reference_inflater_t reference;
+		static const fast_inflater_t fast;
+
+		const inflater_t &result =
+		  backend == inflate_backend_t::fast
+		    ? static_cast<const inflater_t &>(fast)
+		    : static_cast<const inflater_t &>(reference);
+		if (anaconda && !result.supports_anaconda()) return reference;
+		return result;
+	}
+}
@@ -0,0 +1,184 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_INFLATE_H
+#define SOURCE_EXPLORER_INFLATE_H
+
+#include "arena.h"
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <atomic>
+
+namespace SourceExplorer
+{
+	enum struct inflate_backend_t : uint8_t
+	{
+		// lak::deflate_iterator, decodes a bit at a time.
+		reference,
+		// FastInflate, table driven.
+		fast,
+	};
+
+	// Backend used by Inflate. Defaults to the inflate_backend meson option,
+	// can be changed at run time. Decoders load it once per call, so a change
+	// never switches backend part way through a decode.
+	extern std::atomic<inflate_backend_t> inflate_backend;
+
+	enum struct inflate_error_t : uint8_t
+	{
+		out_of_data,
+		invalid_header,
+		invalid_block_type,
+		invalid_stored_length,
+		invalid_code_lengths,
+		invalid_symbol,
+		invalid_distance,
+		// The reference backend failed, it doesn't say how.
+		corrupt_stream,
+	};
+
+	const char *inflate_error_name(inflate_error_t err);
+
+	// Where a FastInflate call left off, enough to continue the same stream
+	// (into the same output buffer) later.
+	struct inflate_state_t
+	{
+		enum struct phase_t : uint8_t
+		{
+			header,
+			block,
+			huffman,
+			done,
+		};
+
+		phase_t phase    = phase_t::block;
+		bool final_block = false;
+		bool fixed       = false;
+		// Bytes of input loaded into the bit buffer so far.
+		size_t in      = 0;
+		uint64_t bits  = 0;
+		unsigned count = 0;
+		// Size of the output buffer when this stream started.
+		size_t start = 0;
+		// Code lengths of the current dynamic block.
+		uint16_t hlit  = 0;
+		uint16_t hdist = 0;
+		uint8_t lengths[286 + 30];
+
+		inflate_state_t(bool parse_header, size_t output_start = 0)
+		: phase(parse_header ? phase_t::header : phase_t::block),
+		  start(output_start)
+		{
+		}
+
+		inline bool done() const { return phase == phase_t::done; }
+
+		// Number of input bytes actually used.
+		inline size_t consumed() const { return in - (count >> 3); }
+	};
+
+	// A stream that has been inflated part way and the output so far.
+	struct partial_inflate_t
+	{
+		inflate_state_t state;
+		arena_buffer_t output;
+
+		partial_inflate_t(bool parse_header,
+		                  std::shared_ptr<decode_arena_t> arena)
+		: state(parse_header), output(std::move(arena))
+		{
+		}
+	};
+
+	// Supplies FastInflate's input a block at a time, so it can be produced
+	// (e.g. decrypted) as it is needed rather than all up front.
+	struct inflate_source_t
+	{
+		virtual ~inflate_source_t() = default;
+
+		// Fill as much of buffer as there is input for, returns the number of
+		// bytes written. 0 means the input has run out.
+		virtual size_t read(lak::span<byte_t> buffer) = 0;
+	};
+
+	// Table driven DEFLATE decoder. Appends the inflated data directly to
+	// output, stopping early (successfully) once max_size bytes have been
+	// inflated. parse_header reads and checks a zlib header first, otherwise
+	// compressed must be a raw DEFLATE stream. Anaconda style streams are not
+	// supported, use GetInflater(true) for those.
+	// Returns the number of compressed bytes consumed.
+	lak::result<size_t, inflate_error_t> FastInflate(
+	  lak::span<const byte_t> compressed,
+	  arena_buffer_t &output,
+	  bool parse_header,
+	  size_t max_size = SIZE_MAX);
+
+	// Continue inflating the stream described by state into output until it
+	// ends or output has grown by at least max_size bytes since the stream
+	// started. Unlike the overload above, output is not trimmed back down to
+	// max_size, the bytes past it are needed to carry on later.
+	lak::result<size_t, inflate_error_t> FastInflate(
+	  inflate_state_t &state,
+	  lak::span<const byte_t> compressed,
+	  arena_buffer_t &output,
+	  size_t max_size = SIZE_MAX);
+
+	// As above, but the compressed data is read from source as it is needed.
+	lak::result<size_t, inflate_error_t> FastInflate(
+	  inflate_source_t &source,
+	  arena_buffer_t &output,
+	  bool parse_header,
+	  size_t max_size = SIZE_MAX);
+
+	// One of the inflate backends. Inflate and StreamDecompress go through
+	// GetInflater rather than a particular decoder, so inflate_backend applies
+	// to both.
+	struct inflater_t
+	{
+		virtual ~inflater_t() = default;
+
+		// Whether this backend can decode Anaconda style streams (as found in
+		// old games).
+		virtual bool supports_anaconda() const = 0;
+
+		// Appends the inflated data to output, stopping early (successfully)
+		// once max_size bytes have been inflated. parse_header as for
+		// FastInflate. Returns the number of compressed bytes consumed.
+		virtual lak::result<size_t, inflate_error_t> inflate(
+		  lak::span<const byte_t> compressed,
+		  arena_buffer_t &output,
+		  bool parse_header,
+		  bool anaconda,
+		  size_t max_size = SIZE_MAX) const = 0;
+	};
+
+	// The inflater for backend, or the reference inflater if that backend
+	// can't decode the stream.
+	const inflater_t &GetInflater(inflate_backend_t backend,
+	                              bool anaconda = false);
+}
+
+#endif
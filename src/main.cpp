@@ -22,9 +22,11 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "imgui_utils.hpp"
 
+#include "corpus.h"
 #include "dump.h"
 #include "lisk_impl.hpp"
 #include "main.h"
+#include "perf_counters.hpp"
 
 #include <lak/opengl/shader.hpp>
 #include <lak/opengl/state.hpp>
@@ -37,6 +39,9 @@
 #include <lak/test.hpp>
 #include <lak/window.hpp>
 
+#include <charconv>
+#include <cstring>
+
 se::source_explorer_t SrcExp;
 int opengl_major, opengl_minor;
 
@@ -77,24 +82,27 @@ void MenuBar(float frame_time)
 	if (ImGui::BeginMenu("File"))
 	{
 		ImGui::Checkbox("Auto-dump Mode", &SrcExp.baby_mode);
-		SrcExp.exe.attempt |= ImGui::MenuItem(
-		  SrcExp.baby_mode ? "Open And Dump..." : "Open...", nullptr);
-		SrcExp.sorted_images.attempt |= ImGui::MenuItem(
-		  "Dump Sorted Images...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.images.attempt |=
-		  ImGui::MenuItem("Dump Images...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.sounds.attempt |=
-		  ImGui::MenuItem("Dump Sounds...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.music.attempt |=
-		  ImGui::MenuItem("Dump Music...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.shaders.attempt |=
-		  ImGui::MenuItem("Dump Shaders...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.binary_files.attempt |= ImGui::MenuItem(
-		  "Dump Binary Files...", nullptr, false, !SrcExp.baby_mode);
-		SrcExp.appicon.attempt |=
-		  ImGui::MenuItem("Dump App Icon...", nullptr, false, !SrcExp.baby_mode);
+		SrcExp.exe.attempt |=
+		  ImGui::MenuItem(SrcExp.baby_mode ? "Open And Dump..." : "Open...",
+		                  nullptr,
+		                  false,
+		                  !SrcExp.jobs_running());
+		auto dump_item = [](const char *label, se::file_state_t &file_state)
+		{
+			file_state.attempt |= ImGui::MenuItem(
+			  label, nullptr, false, !SrcExp.baby_mode && !file_state.busy());
+		};
+		dump_item("Dump Sorted Images...", SrcExp.sorted_images);
+		dump_item("Dump Images...", SrcExp.images);
+		dump_item("Dump Sounds...", SrcExp.sounds);
+		dump_item("Dump Music...", SrcExp.music);
+		dump_item("Dump Shaders...", SrcExp.shaders);
+		dump_item("Dump Binary Files...", SrcExp.binary_files);
+		dump_item("Dump Pack Files...", SrcExp.pack_files);
+		dump_item("Dump App Icon...", SrcExp.appicon);
 		ImGui::Separator();
-		SrcExp.error_log.attempt |= ImGui::MenuItem("Save Error Log...");
+		SrcExp.error_log.attempt |= ImGui::MenuItem(
+		  "Save Error Log...", nullptr, false, !SrcExp.error_log.busy());
 		ImGui::EndMenu();
 	}
 
@@ -120,6 +128,69 @@ void MenuBar(float frame_time)
 		ImGui::EndMenu();
 	}
 
+	// LoadGame replaces SrcExp.state (and its cache) from the loader thread.
+	if (ImGui::BeginMenu("Cache", !SrcExp.exe.busy()))
+	{
+		int budget_mib = int(SrcExp.decode_cache_budget >> 20);
+		if (ImGui::InputInt("Decode Budget (MiB)", &budget_mib))
+		{
+			SrcExp.decode_cache_budget = size_t(std::max(budget_mib, 0)) << 20;
+			SrcExp.state.decode_cache->set_budget(SrcExp.decode_cache_budget);
+		}
+		const auto stats = SrcExp.state.decode_cache->stats();
+		ImGui::Text("Entries: %zu", stats.entries);
+		ImGui::Text("Size: %zu KiB", stats.bytes >> 10);
+		ImGui::Text("Hits: %zu", stats.hits);
+		ImGui::Text("Misses: %zu", stats.misses);
+		ImGui::Text("Evictions: %zu", stats.evictions);
+		if (ImGui::Button("Clear")) SrcExp.state.decode_cache->clear();
+		ImGui::EndMenu();
+	}
+
+	if (ImGui::BeginMenu("Performance"))
+	{
+		// Seconds are summed over every thread, so can add up to more than
+		// the time the work actually took.
+		for (size_t i = 0; i < size_t(se::perf_stage_t::count); ++i)
+		{
+			const auto stage = se::perf_stage_t(i);
+			const auto stats = se::perf_counters.get(stage);
+			ImGui::Text("%s: %zu items, %zu KiB, %.3fs, %.1f MiB/s",
+			            se::perf_stage_name(stage),
+			            size_t(stats.items),
+			            size_t(stats.bytes >> 10),
+			            stats.seconds,
+			            stats.mib_per_second());
+		}
+		if (ImGui::Button("Reset")) se::perf_counters.reset();
+		ImGui::EndMenu();
+	}
+
+	if (ImGui::BeginMenu("Image Format"))
+	{
+		// Dumps take a copy when they start, so this is safe to change at any
+		// time.
+		auto &encoding = SrcExp.image_encoding;
+		for (auto format : {se::image_format_t::png,
+		                    se::image_format_t::qoi,
+		                    se::image_format_t::rgba})
+			if (ImGui::MenuItem(
+			      se::image_format_name(format), nullptr, encoding.format == format))
+				encoding.format = format;
+		ImGui::Separator();
+		ImGui::Text("PNG Effort");
+		for (auto [level, name] :
+		     {std::pair{se::deflate_level_t::stored, "Stored"},
+		      std::pair{se::deflate_level_t::fast, "Fast"},
+		      std::pair{se::deflate_level_t::best, "Best"}})
+			if (ImGui::MenuItem(name,
+			                    nullptr,
+			                    encoding.png_level == level,
+			                    encoding.format == se::image_format_t::png))
+				encoding.png_level = level;
+		ImGui::EndMenu();
+	}
+
 	if (ImGui::BeginMenu("Help"))
 	{
 		HelpText();
@@ -127,7 +198,18 @@ void MenuBar(float frame_time)
 	}
 
 	ImGui::Checkbox("Color transparency?", &SrcExp.dump_color_transparent);
-	ImGui::Checkbox("Force compat mode?", &se::force_compat);
+	ImGui::Checkbox("Force compat mode?", &SrcExp.force_compat);
+	ImGui::Checkbox("Lazy load images?", &SrcExp.lazy_load);
+	ImGui::Checkbox("Cache chunk index?", &SrcExp.cache_index);
+	ImGui::Checkbox("Windowed loading?", &SrcExp.windowed_load);
+	// Loads and dumps read the backend from the pool, it can't be changed
+	// until they have all finished.
+	if (bool fast = se::inflate_backend.load() == se::inflate_backend_t::fast;
+	    SrcExp.exe.busy() || SrcExp.jobs_running())
+		ImGui::TextDisabled("Fast inflate? %s (busy)", fast ? "Yes" : "No");
+	else if (ImGui::Checkbox("Fast inflate?", &fast))
+		se::inflate_backend.store(fast ? se::inflate_backend_t::fast
+		                               : se::inflate_backend_t::reference);
 	ImGui::Checkbox("Debug console? (May make SE slow)",
 	                &lak::debugger.live_output_enabled);
 
@@ -138,6 +220,53 @@ void MenuBar(float frame_time)
 	}
 }
 
+void Jobs()
+{
+	if (SrcExp.jobs.empty()) return;
+
+	if (ImGui::Begin("Jobs", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		for (const auto &job : SrcExp.jobs)
+		{
+			ImGui::PushID(job.get());
+			if (job->running())
+				ImGui::ProgressBar(job->completed);
+			else if (job->result.get() && job->result.get()->is_ok())
+			{
+				// Dumps keep going past files they can't write, say how many.
+				if (const size_t failed = job->failed; failed > 0)
+					ImGui::ProgressBar(
+					  1.0f,
+					  ImVec2(-1, 0),
+					  (std::to_string(failed) + " failed").c_str());
+				else
+					ImGui::ProgressBar(1.0f, ImVec2(-1, 0), "Done");
+			}
+			else
+				ImGui::ProgressBar(job->completed, ImVec2(-1, 0), "Failed");
+			ImGui::SameLine();
+			ImGui::Text("%s", job->name.c_str());
+			if (const size_t items = job->items; items > 0)
+			{
+				const double seconds = std::max(job->elapsed(), 0.001);
+				ImGui::Text("%zu files, %.1f items/s, %.2f MB/s",
+				            items,
+				            (double)items / seconds,
+				            (double)job->bytes / seconds / 1000000.0);
+			}
+			ImGui::PopID();
+		}
+
+		if (ImGui::Button("Clear Finished"))
+			SrcExp.jobs.erase(std::remove_if(SrcExp.jobs.begin(),
+			                                 SrcExp.jobs.end(),
+			                                 [](const auto &job)
+			                                 { return !job->running(); }),
+			                  SrcExp.jobs.end());
+	}
+	ImGui::End();
+}
+
 void Navigator()
 {
 	if (SrcExp.loaded)
@@ -192,11 +321,22 @@ void Navigator()
 
 bool Crypto()
 {
-	bool updated   = false;
-	int magic_char = se::_magic_char;
+	bool updated     = false;
+	auto &decryption = *SrcExp.state.decryption;
+	int magic_char   = decryption.magic_char;
+
+	// GetEncryptionKey rebuilds the table in place, which anything decoding
+	// on the pool may be reading.
+	if (SrcExp.exe.busy() || SrcExp.jobs_running() ||
+	    (SrcExp.pending_image.valid() && !SrcExp.pending_image.ready()))
+	{
+		ImGui::TextDisabled("Magic Char (u8): %d (busy)", magic_char);
+		return updated;
+	}
+
 	if (ImGui::InputInt("Magic Char (u8)", &magic_char))
 	{
-		se::_magic_char = static_cast<uint8_t>(magic_char);
+		decryption.magic_char = static_cast<uint8_t>(magic_char);
 		se::GetEncryptionKey(SrcExp.state);
 		updated = true;
 	}
@@ -230,10 +370,8 @@ void BytePairsMemoryExplorer(const byte_t *data, size_t size, bool update)
 		if (SrcExp.view != nullptr && SrcExp.state.file != nullptr &&
 		    data == SrcExp.state.file->data())
 		{
-			auto ref_span = SrcExp.view->ref_span;
-			while (ref_span._source && ref_span._source != SrcExp.state.file)
-				ref_span = ref_span.parent_span();
-			if (!ref_span.empty())
+			const auto ref_span = SrcExp.view->ref_span.get().root_span();
+			if (ref_span._source == SrcExp.state.file && !ref_span.empty())
 			{
 				from = ref_span.position().UNWRAP();
 				to   = from + ref_span.size();
@@ -347,10 +485,8 @@ void RawImageMemoryExplorer(const byte_t *data, size_t size, bool update)
 		if (SrcExp.view != nullptr && SrcExp.state.file != nullptr &&
 		    data == SrcExp.state.file->data())
 		{
-			auto ref_span = SrcExp.view->ref_span;
-			while (ref_span._source && ref_span._source != SrcExp.state.file)
-				ref_span = ref_span.parent_span();
-			if (!ref_span.empty())
+			const auto ref_span = SrcExp.view->ref_span.get().root_span();
+			if (ref_span._source == SrcExp.state.file && !ref_span.empty())
 			{
 				from = ref_span.position().UNWRAP();
 				to   = from + ref_span.size();
@@ -508,7 +644,8 @@ void MemoryExplorer(bool &update)
 		ImGui::SameLine();
 		update |= ImGui::RadioButton("Data Image", &content_mode, 2);
 		ImGui::SameLine();
-		SrcExp.binary_block.attempt |= ImGui::Button("Save Binary");
+		SrcExp.binary_block.attempt |=
+		  ImGui::Button("Save Binary") && !SrcExp.binary_block.busy();
 		ImGui::Separator();
 	}
 
@@ -534,13 +671,8 @@ void MemoryExplorer(bool &update)
 			if (update && SrcExp.view != nullptr)
 			{
 				SCOPED_CHECKPOINT(__func__, "::EXE");
-				auto ref_span = SrcExp.view->ref_span;
-				while (ref_span._source && ref_span._source != SrcExp.state.file)
-				{
-					CHECKPOINT();
-					ref_span = ref_span.parent_span();
-				}
-				if (ref_span._source && !ref_span.empty())
+				const auto ref_span = SrcExp.view->ref_span.get().root_span();
+				if (ref_span._source == SrcExp.state.file && !ref_span.empty())
 				{
 					const auto from = ref_span.position().UNWRAP();
 					SrcExp.editor.GotoAddrAndHighlight(from, from + ref_span.size());
@@ -557,13 +689,13 @@ void MemoryExplorer(bool &update)
 	{
 		if (update && SrcExp.view != nullptr)
 			SrcExp.buffer =
-			  raw ? SrcExp.view->head.data
+			  raw ? SrcExp.view->raw_head()
 			      : SrcExp.view->decode_head()
 			          .or_else(
 			            [&](const auto &err) -> se::result_t<se::data_ref_span_t>
 			            {
 				            ERROR(err);
-				            return lak::ok_t{SrcExp.view->head.data};
+				            return lak::ok_t{SrcExp.view->raw_head()};
 			            })
 			          .UNWRAP();
 
@@ -590,13 +722,13 @@ void MemoryExplorer(bool &update)
 	{
 		if (update && SrcExp.view != nullptr)
 			SrcExp.buffer =
-			  raw ? SrcExp.view->body.data
+			  raw ? SrcExp.view->raw_body()
 			      : SrcExp.view->decode_body()
 			          .or_else(
 			            [&](const auto &err) -> se::result_t<se::data_ref_span_t>
 			            {
 				            ERROR(err);
-				            return lak::ok_t{SrcExp.view->body.data};
+				            return lak::ok_t{SrcExp.view->raw_body()};
 			            })
 			          .UNWRAP();
 
@@ -619,9 +751,10 @@ void MemoryExplorer(bool &update)
 			if (update) SrcExp.editor.GotoAddrAndHighlight(0, 0);
 		}
 	}
-	else if (data_mode == 3) // _magic_key
+	else if (data_mode == 3) // magic_key
 	{
-		SrcExp.editor.DrawContents(&(se::_magic_key[0]), se::_magic_key.size());
+		auto &magic_key = SrcExp.state.decryption->magic_key;
+		SrcExp.editor.DrawContents(magic_key.data(), magic_key.size());
 		if (update) SrcExp.editor.GotoAddrAndHighlight(0, 0);
 	}
 	else
@@ -1012,6 +1145,8 @@ void SourceExplorerMain(float frame_time)
 		HelpText();
 	}
 
+	Jobs();
+
 	if (SrcExp.exe.attempt)
 		se::AttemptExe(SrcExp);
 	else if (SrcExp.images.attempt)
@@ -1028,6 +1163,8 @@ void SourceExplorerMain(float frame_time)
 		se::AttemptShaders(SrcExp);
 	else if (SrcExp.binary_files.attempt)
 		se::AttemptBinaryFiles(SrcExp);
+	else if (SrcExp.pack_files.attempt)
+		se::AttemptPackFiles(SrcExp);
 	else if (SrcExp.error_log.attempt)
 		se::AttemptErrorLog(SrcExp);
 	else if (SrcExp.binary_block.attempt)
@@ -1048,10 +1185,9 @@ void SourceBytePairsMain(float)
 		auto code = lak::open_file_modal(file_state.path, false);
 		if (code.is_ok() && code.unwrap() == lak::file_open_error::VALID)
 		{
-			SrcExp.state      = se::game_t{};
-			SrcExp.state.file = se::make_data_ref_ptr(
-			  se::data_ref_ptr_t{},
-			  lak::read_file(file_state.path).EXPECT("failed to load file"));
+			se::UnloadGame(SrcExp);
+			SrcExp.state.file =
+			  se::OpenFile(file_state.path).EXPECT("failed to load file");
 			ASSERT(SrcExp.state.file != nullptr);
 			return true;
 		}
@@ -1120,15 +1256,68 @@ bool force_only_error = false;
 
 lak::optional<int> basic_window_preinit(int argc, char **argv)
 {
-	lak::debugger.std_out(u8"", u8"" APP_NAME "\n");
+	// Set by -dump, runs the dumps without ever opening a window.
+	std::vector<std::string> batch_dumps;
+	fs::path batch_out;
+	// Set by -corpus, as above but for every game in a folder or list.
+	se::corpus_options_t corpus;
+	// Set by -bench, decodes the game without a window and reports how long
+	// each stage took.
+	bool bench = false;
+
+	auto is_arg = [&](int arg, const char *name)
+	{
+		// Accept both -name and --name.
+		return argv[arg] == lak::astring(name) ||
+		       argv[arg] == ("-" + lak::astring(name));
+	};
+
+	const auto usage = lak::optional<int>(int(se::batch_status_t::usage));
+
+	// Step over the value that follows argv[arg].
+	auto next_value = [&](int &arg)
+	{
+		if (++arg < argc) return true;
+		std::cerr << "Missing value for " << argv[arg - 1] << "\n";
+		return false;
+	};
+
+	// Step over and parse the whole number that follows argv[arg], scaled up
+	// by 2^shift.
+	auto next_number = [&](int &arg, size_t &value, unsigned shift = 0)
+	{
+		if (!next_value(arg)) return false;
+		const char *begin = argv[arg];
+		const char *end   = begin + std::strlen(begin);
+		size_t result     = 0;
+		if (auto [ptr, err] = std::from_chars(begin, end, result);
+		    err == std::errc{} && ptr == end &&
+		    result <= (SIZE_MAX >> shift))
+		{
+			value = result << shift;
+			return true;
+		}
+		std::cerr << "Invalid value for " << argv[arg - 1] << ": " << argv[arg]
+		          << "\n";
+		return false;
+	};
 
 	for (int arg = 1; arg < argc; ++arg)
 	{
-		if (argv[arg] == lak::astring("-help"))
+		if (is_arg(arg, "-help"))
 		{
 			std::cout
 			  << "srcexp.exe [-help] [-nogl] [-onlyerr] "
-			     "[-listtests | -testall | -tests \"test1;test2\"] [<filepath>]\n";
+			     "[-listtests | -testall | -tests \"test1;test2\"] "
+			     "[-dump \"dump1,dump2\"] [-out <folder>] "
+			     "[-corpus <folder | list file> [-games <count>] "
+			     "[-budget <MiB>]] [-bench <filepath>] [<filepath>]\n"
+			     "-dump, -corpus and -bench run without a window, printing "
+			     "progress to stdout as JSON lines.\nDumps: "
+			  << se::batch_dump_names
+			  << "\nExit status: 0 ok, 1 bad arguments, 2 failed to load, 3 "
+			     "some files failed to dump (or decode, for -bench), 4 over "
+			     "the -budget memory limit\n";
 			return lak::optional<int>(0);
 		}
 		else if (argv[arg] == lak::astring("-nogl"))
@@ -1161,17 +1350,103 @@ lak::optional<int> basic_window_preinit(int argc, char **argv)
 			return lak::optional<int>(lak::run_tests(
 			  lak::as_u8string(lak::astring_view::from_c_str(argv[arg]))));
 		}
+		else if (is_arg(arg, "-dump"))
+		{
+			if (!next_value(arg)) return usage;
+			std::stringstream list(argv[arg]);
+			for (std::string name; std::getline(list, name, ',');)
+				if (!name.empty()) batch_dumps.push_back(name);
+		}
+		else if (is_arg(arg, "-out"))
+		{
+			if (!next_value(arg)) return usage;
+			batch_out = argv[arg];
+		}
+		else if (is_arg(arg, "-corpus"))
+		{
+			if (!next_value(arg)) return usage;
+			corpus.input = argv[arg];
+		}
+		else if (is_arg(arg, "-games"))
+		{
+			if (!next_number(arg, corpus.games_at_once)) return usage;
+		}
+		else if (is_arg(arg, "-budget"))
+		{
+			if (!next_number(arg, corpus.memory_budget, 20)) return usage;
+		}
+		else if (is_arg(arg, "-bench"))
+		{
+			if (!next_value(arg)) return usage;
+			bench              = true;
+			SrcExp.baby_mode   = false;
+			SrcExp.exe.path    = argv[arg];
+			SrcExp.exe.valid   = true;
+			SrcExp.exe.attempt = true;
+		}
 		else
 		{
 			SrcExp.baby_mode   = false;
 			SrcExp.exe.path    = argv[arg];
 			SrcExp.exe.valid   = true;
 			SrcExp.exe.attempt = true;
-			if (!lak::path_exists(SrcExp.exe.path).UNWRAP())
-				FATAL(SrcExp.exe.path, " does not exist");
 		}
 	}
 
+	if (!corpus.input.empty())
+	{
+		corpus.dumps = lak::move(batch_dumps);
+		corpus.out   = batch_out.empty() ? fs::current_path() : batch_out;
+
+		// Keep stdout for the progress events, errors go to the log instead.
+		lak::debugger.live_output_enabled = false;
+		lak::debugger.crash_path = SrcExp.error_log.path =
+		  corpus.out / "SEND-THIS-CRASH-LOG-TO-LAK132.txt";
+
+		return lak::optional<int>(int(se::CorpusDump(SrcExp, corpus)));
+	}
+
+	if (bench)
+	{
+		if (!lak::path_exists(SrcExp.exe.path).UNWRAP())
+		{
+			std::cerr << "-bench needs a game file that exists\n";
+			return usage;
+		}
+
+		// Keep stdout for the results, errors go to the log instead.
+		lak::debugger.live_output_enabled = false;
+		lak::debugger.crash_path = SrcExp.error_log.path =
+		  fs::current_path() / "SEND-THIS-CRASH-LOG-TO-LAK132.txt";
+
+		return lak::optional<int>(int(se::BenchGame(SrcExp)));
+	}
+
+	if (!batch_dumps.empty())
+	{
+		if (!SrcExp.exe.attempt || !lak::path_exists(SrcExp.exe.path).UNWRAP())
+		{
+			std::cerr << "-dump needs a game file that exists\n";
+			return usage;
+		}
+
+		if (batch_out.empty())
+			batch_out = SrcExp.exe.path.parent_path() / SrcExp.exe.path.stem();
+
+		// Keep stdout for the progress events, errors go to the log instead.
+		lak::debugger.live_output_enabled = false;
+		lak::debugger.crash_path = SrcExp.error_log.path =
+		  batch_out / "SEND-THIS-CRASH-LOG-TO-LAK132.txt";
+
+		return lak::optional<int>(
+		  int(se::BatchDump(SrcExp, batch_dumps, batch_out)));
+	}
+
+	lak::debugger.std_out(u8"", u8"" APP_NAME "\n");
+
+	if (SrcExp.exe.attempt && !lak::path_exists(SrcExp.exe.path).UNWRAP())
+		FATAL(SrcExp.exe.path, " does not exist");
+
 	basic_window_target_framerate      = 30;
 	basic_window_opengl_settings.major = 3;
 	basic_window_opengl_settings.minor = 2;
@@ -1187,7 +1462,8 @@ void basic_window_init(lak::window &window)
 
 	SrcExp.images.path = SrcExp.sorted_images.path = SrcExp.sounds.path =
 	  SrcExp.music.path = SrcExp.shaders.path = SrcExp.binary_files.path =
-	    SrcExp.appicon.path = SrcExp.binary_block.path = fs::current_path();
+	    SrcExp.pack_files.path = SrcExp.appicon.path =
+	      SrcExp.binary_block.path = fs::current_path();
 
 	lak::debugger.live_output_enabled = true;
 
@@ -1243,6 +1519,13 @@ void basic_window_handle_event(lak::window &, lak::event &event)
 	switch (event.type)
 	{
 		case lak::event_type::dropfile:
+			if (SrcExp.exe.busy() || SrcExp.jobs_running())
+			{
+				WARNING("Can't open ",
+				        event.dropfile().path,
+				        " until the current jobs have finished");
+				break;
+			}
 			SrcExp.exe.path    = event.dropfile().path;
 			SrcExp.exe.valid   = true;
 			SrcExp.exe.attempt = true;
@@ -41,6 +41,7 @@ namespace se = SourceExplorer;
 #include <future>
 #include <iostream>
 #include <queue>
+#include <sstream>
 #include <stdint.h>
 #include <thread>
 #include <unordered_set>
@@ -0,0 +1,407 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef NOMINMAX
+#	define NOMINMAX
+#endif
+
+#include "mapped_file.h"
+
+#include <lak/debug.hpp>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <cerrno>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace SourceExplorer
+{
+#ifdef _WIN32
+	mapped_file_t::~mapped_file_t()
+	{
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file && _file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	}
+
+	lak::result<std::shared_ptr<mapped_file_t>> mapped_file_t::open(
+	  const std::filesystem::path &path)
+	{
+		FUNCTION_CHECKPOINT();
+
+		auto result = std::make_shared<mapped_file_t>();
+
+		result->_file = CreateFileW(path.c_str(),
+		                            GENERIC_READ,
+		                            FILE_SHARE_READ,
+		                            nullptr,
+		                            OPEN_EXISTING,
+		                            FILE_ATTRIBUTE_NORMAL,
+		                            nullptr);
+		if (result->_file == INVALID_HANDLE_VALUE)
+		{
+			WARNING("Failed To Open File: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(result->_file, &size))
+		{
+			WARNING("Failed To Get File Size: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		if (size.QuadPart <= 0 ||
+		    uint64_t(size.QuadPart) > uint64_t(SIZE_MAX))
+		{
+			WARNING("Cannot Map File Of Size ", size.QuadPart);
+			return lak::err_t{};
+		}
+
+		result->_size = size_t(size.QuadPart);
+
+		result->_mapping = CreateFileMappingW(
+		  result->_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!result->_mapping)
+		{
+			WARNING("Failed To Create File Mapping: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		result->_data = static_cast<byte_t *>(
+		  MapViewOfFile(result->_mapping, FILE_MAP_COPY, 0, 0, 0));
+		if (!result->_data)
+		{
+			WARNING("Failed To Map View Of File: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		return lak::ok_t{lak::move(result)};
+	}
+
+	void mapped_file_t::advise(access_hint_t hint) const
+	{
+		// Windows has no read-ahead policy for an existing view.
+		// PrefetchVirtualMemory would read the whole range in up front, which
+		// for a multi-GB game is exactly what mapping it is meant to avoid, so
+		// faults are left to the OS's own clustering.
+		(void)hint;
+	}
+
+	windowed_file_t::~windowed_file_t()
+	{
+		if (_mapping) CloseHandle(_mapping);
+		if (_file && _file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	}
+
+	lak::result<std::shared_ptr<windowed_file_t>> windowed_file_t::open(
+	  const std::filesystem::path &path, size_t window_size, size_t max_cached)
+	{
+		FUNCTION_CHECKPOINT();
+
+		auto result = std::make_shared<windowed_file_t>();
+
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		result->_alignment = info.dwAllocationGranularity;
+		result->_window_size =
+		  std::max(window_size - (window_size % result->_alignment),
+		           size_t(result->_alignment));
+		result->_max_cached = max_cached;
+
+		result->_file = CreateFileW(path.c_str(),
+		                            GENERIC_READ,
+		                            FILE_SHARE_READ,
+		                            nullptr,
+		                            OPEN_EXISTING,
+		                            FILE_ATTRIBUTE_NORMAL,
+		                            nullptr);
+		if (result->_file == INVALID_HANDLE_VALUE)
+		{
+			WARNING("Failed To Open File: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(result->_file, &size))
+		{
+			WARNING("Failed To Get File Size: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		if (size.QuadPart <= 0)
+		{
+			WARNING("Cannot Map File Of Size ", size.QuadPart);
+			return lak::err_t{};
+		}
+
+		result->_size = uint64_t(size.QuadPart);
+
+		result->_mapping = CreateFileMappingW(
+		  result->_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!result->_mapping)
+		{
+			WARNING("Failed To Create File Mapping: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		return lak::ok_t{lak::move(result)};
+	}
+
+	lak::result<std::shared_ptr<mapped_file_t>> windowed_file_t::map(
+	  uint64_t offset, size_t size) const
+	{
+		auto result     = std::make_shared<mapped_file_t>();
+		result->_size   = size;
+		result->_offset = offset;
+		result->_data   = static_cast<byte_t *>(
+		  MapViewOfFile(_mapping,
+		                FILE_MAP_COPY,
+		                static_cast<DWORD>(offset >> 32),
+		                static_cast<DWORD>(offset & 0xFFFFFFFF),
+		                size));
+		if (!result->_data)
+		{
+			WARNING("Failed To Map View Of File: ", GetLastError());
+			return lak::err_t{};
+		}
+
+		return lak::ok_t{lak::move(result)};
+	}
+#else
+	mapped_file_t::~mapped_file_t()
+	{
+		if (_data) munmap(_data, _size);
+	}
+
+	lak::result<std::shared_ptr<mapped_file_t>> mapped_file_t::open(
+	  const std::filesystem::path &path)
+	{
+		FUNCTION_CHECKPOINT();
+
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			WARNING("Failed To Open File: ", errno);
+			return lak::err_t{};
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			WARNING("Failed To Get File Size: ", errno);
+			::close(fd);
+			return lak::err_t{};
+		}
+
+		if (info.st_size <= 0 || uint64_t(info.st_size) > uint64_t(SIZE_MAX))
+		{
+			WARNING("Cannot Map File Of Size ", info.st_size);
+			::close(fd);
+			return lak::err_t{};
+		}
+
+		auto result   = std::make_shared<mapped_file_t>();
+		result->_size = size_t(info.st_size);
+
+		void *address = mmap(
+		  nullptr, result->_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file.
+		::close(fd);
+		if (address == MAP_FAILED)
+		{
+			WARNING("Failed To Map File: ", errno);
+			return lak::err_t{};
+		}
+
+		result->_data = static_cast<byte_t *>(address);
+
+		return lak::ok_t{lak::move(result)};
+	}
+
+	void mapped_file_t::advise(access_hint_t hint) const
+	{
+		if (!_data) return;
+
+		int advice = MADV_NORMAL;
+		switch (hint)
+		{
+			case access_hint_t::normal: advice = MADV_NORMAL; break;
+			case access_hint_t::sequential: advice = MADV_SEQUENTIAL; break;
+			case access_hint_t::random: advice = MADV_RANDOM; break;
+		}
+
+		if (madvise(_data, _size, advice) != 0)
+			DEBUG("madvise Failed: ", errno);
+	}
+
+	windowed_file_t::~windowed_file_t()
+	{
+		if (_fd >= 0) ::close(_fd);
+	}
+
+	lak::result<std::shared_ptr<windowed_file_t>> windowed_file_t::open(
+	  const std::filesystem::path &path, size_t window_size, size_t max_cached)
+	{
+		FUNCTION_CHECKPOINT();
+
+		auto result = std::make_shared<windowed_file_t>();
+
+		if (const long page_size = sysconf(_SC_PAGESIZE); page_size > 0)
+			result->_alignment = size_t(page_size);
+		result->_window_size =
+		  std::max(window_size - (window_size % result->_alignment),
+		           result->_alignment);
+		result->_max_cached = max_cached;
+
+		result->_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (result->_fd < 0)
+		{
+			WARNING("Failed To Open File: ", errno);
+			return lak::err_t{};
+		}
+
+		struct stat info;
+		if (fstat(result->_fd, &info) != 0)
+		{
+			WARNING("Failed To Get File Size: ", errno);
+			return lak::err_t{};
+		}
+
+		if (info.st_size <= 0)
+		{
+			WARNING("Cannot Map File Of Size ", info.st_size);
+			return lak::err_t{};
+		}
+
+		result->_size = uint64_t(info.st_size);
+
+		return lak::ok_t{lak::move(result)};
+	}
+
+	lak::result<std::shared_ptr<mapped_file_t>> windowed_file_t::map(
+	  uint64_t offset, size_t size) const
+	{
+		void *address = mmap(nullptr,
+		                     size,
+		                     PROT_READ | PROT_WRITE,
+		                     MAP_PRIVATE,
+		                     _fd,
+		                     static_cast<off_t>(offset));
+		if (address == MAP_FAILED)
+		{
+			WARNING("Failed To Map Window: ", errno);
+			return lak::err_t{};
+		}
+
+		auto result     = std::make_shared<mapped_file_t>();
+		result->_data   = static_cast<byte_t *>(address);
+		result->_size   = size;
+		result->_offset = offset;
+
+		return lak::ok_t{lak::move(result)};
+	}
+#endif
+
+	lak::result<std::shared_ptr<mapped_file_t>> windowed_file_t::window(
+	  uint64_t offset, size_t min_size)
+	{
+		FUNCTION_CHECKPOINT("windowed_file_t::");
+
+		if (offset >= _size) return lak::err_t{};
+		min_size = size_t(std::min<uint64_t>(min_size, _size - offset));
+
+		std::lock_guard lock(_mutex);
+
+		std::shared_ptr<mapped_file_t> result;
+		std::erase_if(_windows,
+		              [&](const std::weak_ptr<mapped_file_t> &weak)
+		              {
+			              auto window = weak.lock();
+			              if (!window) return true;
+			              if (!result && window->offset() <= offset &&
+			                  offset + min_size <=
+			                    window->offset() + window->size())
+				              result = lak::move(window);
+			              return false;
+		              });
+
+		if (!result)
+		{
+			// Windows sit on a grid of the window size, only a range that
+			// crosses a grid line gets a larger window that overlaps the next.
+			const uint64_t start = offset - (offset % _window_size);
+			const uint64_t want =
+			  std::max<uint64_t>(start + _window_size, offset + min_size) +
+			  (_alignment - 1);
+			const uint64_t end =
+			  std::min<uint64_t>(want - (want % _alignment), _size);
+
+			if (end - start > uint64_t(SIZE_MAX))
+			{
+				WARNING("Window Too Large To Map: ", end - start);
+				return lak::err_t{};
+			}
+
+			DEBUG("Mapping Window: ", start, " - ", end);
+
+			RES_TRY_ASSIGN(result =, map(start, size_t(end - start)));
+			result->_windowed = true;
+			result->_owner    = weak_from_this();
+			_windows.push_back(result);
+		}
+
+		touch(result);
+
+		return lak::ok_t{lak::move(result)};
+	}
+
+	void windowed_file_t::touch(const std::shared_ptr<mapped_file_t> &window)
+	{
+		if (auto it = std::find(_recent.begin(), _recent.end(), window);
+		    it != _recent.end())
+		{
+			_recent.splice(_recent.begin(), _recent, it);
+			return;
+		}
+
+		_recent.push_front(window);
+		_recent_bytes += window->size();
+
+		// Windows dropped here are unmapped straight away unless a reader or
+		// a span in use still holds them.
+		while (_recent_bytes > _max_cached && _recent.size() > 1)
+		{
+			_recent_bytes -= _recent.back()->size();
+			_recent.pop_back();
+		}
+	}
+}
@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_MAPPED_FILE_H
+#define SOURCE_EXPLORER_MAPPED_FILE_H
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace SourceExplorer
+{
+	enum class access_hint_t : uint8_t
+	{
+		normal,
+		sequential,
+		random,
+	};
+
+	struct windowed_file_t;
+
+	// Copy-on-write view of an entire file (or one window of it, see
+	// windowed_file_t). The file itself is only ever opened for reading,
+	// pages are faulted in by the OS as they are touched and any writes (i.e.
+	// from the memory editor) stay private to this process.
+	struct mapped_file_t
+	{
+		mapped_file_t()                      = default;
+		mapped_file_t(const mapped_file_t &) = delete;
+		mapped_file_t &operator=(const mapped_file_t &) = delete;
+		~mapped_file_t();
+
+		static lak::result<std::shared_ptr<mapped_file_t>> open(
+		  const std::filesystem::path &path);
+
+		inline size_t size() const { return _size; }
+		inline byte_t *data() const { return _data; }
+		// Offset of data() from the start of the file.
+		inline uint64_t offset() const { return _offset; }
+		// Whether this is one window of a windowed_file_t.
+		inline bool windowed() const { return _windowed; }
+		// The windowed file this is a window of, if it is still open.
+		inline std::shared_ptr<windowed_file_t> owner() const
+		{
+			return _owner.lock();
+		}
+		inline lak::span<byte_t> span() const
+		{
+			return lak::span<byte_t>(_data, _size);
+		}
+
+		// Tell the OS how the mapping is about to be accessed so it can tune
+		// read-ahead. This is only a hint and may be ignored (it always is on
+		// Windows). It never reads anything in by itself.
+		void advise(access_hint_t hint) const;
+
+	private:
+		friend struct windowed_file_t;
+
+		byte_t *_data    = nullptr;
+		size_t _size     = 0;
+		uint64_t _offset = 0;
+		bool _windowed   = false;
+		std::weak_ptr<windowed_file_t> _owner;
+#ifdef _WIN32
+		void *_file    = nullptr;
+		void *_mapping = nullptr;
+#endif
+	};
+
+	// Maps a file one window at a time, for files too large to map (or read)
+	// in one piece such as large games on 32 bit builds. Windows start on
+	// multiples of the window size, so windows only overlap where a range
+	// crosses one of those boundaries. A window stays mapped while something
+	// holds on to it, the most recently used windows are also kept mapped
+	// (up to max_cached bytes) so reading nearby doesn't remap every time.
+	// Safe to use from several threads at once.
+	struct windowed_file_t
+	  : public std::enable_shared_from_this<windowed_file_t>
+	{
+		static constexpr size_t default_window_size = 0x4000000;  // 64MiB
+		static constexpr size_t default_max_cached  = 0x10000000; // 256MiB
+
+		windowed_file_t()                        = default;
+		windowed_file_t(const windowed_file_t &) = delete;
+		windowed_file_t &operator=(const windowed_file_t &) = delete;
+		~windowed_file_t();
+
+		static lak::result<std::shared_ptr<windowed_file_t>> open(
+		  const std::filesystem::path &path,
+		  size_t window_size = default_window_size,
+		  size_t max_cached  = default_max_cached);
+
+		inline uint64_t size() const { return _size; }
+		inline size_t window_size() const { return _window_size; }
+
+		// Returns a window covering at least [offset, offset + min_size),
+		// clipped to the end of the file. Windows that are still alive are
+		// reused before a new one is mapped.
+		lak::result<std::shared_ptr<mapped_file_t>> window(uint64_t offset,
+		                                                   size_t min_size);
+
+	private:
+		lak::result<std::shared_ptr<mapped_file_t>> map(uint64_t offset,
+		                                                size_t size) const;
+
+		// Mark window as the most recently used, unmapping the least recently
+		// used windows past max_cached that nothing else holds on to.
+		void touch(const std::shared_ptr<mapped_file_t> &window);
+
+		std::mutex _mutex;
+		std::vector<std::weak_ptr<mapped_file_t>> _windows;
+		// Most recently used first.
+		std::list<std::shared_ptr<mapped_file_t>> _recent;
+		size_t _recent_bytes = 0;
+		uint64_t _size       = 0;
+		size_t _window_size  = default_window_size;
+		size_t _max_cached   = default_max_cached;
+		size_t _alignment    = 0x1000;
+#ifdef _WIN32
+		void *_file    = nullptr;
+		void *_mapping = nullptr;
+#else
+		int _fd = -1;
+#endif
+	};
+}
+
+#endif
@@ -0,0 +1,225 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "parallel.h"
+
+#include <lak/debug.hpp>
+
+#include <chrono>
+#include <exception>
+
+namespace SourceExplorer
+{
+	namespace
+	{
+		// The pool (if any) the current thread is a worker of, and its index.
+		thread_local thread_pool_t *current_pool = nullptr;
+		thread_local size_t current_index        = 0;
+
+		void run_task(thread_pool_t::task_t &task)
+		{
+			try
+			{
+				task();
+			}
+			catch (const std::exception &e)
+			{
+				ERROR("Uncaught Exception: ", e.what());
+			}
+			catch (...)
+			{
+				ERROR("Uncaught Exception");
+			}
+		}
+	}
+
+	thread_pool_t::thread_pool_t(size_t thread_count)
+	{
+		_workers.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; ++i)
+			_workers.push_back(std::make_unique<worker_t>());
+
+		_threads.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; ++i)
+			_threads.emplace_back([this, i] { worker_main(i); });
+	}
+
+	thread_pool_t::~thread_pool_t()
+	{
+		{
+			std::lock_guard lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (auto &thread : _threads) thread.join();
+	}
+
+	thread_pool_t &thread_pool_t::global()
+	{
+		static thread_pool_t pool(
+		  std::max<size_t>(1, std::thread::hardware_concurrency()));
+		return pool;
+	}
+
+	void thread_pool_t::submit(task_t task)
+	{
+		// Count the task before it can be taken so _pending never dips below
+		// the number of tasks actually queued.
+		if (current_pool == this)
+		{
+			{
+				std::lock_guard lock(_mutex);
+				_pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			auto &worker = *_workers[current_index];
+			std::lock_guard lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+		}
+		else
+		{
+			std::lock_guard lock(_mutex);
+			_pending.fetch_add(1, std::memory_order_relaxed);
+			_queue.push_back(std::move(task));
+		}
+		_wake.notify_one();
+	}
+
+	bool thread_pool_t::run_one()
+	{
+		if (current_pool != this) return false;
+
+		task_t task;
+		{
+			auto &worker = *_workers[current_index];
+			std::lock_guard lock(worker.mutex);
+			if (worker.tasks.empty()) return false;
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		}
+		_pending.fetch_sub(1, std::memory_order_relaxed);
+		run_task(task);
+		return true;
+	}
+
+	bool thread_pool_t::take(size_t index, task_t &task)
+	{
+		auto found = [&]
+		{
+			_pending.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		};
+
+		// Newest first from our own deque, it is the most likely to still be
+		// in cache.
+		if (index < _workers.size())
+		{
+			auto &worker = *_workers[index];
+			std::lock_guard lock(worker.mutex);
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+				return found();
+			}
+		}
+
+		{
+			std::lock_guard lock(_mutex);
+			if (!_queue.empty())
+			{
+				task = std::move(_queue.front());
+				_queue.pop_front();
+				return found();
+			}
+		}
+
+		// Oldest first from everyone else's.
+		const size_t start = index < _workers.size() ? index + 1 : 0;
+		for (size_t i = 0; i < _workers.size(); ++i)
+		{
+			const size_t victim = (start + i) % _workers.size();
+			if (victim == index) continue;
+			auto &worker = *_workers[victim];
+			std::lock_guard lock(worker.mutex);
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.front());
+				worker.tasks.pop_front();
+				return found();
+			}
+		}
+
+		return false;
+	}
+
+	void thread_pool_t::worker_main(size_t index)
+	{
+		current_pool  = this;
+		current_index = index;
+
+		for (;;)
+		{
+			if (task_t task; take(index, task))
+			{
+				run_task(task);
+				continue;
+			}
+
+			std::unique_lock lock(_mutex);
+			_wake.wait(lock,
+			           [&]
+			           {
+				           return _stop ||
+				                  _pending.load(std::memory_order_relaxed) > 0;
+			           });
+			if (_stop) return;
+		}
+	}
+
+	void task_group_t::wait()
+	{
+		while (_pending.load(std::memory_order_acquire) > 0)
+		{
+			if (_pool.run_one()) continue;
+
+			// Nothing left to help with, the remaining tasks are running on
+			// other threads.
+			std::unique_lock lock(_mutex);
+			_done.wait_for(
+			  lock,
+			  std::chrono::milliseconds(1),
+			  [&] { return _pending.load(std::memory_order_acquire) == 0; });
+		}
+
+		// The last finish() may still be holding the lock, wait for it to let
+		// go before this group can be destroyed.
+		std::lock_guard lock(_mutex);
+	}
+
+	void task_group_t::finish()
+	{
+		std::lock_guard lock(_mutex);
+		if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			_done.notify_all();
+	}
+}
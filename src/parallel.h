@@ -0,0 +1,365 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SOURCE_EXPLORER_PARALLEL_H
+#define SOURCE_EXPLORER_PARALLEL_H
+
+#include <lak/stdint.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SourceExplorer
+{
+	// Work stealing thread pool. Each worker has its own deque of tasks, tasks
+	// submitted from a worker go on the back of its deque and it takes them
+	// back off the back, idle workers steal from the front of everyone else's.
+	// Tasks submitted from any other thread go on a shared queue.
+	struct thread_pool_t
+	{
+		using task_t = std::function<void()>;
+
+		explicit thread_pool_t(size_t thread_count);
+		thread_pool_t(const thread_pool_t &) = delete;
+		thread_pool_t &operator=(const thread_pool_t &) = delete;
+		// Pending tasks that have not started yet are dropped, tasks that are
+		// already running are waited for.
+		~thread_pool_t();
+
+		// The process wide pool, one worker per hardware thread.
+		static thread_pool_t &global();
+
+		inline size_t size() const { return _threads.size(); }
+
+		void submit(task_t task);
+
+		// Run a single pending task on the calling thread, returns false if
+		// there was nothing to run. Lets threads that are waiting on the pool
+		// help it along rather than block. Only the calling worker's own
+		// deque is used, i.e. work it (or a task running under it) submitted,
+		// so a wait never picks up an unrelated job from the shared queue.
+		// Threads outside the pool never run anything here.
+		bool run_one();
+
+	private:
+		struct worker_t
+		{
+			std::mutex mutex;
+			std::deque<task_t> tasks;
+		};
+
+		bool take(size_t index, task_t &task);
+		void worker_main(size_t index);
+
+		std::vector<std::unique_ptr<worker_t>> _workers;
+		std::vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::deque<task_t> _queue;
+		std::atomic<size_t> _pending = 0;
+		bool _stop                   = false;
+	};
+
+	// A set of tasks that can be waited on together.
+	struct task_group_t
+	{
+		explicit task_group_t(thread_pool_t &pool = thread_pool_t::global())
+		: _pool(pool)
+		{
+		}
+
+		task_group_t(const task_group_t &) = delete;
+		task_group_t &operator=(const task_group_t &) = delete;
+
+		~task_group_t() { wait(); }
+
+		template<typename FUNC>
+		void run(FUNC &&func)
+		{
+			_pending.fetch_add(1, std::memory_order_relaxed);
+			_pool.submit(
+			  [this, func = std::forward<FUNC>(func)]() mutable
+			  {
+				  struct done_t
+				  {
+					  task_group_t *group;
+					  ~done_t() { group->finish(); }
+				  } done{this};
+				  func();
+			  });
+		}
+
+		// Returns once every task run() in this group has finished, running
+		// other pool tasks while it waits.
+		void wait();
+
+	private:
+		void finish();
+
+		thread_pool_t &_pool;
+		std::atomic<size_t> _pending = 0;
+		std::mutex _mutex;
+		std::condition_variable _done;
+	};
+
+	// The result of a task running on the global pool. A default constructed
+	// future is not valid, and a future whose task threw becomes ready
+	// without a value.
+	template<typename T>
+	struct future_t
+	{
+		struct state_t
+		{
+			std::mutex mutex;
+			std::optional<T> value;
+			std::vector<thread_pool_t::task_t> continuations;
+			std::atomic<bool> ready = false;
+
+			// Exactly one of set or fail is called once the task is done.
+			void set(T result)
+			{
+				value.emplace(std::move(result));
+				finish();
+			}
+
+			void fail() { finish(); }
+
+			// Submit task once this state is ready.
+			void after(thread_pool_t::task_t task)
+			{
+				{
+					std::lock_guard lock(mutex);
+					if (!ready.load(std::memory_order_relaxed))
+					{
+						continuations.push_back(std::move(task));
+						return;
+					}
+				}
+				thread_pool_t::global().submit(std::move(task));
+			}
+
+		private:
+			void finish()
+			{
+				std::vector<thread_pool_t::task_t> tasks;
+				{
+					std::lock_guard lock(mutex);
+					ready.store(true, std::memory_order_release);
+					tasks.swap(continuations);
+				}
+				for (auto &task : tasks)
+					thread_pool_t::global().submit(std::move(task));
+			}
+		};
+
+		future_t() = default;
+		explicit future_t(std::shared_ptr<state_t> state)
+		: _state(std::move(state))
+		{
+		}
+
+		inline bool valid() const { return bool(_state); }
+
+		inline bool ready() const
+		{
+			return _state && _state->ready.load(std::memory_order_acquire);
+		}
+
+		// Wait for the task to finish (running other pool tasks meanwhile),
+		// the result is empty if it threw.
+		const std::optional<T> &get() const
+		{
+			while (!ready())
+				if (!thread_pool_t::global().run_one()) std::this_thread::yield();
+			return _state->value;
+		}
+
+		// Run func(value) on the pool once this future is ready, if this
+		// future's task threw then so does the returned one.
+		template<typename FUNC>
+		auto then(FUNC &&func) const
+		  -> future_t<std::invoke_result_t<FUNC &, const T &>>
+		{
+			using result_t = std::invoke_result_t<FUNC &, const T &>;
+			auto next = std::make_shared<typename future_t<result_t>::state_t>();
+			_state->after(
+			  [state = _state, next, func = std::forward<FUNC>(func)]() mutable
+			  {
+				  if (!state->value)
+					  next->fail();
+				  else
+					  try
+					  {
+						  next->set(func(*state->value));
+					  }
+					  catch (...)
+					  {
+						  next->fail();
+						  throw;
+					  }
+			  });
+			return future_t<result_t>(std::move(next));
+		}
+
+	private:
+		std::shared_ptr<state_t> _state;
+	};
+
+	// Run func() on the global pool.
+	template<typename FUNC>
+	auto async(FUNC &&func) -> future_t<std::invoke_result_t<FUNC &>>
+	{
+		using result_t = std::invoke_result_t<FUNC &>;
+		static_assert(!std::is_void_v<result_t>);
+		auto state = std::make_shared<typename future_t<result_t>::state_t>();
+		thread_pool_t::global().submit(
+		  [state, func = std::forward<FUNC>(func)]() mutable
+		  {
+			  try
+			  {
+				  state->set(func());
+			  }
+			  catch (...)
+			  {
+				  state->fail();
+				  throw;
+			  }
+		  });
+		return future_t<result_t>(std::move(state));
+	}
+
+	// Run produce(i) for every i in [0, count) on the global pool, and
+	// consume(i, result) on the calling thread in order of i. At most
+	// max_in_flight results are produced ahead of the consumer, which bounds
+	// the memory held by results waiting to be consumed.
+	template<typename PRODUCE, typename CONSUME>
+	void ordered_pipeline(size_t count,
+	                      size_t max_in_flight,
+	                      PRODUCE &&produce,
+	                      CONSUME &&consume)
+	{
+		using result_t = std::invoke_result_t<PRODUCE &, size_t>;
+
+		struct slot_t
+		{
+			std::optional<result_t> value;
+			std::exception_ptr exception;
+			std::atomic<bool> ready = false;
+		};
+
+		if (count == 0) return;
+		max_in_flight = std::max<size_t>(1, std::min(max_in_flight, count));
+
+		auto slots = std::make_unique<slot_t[]>(max_in_flight);
+		std::mutex mutex;
+		std::condition_variable produced;
+
+		auto &pool = thread_pool_t::global();
+		task_group_t group(pool);
+		size_t submitted = 0;
+		for (size_t consumed = 0; consumed < count; ++consumed)
+		{
+			for (; submitted < count && submitted - consumed < max_in_flight;
+			     ++submitted)
+				group.run(
+				  [&, index = submitted]
+				  {
+					  auto &slot = slots[index % max_in_flight];
+					  try
+					  {
+						  slot.value.emplace(produce(index));
+					  }
+					  catch (...)
+					  {
+						  slot.exception = std::current_exception();
+					  }
+					  std::lock_guard lock(mutex);
+					  slot.ready.store(true, std::memory_order_release);
+					  produced.notify_all();
+				  });
+
+			auto &slot = slots[consumed % max_in_flight];
+			while (!slot.ready.load(std::memory_order_acquire))
+			{
+				if (pool.run_one()) continue;
+				std::unique_lock lock(mutex);
+				produced.wait_for(
+				  lock,
+				  std::chrono::milliseconds(1),
+				  [&] { return slot.ready.load(std::memory_order_acquire); });
+			}
+
+			slot.ready.store(false, std::memory_order_relaxed);
+			if (slot.exception)
+			{
+				// Let the tasks still running finish before unwinding their
+				// captures.
+				group.wait();
+				std::rethrow_exception(std::exchange(slot.exception, nullptr));
+			}
+			consume(consumed, std::move(*slot.value));
+			slot.value.reset();
+		}
+	}
+
+	// Call func(i) for every i in [0, count) spread across the global pool
+	// (the calling thread included), indices are handed out one at a time so
+	// uneven work balances itself. Returns once every call is done. Safe to
+	// call from inside a pool task.
+	template<typename FUNC>
+	void parallel_for(size_t count, FUNC &&func)
+	{
+		if (count == 0) return;
+
+		std::atomic<size_t> next = 0;
+		auto work                = [&]
+		{
+			for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) <
+			               count;)
+				func(i);
+		};
+
+		auto &pool              = thread_pool_t::global();
+		const size_t task_count = std::min(count, pool.size() + 1);
+		if (task_count == 1) return work();
+
+		task_group_t group(pool);
+		for (size_t i = 1; i < task_count; ++i) group.run(work);
+		work();
+		group.wait();
+	}
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+MIT License
+
+Copyright (c) 2019 LAK132
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SOURCE_EXPLORER_PERF_COUNTERS_HPP
+#define SOURCE_EXPLORER_PERF_COUNTERS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace SourceExplorer
+{
+	// Running totals of the work done by each stage of loading and dumping
+	// games. They are shared by every game the process loads and only go up
+	// until they are reset.
+
+	enum struct perf_stage_t : uint8_t
+	{
+		// LoadGame. Bytes are the size of each game file read, items are the
+		// chunks and bank items parsed (including any parsed lazily later).
+		// The time includes the decoding done while parsing, which the other
+		// stages count as well.
+		read,
+		// DEFLATE, bytes are the inflated output.
+		inflate,
+		// MODE2/3 chunks, bytes are the decrypted input. With the fast inflate
+		// backend MODE3 chunks are decrypted and inflated in one pass, that
+		// time is all counted here (the inflated bytes still count as inflate).
+		decrypt,
+		// 2.5+ LZ4 blocks, bytes are the decoded output.
+		lz4,
+		// Images decoded to RGBA, bytes are the decoded pixels. Doesn't
+		// include decompressing the image data.
+		image_decode,
+		// Images encoded to files, bytes are the encoded files (PNG unless
+		// another format was picked). Includes writing them to disk.
+		image_encode,
+
+		count,
+	};
+
+	inline const char *perf_stage_name(perf_stage_t stage)
+	{
+		switch (stage)
+		{
+			case perf_stage_t::read: return "read";
+			case perf_stage_t::inflate: return "inflate";
+			case perf_stage_t::decrypt: return "decrypt";
+			case perf_stage_t::lz4: return "lz4";
+			case perf_stage_t::image_decode: return "image_decode";
+			case perf_stage_t::image_encode: return "image_encode";
+			default: return "invalid";
+		}
+	}
+
+	struct perf_stats_t
+	{
+		uint64_t bytes = 0;
+		uint64_t items = 0;
+		// Summed over every thread working on the stage, so stages that run
+		// in parallel can add up to more than the wall clock time.
+		double seconds = 0.0;
+
+		double mib_per_second() const
+		{
+			return seconds > 0.0 ? double(bytes) / 0x100000 / seconds : 0.0;
+		}
+	};
+
+	struct perf_counters_t
+	{
+		using clock_t = std::chrono::steady_clock;
+
+		struct counter_t
+		{
+			std::atomic<uint64_t> bytes       = 0;
+			std::atomic<uint64_t> items       = 0;
+			std::atomic<uint64_t> nanoseconds = 0;
+		};
+
+		std::array<counter_t, size_t(perf_stage_t::count)> stages;
+
+		void add(perf_stage_t stage,
+		         uint64_t bytes,
+		         uint64_t items,
+		         clock_t::duration time = {})
+		{
+			auto &counter = stages[size_t(stage)];
+			if (bytes > 0)
+				counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+			if (items > 0)
+				counter.items.fetch_add(items, std::memory_order_relaxed);
+			if (time > clock_t::duration::zero())
+				counter.nanoseconds.fetch_add(
+				  uint64_t(
+				    std::chrono::duration_cast<std::chrono::nanoseconds>(time)
+				      .count()),
+				  std::memory_order_relaxed);
+		}
+
+		// The fields are read separately, so a stage that is running can be
+		// off by one item.
+		perf_stats_t get(perf_stage_t stage) const
+		{
+			const auto &counter = stages[size_t(stage)];
+			perf_stats_t result;
+			result.bytes   = counter.bytes.load(std::memory_order_relaxed);
+			result.items   = counter.items.load(std::memory_order_relaxed);
+			result.seconds = double(counter.nanoseconds.load(
+			                   std::memory_order_relaxed)) /
+			                 1e9;
+			return result;
+		}
+
+		void reset()
+		{
+			for (auto &counter : stages)
+			{
+				counter.bytes.store(0, std::memory_order_relaxed);
+				counter.items.store(0, std::memory_order_relaxed);
+				counter.nanoseconds.store(0, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	inline perf_counters_t perf_counters;
+
+	// Adds the time it was alive to stage when it is destroyed, whether or
+	// not the work succeeded. Bytes and items are only counted once add()ed.
+	struct perf_timer_t
+	{
+		perf_stage_t stage;
+		perf_counters_t::clock_t::time_point start =
+		  perf_counters_t::clock_t::now();
+		uint64_t bytes = 0;
+		uint64_t items = 0;
+
+		explicit perf_timer_t(perf_stage_t s) : stage(s) {}
+		perf_timer_t(const perf_timer_t &)            = delete;
+		perf_timer_t &operator=(const perf_timer_t &) = delete;
+
+		~perf_timer_t()
+		{
+			perf_counters.add(
+			  stage, bytes, items, perf_counters_t::clock_t::now() - start);
+		}
+
+		void add(uint64_t b, uint64_t i = 1)
+		{
+			bytes += b;
+			items += i;
+		}
+	};
+}
+
+#endif